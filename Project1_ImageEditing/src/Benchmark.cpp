@@ -0,0 +1,537 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Benchmark.cpp
+//
+//      Throughput benchmark for the TargaImage operations and for loading
+//  and saving images.  Each operation runs on deterministic synthetic
+//  images of several sizes; the first run at each size warms the caches
+//  and the rest are timed.  Results are printed as megapixels of input per
+//  second with their standard deviation and can be written as JSON.  Given
+//  a baseline written by an earlier run, any operation whose mean
+//  throughput dropped by more than the threshold is reported and the exit
+//  code is 1.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "TargaImage.h"
+#include "Random.h"
+#include "libtarga.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// constants
+const int           c_defaultSizes[]        = { 1, 4, 16, 64 };     // megapixels, 2^20 pixels each
+const int           c_defaultRuns           = 5;                    // timed runs per operation and size
+const float         c_defaultThreshold      = 10;                   // percent drop in throughput counted as a regression
+const unsigned int  c_imageSeed             = 0x5EED1234;           // seed of the synthetic images
+const int           c_tileSize              = 64;                   // side of the synthetic image tiles
+
+const char          c_sRawFile[]            = "benchmark_raw.tga";  // scratch files for the I/O operations
+const char          c_sRleFile[]            = "benchmark_rle.tga";
+const char          c_sNativeFile[]         = "benchmark.nim";
+const char          c_sCompressedFile[]     = "benchmark.nimz";
+
+// sum of the pixels of the last image loaded, kept so the pass over them is not optimised away
+static volatile uint64_t    s_loadChecksum  = 0;
+
+// an operation on image; layer is a second image of the same size for compositing
+typedef bool (*FOperation)(TargaImage& image, TargaImage& layer);
+
+struct SOperation
+{
+    const char*     sName;          // as the script command, where there is one
+    FOperation      operation;
+};
+
+struct SResult
+{
+    string          sName;          // operation
+    int             megapixels;     // nominal image size
+    int             width;
+    int             height;
+    int             runs;           // timed runs
+    double          mean;           // megapixels per second
+    double          deviation;      // standard deviation of the runs
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Save the image as RLE compressed targa.  TargaImage only writes raw
+//  targa, so this mirrors Save_Image with the RLE writer.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool SaveRle(TargaImage& image, const char* sFilename)
+{
+    vector<unsigned char> vRows((size_t)image.width * image.height * 4);
+    size_t rowBytes = (size_t)image.width * 4;
+    for (int y = 0; y < image.height; ++y)
+        memcpy(&vRows[(size_t)(image.height - 1 - y) * rowBytes], image.data + (size_t)y * rowBytes, rowBytes);
+
+    return tga_write_rle(sFilename, image.width, image.height, &vRows[0], TGA_TRUECOLOR_32) != 0;
+}// SaveRle
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Load the image in the given file, sum its pixels and discard it.
+//  Uncompressed native files are only mapped by the load, so summing reads
+//  every row in the timed region for every format alike.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool LoadAndDiscard(const char* sFilename)
+{
+    TargaImage* pImage = TargaImage::Load_Image(const_cast<char*>(sFilename));
+    if (!pImage)
+        return false;
+
+    uint64_t checksum = 0;
+    size_t bytes = (size_t)pImage->width * pImage->height * 4;
+    for (size_t i = 0; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, pImage->data + i, sizeof(word));
+        checksum += word;
+    }// for
+    s_loadChecksum = checksum;
+
+    delete pImage;
+    return true;
+}// LoadAndDiscard
+
+
+// every operation, in the order they are run.  Quant_Median has no definition yet and is left out.
+const SOperation c_aOperations[] =
+{
+    { "gray",               [](TargaImage& image, TargaImage&) { return image.To_Grayscale(); } },
+    { "quant-unif",         [](TargaImage& image, TargaImage&) { return image.Quant_Uniform(); } },
+    { "quant-pop",          [](TargaImage& image, TargaImage&) { return image.Quant_Populosity(); } },
+    { "dither-thresh",      [](TargaImage& image, TargaImage&) { return image.Dither_Threshold(); } },
+    { "dither-rand",        [](TargaImage& image, TargaImage&) { return image.Dither_Random(); } },
+    { "dither-fs",          [](TargaImage& image, TargaImage&) { return image.Dither_FS(); } },
+    { "dither-bright",      [](TargaImage& image, TargaImage&) { return image.Dither_Bright(); } },
+    { "dither-cluster",     [](TargaImage& image, TargaImage&) { return image.Dither_Cluster(); } },
+    { "dither-pattern",     [](TargaImage& image, TargaImage&) { return image.Dither_Pattern(8); } },
+    { "dither-color",       [](TargaImage& image, TargaImage&) { return image.Dither_Color(); } },
+    { "comp-over",          [](TargaImage& image, TargaImage& layer) { return image.Comp_Over(&layer); } },
+    { "comp-in",            [](TargaImage& image, TargaImage& layer) { return image.Comp_In(&layer); } },
+    { "comp-out",           [](TargaImage& image, TargaImage& layer) { return image.Comp_Out(&layer); } },
+    { "comp-atop",          [](TargaImage& image, TargaImage& layer) { return image.Comp_Atop(&layer); } },
+    { "comp-xor",           [](TargaImage& image, TargaImage& layer) { return image.Comp_Xor(&layer); } },
+    { "diff",               [](TargaImage& image, TargaImage& layer) { return image.Difference(&layer); } },
+    { "filter-box",         [](TargaImage& image, TargaImage&) { return image.Filter_Box(); } },
+    { "filter-bartlett",    [](TargaImage& image, TargaImage&) { return image.Filter_Bartlett(); } },
+    { "filter-gauss",       [](TargaImage& image, TargaImage&) { return image.Filter_Gaussian(); } },
+    { "filter-gauss-n",     [](TargaImage& image, TargaImage&) { return image.Filter_Gaussian_N(9); } },
+    { "filter-edge",        [](TargaImage& image, TargaImage&) { return image.Filter_Edge(); } },
+    { "filter-enhance",     [](TargaImage& image, TargaImage&) { return image.Filter_Enhance(); } },
+    { "filter-median",      [](TargaImage& image, TargaImage&) { return image.Filter_Median(3); } },
+    { "filter-bilateral",   [](TargaImage& image, TargaImage&) { return image.Filter_Bilateral(8, 32); } },
+    { "filter-kernel",      [](TargaImage& image, TargaImage&)
+                            {
+                                vector<float> vKernel(15 * 15, 1);
+                                return image.Filter_Kernel(&vKernel[0], 15, 15 * 15);
+                            } },
+    { "erode",              [](TargaImage& image, TargaImage&) { return image.Morphology(MORPH_ERODE, 9, 9); } },
+    { "dilate",             [](TargaImage& image, TargaImage&) { return image.Morphology(MORPH_DILATE, 9, 9); } },
+    { "open",               [](TargaImage& image, TargaImage&) { return image.Morphology(MORPH_OPEN, 9, 9); } },
+    { "close",              [](TargaImage& image, TargaImage&) { return image.Morphology(MORPH_CLOSE, 9, 9); } },
+    { "distance",           [](TargaImage& image, TargaImage&) { return image.Distance_Field(); } },
+    { "npr-paint",          [](TargaImage& image, TargaImage&) { return image.NPR_Paint(); } },
+    { "half",               [](TargaImage& image, TargaImage&) { return image.Half_Size(); } },
+    { "double",             [](TargaImage& image, TargaImage&) { return image.Double_Size(); } },
+    { "scale",              [](TargaImage& image, TargaImage&) { return image.Resize(1.5f); } },
+    { "rotate",             [](TargaImage& image, TargaImage&) { return image.Rotate(30); } },
+    { "save-raw",           [](TargaImage& image, TargaImage&) { return image.Save_Image(c_sRawFile); } },
+    { "load-raw",           [](TargaImage&, TargaImage&) { return LoadAndDiscard(c_sRawFile); } },
+    { "save-rle",           [](TargaImage& image, TargaImage&) { return SaveRle(image, c_sRleFile); } },
+    { "load-rle",           [](TargaImage&, TargaImage&) { return LoadAndDiscard(c_sRleFile); } },
+    { "save-nim",           [](TargaImage& image, TargaImage&) { return image.Save_Image(c_sNativeFile); } },
+    { "load-nim",           [](TargaImage&, TargaImage&) { return LoadAndDiscard(c_sNativeFile); } },
+    { "save-nimz",          [](TargaImage& image, TargaImage&) { return image.Save_Image(c_sCompressedFile); } },
+    { "load-nimz",          [](TargaImage&, TargaImage&) { return LoadAndDiscard(c_sCompressedFile); } },
+};
+
+const int c_operationCount = sizeof(c_aOperations) / sizeof(c_aOperations[0]);
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Fill the image with a deterministic test pattern.  It is made of
+//  tiles so that run length and LZ coding have something to find: a third
+//  are flat colour, a third are gradients and a third are noise, and one
+//  tile in four is partly transparent.  Pixels are premultiplied.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void MakeImage(TargaImage& image, unsigned int seed)
+{
+    int tilesAcross = (image.width + c_tileSize - 1) / c_tileSize;
+
+    ParallelFor(0, image.height, [&](int y)
+    {
+        for (int x = 0; x < image.width; ++x)
+        {
+            uint64_t tile = (uint64_t)(y / c_tileSize) * tilesAcross + x / c_tileSize;
+            uint32_t tileBits = RandomBits(seed, tile),
+                     pixelBits = RandomBits(seed, (uint64_t)y * image.width + x + ((uint64_t)1 << 40));
+
+            int colour[3] = { (int)(tileBits & 0xFF), (int)(tileBits >> 8 & 0xFF), (int)(tileBits >> 16 & 0xFF) },
+                alpha = (tileBits >> 24) % 4 ? 255 : (int)(pixelBits >> 24);
+
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                if (tile % 3 == 1)
+                    colour[channel] = (colour[channel] + (x + y) % c_tileSize * 2) & 0xFF;
+                else if (tile % 3 == 2)
+                    colour[channel] = pixelBits >> channel * 8 & 0xFF;
+            }// for
+
+            unsigned char* pPixel = image.data + ((size_t)y * image.width + x) * 4;
+            for (int channel = 0; channel < 3; ++channel)
+                pPixel[channel] = (unsigned char)((colour[channel] * alpha + 127) / 255);
+            pPixel[3] = (unsigned char)alpha;
+        }// for
+    });
+}// MakeImage
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return the number in sObject following "sKey":, or fallback if the
+//  key is missing.
+//
+///////////////////////////////////////////////////////////////////////////////
+static double FindNumber(const string& sObject, const char* sKey, double fallback)
+{
+    size_t position = sObject.find(string("\"") + sKey + "\"");
+    if (position == string::npos || (position = sObject.find(':', position)) == string::npos)
+        return fallback;
+
+    return atof(sObject.c_str() + position + 1);
+}// FindNumber
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return the string in sObject following "sKey":, or an empty string if
+//  the key is missing.
+//
+///////////////////////////////////////////////////////////////////////////////
+static string FindString(const string& sObject, const char* sKey)
+{
+    size_t position = sObject.find(string("\"") + sKey + "\"");
+    if (position == string::npos || (position = sObject.find('"', sObject.find(':', position))) == string::npos)
+        return "";
+
+    size_t end = sObject.find('"', position + 1);
+    return end == string::npos ? "" : sObject.substr(position + 1, end - position - 1);
+}// FindString
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Read the results of an earlier run, keyed by operation and size.
+//  Each object of the "results" array is read by its keys, so the file
+//  only needs to be the JSON that WriteResults writes.  Returns false if
+//  the file can't be read.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool ReadResults(const char* sFilename, map<pair<string, int>, SResult>& results)
+{
+    ifstream file(sFilename);
+    if (!file)
+    {
+        cout << "Unable to read baseline:  " << sFilename << endl;
+        return false;
+    }// if
+
+    stringstream contents;
+    contents << file.rdbuf();
+    string sContents = contents.str();
+
+    size_t start = sContents.find("\"results\"");
+    while (start != string::npos && (start = sContents.find('{', start)) != string::npos)
+    {
+        size_t end = sContents.find('}', start);
+        if (end == string::npos)
+            break;
+
+        string sObject = sContents.substr(start, end - start + 1);
+        SResult result;
+        result.sName = FindString(sObject, "op");
+        result.megapixels = (int)FindNumber(sObject, "megapixels", 0);
+        result.width = (int)FindNumber(sObject, "width", 0);
+        result.height = (int)FindNumber(sObject, "height", 0);
+        result.runs = (int)FindNumber(sObject, "runs", 0);
+        result.mean = FindNumber(sObject, "mpix_per_s", 0);
+        result.deviation = FindNumber(sObject, "stddev", 0);
+        if (!result.sName.empty())
+            results[make_pair(result.sName, result.megapixels)] = result;
+
+        start = end;
+    }// while
+
+    return true;
+}// ReadResults
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Write the results as JSON.  Returns false if the file can't be
+//  written.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool WriteResults(const char* sFilename, const vector<SResult>& vResults)
+{
+    ofstream file(sFilename);
+    if (!file)
+    {
+        cout << "Unable to write results:  " << sFilename << endl;
+        return false;
+    }// if
+
+    file << "{\"threads\":" << thread::hardware_concurrency() << ",\"results\":[";
+    for (size_t i = 0; i < vResults.size(); ++i)
+    {
+        const SResult& result = vResults[i];
+        file << (i ? ",\n" : "\n") << fixed << setprecision(3)
+             << "{\"op\":\"" << result.sName << "\",\"megapixels\":" << result.megapixels
+             << ",\"width\":" << result.width << ",\"height\":" << result.height << ",\"runs\":" << result.runs
+             << ",\"mpix_per_s\":" << result.mean << ",\"stddev\":" << result.deviation << "}";
+    }// for
+    file << "\n]}" << endl;
+
+    return true;
+}// WriteResults
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Time every selected operation at the given size.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void RunSize(int megapixels, int runs, const vector<string>& vsOnly, vector<SResult>& vResults)
+{
+    int side = (int)(1024 * sqrt((double)megapixels) + 0.5);
+    TargaImage source(side, side),
+               layer(side, side);
+    MakeImage(source, c_imageSeed);
+    MakeImage(layer, c_imageSeed + 1);
+
+    // files for the load operations, so they can be run without the saves
+    source.Save_Image(c_sRawFile);
+    SaveRle(source, c_sRleFile);
+    source.Save_Image(c_sNativeFile);
+    source.Save_Image(c_sCompressedFile);
+
+    double pixels = (double)side * side / 1e6;
+    cout << endl << megapixels << " MP (" << side << " x " << side << ")" << endl;
+
+    for (int op = 0; op < c_operationCount; ++op)
+    {
+        const SOperation& operation = c_aOperations[op];
+        if (!vsOnly.empty() && find(vsOnly.begin(), vsOnly.end(), operation.sName) == vsOnly.end())
+            continue;
+
+        vector<double> vRates;
+        bool bFailed = false;
+        for (int run = 0; run <= runs && !bFailed; ++run)
+        {
+            TargaImage image(source);
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            bFailed = !operation.operation(image, layer);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            if (run)
+                vRates.push_back(pixels / Max(seconds, 1e-9));
+        }// for
+
+        cout << "  " << left << setw(20) << operation.sName << right;
+        if (bFailed)
+        {
+            cout << "skipped, not implemented or failed" << endl;
+            continue;
+        }// if
+
+        SResult result = { operation.sName, megapixels, side, side, runs, 0, 0 };
+        for (size_t run = 0; run < vRates.size(); ++run)
+            result.mean += vRates[run] / vRates.size();
+        for (size_t run = 0; run < vRates.size(); ++run)
+            result.deviation += (vRates[run] - result.mean) * (vRates[run] - result.mean) / Max((int)vRates.size() - 1, 1);
+        result.deviation = sqrt(result.deviation);
+        vResults.push_back(result);
+
+        cout << fixed << setprecision(1) << setw(10) << result.mean << " MPix/s  +/- "
+             << setprecision(1) << (result.mean > 0 ? 100 * result.deviation / result.mean : 0) << "%" << endl;
+    }// for
+
+    remove(c_sRawFile);
+    remove(c_sRleFile);
+    remove(c_sNativeFile);
+    remove(c_sCompressedFile);
+}// RunSize
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Print every result more than threshold percent slower than its
+//  baseline.  Returns true if there were any.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool ReportRegressions(const vector<SResult>& vResults, const map<pair<string, int>, SResult>& baseline, float threshold)
+{
+    bool bRegressed = false;
+    int compared = 0;
+
+    cout << endl << "Compared with baseline, threshold " << threshold << "%" << endl;
+    for (size_t i = 0; i < vResults.size(); ++i)
+    {
+        const SResult& result = vResults[i];
+        map<pair<string, int>, SResult>::const_iterator old = baseline.find(make_pair(result.sName, result.megapixels));
+        if (old == baseline.end() || old->second.mean <= 0)
+            continue;
+
+        ++compared;
+        double change = 100 * (result.mean - old->second.mean) / old->second.mean;
+        if (change >= -threshold)
+            continue;
+
+        bRegressed = true;
+        cout << "  REGRESSION  " << left << setw(20) << result.sName << right << setw(4) << result.megapixels << " MP  "
+             << fixed << setprecision(1) << old->second.mean << " -> " << result.mean << " MPix/s  (" << change << "%)" << endl;
+    }// for
+
+    cout << "  " << compared << " results compared, " << (bRegressed ? "regressions found" : "no regressions") << endl;
+    return bRegressed;
+}// ReportRegressions
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Print the command line usage.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void Usage()
+{
+    cerr << "Usage:" << endl
+         << "ImageBenchmark [-sizes 1,4,16,64] [-runs n] [-ops name,name] [-out results.json]" << endl
+         << "               [-baseline baseline.json] [-threshold percent]" << endl;
+}// Usage
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Split a comma separated list.
+//
+///////////////////////////////////////////////////////////////////////////////
+static vector<string> SplitList(const char* sList)
+{
+    vector<string> vsItems;
+    stringstream list(sList);
+    string sItem;
+    while (getline(list, sItem, ','))
+        if (!sItem.empty())
+            vsItems.push_back(sItem);
+
+    return vsItems;
+}// SplitList
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Main function.  Handle command line arguments and run the benchmark.
+//  Returns 1 on a regression against the baseline and 2 on bad arguments.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+{
+    vector<int> vSizes(c_defaultSizes, c_defaultSizes + sizeof(c_defaultSizes) / sizeof(c_defaultSizes[0]));
+    vector<string> vsOnly;
+    int runs = c_defaultRuns;
+    float threshold = c_defaultThreshold;
+    const char* sOutput = NULL;
+    const char* sBaseline = NULL;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* sValue = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!sValue)
+        {
+            Usage();
+            return 2;
+        }// if
+
+        if (!strcmp(argv[i], "-sizes"))
+        {
+            vSizes.clear();
+            vector<string> vsSizes = SplitList(sValue);
+            for (size_t size = 0; size < vsSizes.size(); ++size)
+                vSizes.push_back(atoi(vsSizes[size].c_str()));
+        }// if
+        else if (!strcmp(argv[i], "-runs"))
+            runs = atoi(sValue);
+        else if (!strcmp(argv[i], "-ops"))
+            vsOnly = SplitList(sValue);
+        else if (!strcmp(argv[i], "-out"))
+            sOutput = sValue;
+        else if (!strcmp(argv[i], "-baseline"))
+            sBaseline = sValue;
+        else if (!strcmp(argv[i], "-threshold"))
+            threshold = (float)atof(sValue);
+        else
+        {
+            Usage();
+            return 2;
+        }// else
+
+        ++i;
+    }// for
+
+    for (size_t size = 0; size < vSizes.size(); ++size)
+    {
+        if (vSizes[size] < 1)
+        {
+            cout << "Image sizes must be at least 1 MP." << endl;
+            return 2;
+        }// if
+    }// for
+
+    if (runs < 1)
+    {
+        cout << "At least one run is needed." << endl;
+        return 2;
+    }// if
+
+    map<pair<string, int>, SResult> baseline;
+    if (sBaseline && !ReadResults(sBaseline, baseline))
+        return 2;
+
+    cout << "Benchmarking on " << thread::hardware_concurrency() << " threads, " << runs << " timed runs each" << endl;
+
+    vector<SResult> vResults;
+    for (size_t size = 0; size < vSizes.size(); ++size)
+        RunSize(vSizes[size], runs, vsOnly, vResults);
+
+    if (sOutput)
+        WriteResults(sOutput, vResults);
+
+    if (sBaseline && ReportRegressions(vResults, baseline, threshold))
+        return 1;
+
+    return 0;
+}// main
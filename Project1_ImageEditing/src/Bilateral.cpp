@@ -0,0 +1,258 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Bilateral.cpp
+//
+//      Implementation of the bilateral grid.  Grid cells hold the summed
+//  premultiplied RGBA of the pixels that fall in them and a pixel count.
+//  Splatting goes to the nearest cell, the blur is the separable 1 4 6 4 1
+//  binomial (a gaussian of one cell) along each axis, and slicing
+//  interpolates trilinearly.  Every stage is spread across threads over
+//  grid or image rows that do not overlap.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "Bilateral.h"
+
+using namespace std;
+
+// constants
+const int       c_cellFloats            = 5;                            // r, g, b, a and weight
+const int       c_gridPad               = 2;                            // empty cells around the grid, the blur's reach
+const float     c_aBlurTaps[]           = { 1 / 16.f, 4 / 16.f, 6 / 16.f, 4 / 16.f, 1 / 16.f };
+const long long c_maxGridCells          = 1 << 24;                      // refuse sigmas that make a larger grid
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Grey level used to place a pixel along the range axis.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline float GreyLevel(const unsigned char* pPixel)
+{
+    return 0.299f * pPixel[0] + 0.587f * pPixel[1] + 0.114f * pPixel[2];
+}// GreyLevel
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Blur the grid along one axis.  Axes are 0 for y, 1 for x and 2 for
+//  the range; lines along the axis are independent so they are spread
+//  across threads.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void BlurAxis(vector<float>& vGrid, const int aDims[3], int axis)
+{
+    int aStrides[3] = { aDims[1] * aDims[2] * c_cellFloats, aDims[2] * c_cellFloats, c_cellFloats };
+    int outer = axis == 0 ? 1 : 0,
+        inner = axis == 2 ? 1 : 2,
+        length = aDims[axis],
+        step = aStrides[axis];
+
+    ParallelFor(0, aDims[outer], [&](int i)
+    {
+        vector<float> vLine(length * c_cellFloats);
+
+        for (int j = 0; j < aDims[inner]; ++j)
+        {
+            float* pLine = &vGrid[i * aStrides[outer] + j * aStrides[inner]];
+            for (int cell = 0; cell < length; ++cell)
+                for (int value = 0; value < c_cellFloats; ++value)
+                    vLine[cell * c_cellFloats + value] = pLine[cell * step + value];
+
+            for (int cell = 0; cell < length; ++cell)
+                for (int value = 0; value < c_cellFloats; ++value)
+                {
+                    float sum = 0;
+                    for (int tap = -c_gridPad; tap <= c_gridPad; ++tap)
+                        if (cell + tap >= 0 && cell + tap < length)
+                            sum += c_aBlurTaps[tap + c_gridPad] * vLine[(cell + tap) * c_cellFloats + value];
+
+                    pLine[cell * step + value] = sum;
+                }// for
+        }// for
+    });
+}// BlurAxis
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Splat, blur and slice.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool BilateralFilter(unsigned char* pData, int width, int height, float sigmaSpace, float sigmaRange)
+{
+    if (!(sigmaSpace >= 1) || !(sigmaRange >= 1))
+        return false;
+
+    if (!pData || width <= 0 || height <= 0)
+        return true;
+
+    // grid dimensions in y, x and range order
+    int aDims[3] = { (int)((height - 1) / sigmaSpace) + 1 + 2 * c_gridPad,
+                     (int)((width - 1) / sigmaSpace) + 1 + 2 * c_gridPad,
+                     (int)(255 / sigmaRange) + 1 + 2 * c_gridPad };
+    if ((long long)aDims[0] * aDims[1] * aDims[2] > c_maxGridCells)
+        return false;
+
+    vector<float> vGrid((size_t)aDims[0] * aDims[1] * aDims[2] * c_cellFloats, 0.f);
+    int rowStride = aDims[1] * aDims[2] * c_cellFloats,
+        columnStride = aDims[2] * c_cellFloats;
+
+    // splat each image row into the nearest grid row; a grid row is only written by one thread
+    vector<int> vFirstRow(aDims[0] + 1, height);
+    for (int y = height - 1; y >= 0; --y)
+        vFirstRow[(int)(y / sigmaSpace + 0.5f) + c_gridPad] = y;
+    for (int gridRow = aDims[0] - 1; gridRow >= 0; --gridRow)
+        vFirstRow[gridRow] = Min(vFirstRow[gridRow], vFirstRow[gridRow + 1]);
+
+    ParallelFor(0, aDims[0], [&](int gridRow)
+    {
+        for (int y = vFirstRow[gridRow]; y < vFirstRow[gridRow + 1]; ++y)
+            for (int x = 0; x < width; ++x)
+            {
+                const unsigned char* pPixel = pData + (y * width + x) * 4;
+                int column = (int)(x / sigmaSpace + 0.5f) + c_gridPad,
+                    level = (int)(GreyLevel(pPixel) / sigmaRange + 0.5f) + c_gridPad;
+                float* pCell = &vGrid[gridRow * rowStride + column * columnStride + level * c_cellFloats];
+
+                for (int channel = 0; channel < 4; ++channel)
+                    pCell[channel] += pPixel[channel];
+                pCell[4] += 1;
+            }// for
+    });
+
+    for (int axis = 0; axis < 3; ++axis)
+        BlurAxis(vGrid, aDims, axis);
+
+    // slice, interpolating between the eight cells around each pixel
+    ParallelFor(0, height, [&](int y)
+    {
+        float gridY = y / sigmaSpace + c_gridPad;
+        int y0 = (int)gridY;
+        float fy = gridY - y0;
+
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char* pPixel = pData + (y * width + x) * 4;
+            float gridX = x / sigmaSpace + c_gridPad,
+                  gridZ = GreyLevel(pPixel) / sigmaRange + c_gridPad;
+            int x0 = (int)gridX,
+                z0 = (int)gridZ;
+            float fx = gridX - x0,
+                  fz = gridZ - z0;
+
+            float aSum[c_cellFloats] = { 0 };
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                int dy = corner >> 2,
+                    dx = (corner >> 1) & 1,
+                    dz = corner & 1;
+                float weight = (dy ? fy : 1 - fy) * (dx ? fx : 1 - fx) * (dz ? fz : 1 - fz);
+                const float* pCell = &vGrid[(y0 + dy) * rowStride + (x0 + dx) * columnStride + (z0 + dz) * c_cellFloats];
+
+                for (int value = 0; value < c_cellFloats; ++value)
+                    aSum[value] += weight * pCell[value];
+            }// for
+
+            if (aSum[4] > 0)
+                for (int channel = 0; channel < 4; ++channel)
+                    pPixel[channel] = (unsigned char)Min(aSum[channel] / aSum[4] + 0.5f, 255.f);
+        }// for
+    });
+
+    return true;
+}// BilateralFilter
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Splat, blur and slice the same grid one cell and one pixel at a time.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool BilateralFilterRef(unsigned char* pData, int width, int height, float sigmaSpace, float sigmaRange)
+{
+    if (!(sigmaSpace >= 1) || !(sigmaRange >= 1))
+        return false;
+
+    if (!pData || width <= 0 || height <= 0)
+        return true;
+
+    int aDims[3] = { (int)((height - 1) / sigmaSpace) + 1 + 2 * c_gridPad,
+                     (int)((width - 1) / sigmaSpace) + 1 + 2 * c_gridPad,
+                     (int)(255 / sigmaRange) + 1 + 2 * c_gridPad };
+    if ((long long)aDims[0] * aDims[1] * aDims[2] > c_maxGridCells)
+        return false;
+
+    vector<float> vGrid((size_t)aDims[0] * aDims[1] * aDims[2] * c_cellFloats, 0.f);
+    int aStrides[3] = { aDims[1] * aDims[2] * c_cellFloats, aDims[2] * c_cellFloats, c_cellFloats };
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            const unsigned char* pPixel = pData + (y * width + x) * 4;
+            int row = (int)(y / sigmaSpace + 0.5f) + c_gridPad,
+                column = (int)(x / sigmaSpace + 0.5f) + c_gridPad,
+                level = (int)(GreyLevel(pPixel) / sigmaRange + 0.5f) + c_gridPad;
+            float* pCell = &vGrid[row * aStrides[0] + column * aStrides[1] + level * aStrides[2]];
+
+            for (int channel = 0; channel < 4; ++channel)
+                pCell[channel] += pPixel[channel];
+            pCell[4] += 1;
+        }// for
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        vector<float> vSource(vGrid);
+        int aCell[3];
+
+        for (aCell[0] = 0; aCell[0] < aDims[0]; ++aCell[0])
+            for (aCell[1] = 0; aCell[1] < aDims[1]; ++aCell[1])
+                for (aCell[2] = 0; aCell[2] < aDims[2]; ++aCell[2])
+                {
+                    int offset = aCell[0] * aStrides[0] + aCell[1] * aStrides[1] + aCell[2] * aStrides[2];
+
+                    for (int value = 0; value < c_cellFloats; ++value)
+                    {
+                        float sum = 0;
+                        for (int tap = -c_gridPad; tap <= c_gridPad; ++tap)
+                            if (aCell[axis] + tap >= 0 && aCell[axis] + tap < aDims[axis])
+                                sum += c_aBlurTaps[tap + c_gridPad] * vSource[offset + tap * aStrides[axis] + value];
+
+                        vGrid[offset + value] = sum;
+                    }// for
+                }// for
+    }// for
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char* pPixel = pData + (y * width + x) * 4;
+            float aGrid[3] = { y / sigmaSpace + c_gridPad, x / sigmaSpace + c_gridPad, GreyLevel(pPixel) / sigmaRange + c_gridPad },
+                  aSum[c_cellFloats] = { 0 };
+
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                float weight = 1;
+                int offset = 0;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    int cell = (int)aGrid[axis],
+                        above = (corner >> (2 - axis)) & 1;
+                    float fraction = aGrid[axis] - cell;
+
+                    weight *= above ? fraction : 1 - fraction;
+                    offset += (cell + above) * aStrides[axis];
+                }// for
+
+                for (int value = 0; value < c_cellFloats; ++value)
+                    aSum[value] += weight * vGrid[offset + value];
+            }// for
+
+            if (aSum[4] > 0)
+                for (int channel = 0; channel < 4; ++channel)
+                    pPixel[channel] = (unsigned char)Min(aSum[channel] / aSum[4] + 0.5f, 255.f);
+        }// for
+
+    return true;
+}// BilateralFilterRef
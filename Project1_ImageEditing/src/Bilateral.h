@@ -0,0 +1,34 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Bilateral.h
+//
+//      Approximate bilateral filter using the bilateral grid of Chen, Paris
+//  and Durand.  Pixels are splatted into a grid downsampled by the spatial
+//  and range sigmas, the grid is blurred and the result is sliced back out
+//  at each pixel, so the cost hardly depends on the spatial sigma.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BILATERAL_H_
+#define _BILATERAL_H_
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter the width x height RGBA image in place.  Pixels are weighted
+//  by distance with standard deviation sigmaSpace pixels and by difference
+//  in grey level with standard deviation sigmaRange levels.  Returns false
+//  if a sigma is out of range or the grid would be too large.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool BilateralFilter(unsigned char* pData, int width, int height, float sigmaSpace, float sigmaRange);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      The same bilateral grid built, blurred and sliced one cell and one
+//  pixel at a time on the calling thread.  Kept as the reference
+//  BilateralFilter is checked against.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool BilateralFilterRef(unsigned char* pData, int width, int height, float sigmaSpace, float sigmaRange);
+
+#endif // _BILATERAL_H_
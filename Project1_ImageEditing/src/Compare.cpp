@@ -0,0 +1,340 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Compare.cpp
+//
+//      Differential check of the fast image operations against the
+//  reference backend.  Every operation runs in both backends on random
+//  images with awkward shapes (single pixels, one pixel wide or high, odd
+//  sizes, blocks that don't divide evenly) and alpha at its extremes.  For
+//  each operation the largest difference in any channel is reported with
+//  the image and pixel where it occurred.  The exit code is 1 if any
+//  operation differs by more than its tolerance, or succeeds in one
+//  backend and fails in the other.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "TargaImage.h"
+#include "Random.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// constants
+const int           c_aFixedShapes[][2]     = { { 1, 1 }, { 1, 17 }, { 17, 1 }, { 2, 3 }, { 3, 2 }, { 7, 5 },
+                                                { 16, 16 }, { 33, 31 }, { 101, 67 }, { 263, 257 } };
+const int           c_defaultRandomShapes   = 8;                    // random shapes added to the fixed ones
+const int           c_maxRandomSide         = 160;                  // largest side of a random shape
+const unsigned int  c_defaultSeed           = 1;
+const int           c_layerCount            = 3;                    // layers for the compositing operations
+const int           c_kernelSizes[]         = { 3, 5, 15, 255 };    // filter-kernel sides, 15 and up go through the FFT
+const int           c_maxKernelSide         = 17;                   // largest image side the 255 kernel runs on
+
+// an operation on image; apLayers are other images of the same size
+typedef bool (*FOperation)(TargaImage& image, TargaImage* const* apLayers);
+
+struct SOperation
+{
+    const char*     sName;          // script line the operation matches
+    FOperation      operation;
+    int             tolerance;      // largest channel difference accepted
+    int             maxSide;        // largest image side it runs on, 0 for any
+};
+
+struct SDifference
+{
+    int             error;          // largest channel difference so far
+    int             width;          // size of the image it was in
+    int             height;
+    int             x;              // where it was
+    int             y;
+    int             channel;
+    bool            bMismatch;      // the backends disagreed on success or result size
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter with a square kernel of mixed sign weights, so that sums are
+//  clamped at both ends.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool FilterRandomKernel(TargaImage& image, int size)
+{
+    vector<float> vKernel(size * size);
+    float sum = 0;
+    for (int i = 0; i < size * size; ++i)
+    {
+        vKernel[i] = (float)RandomInt(c_defaultSeed, i, 9) - 2;
+        sum += vKernel[i];
+    }// for
+
+    return image.Filter_Kernel(&vKernel[0], size, sum ? sum : 1);
+}// FilterRandomKernel
+
+
+// every operation with the script line it matches.  FFT convolution rounds differently from direct
+// sums, and a compiler that fuses the bilateral grid's multiply-adds in one backend but not the
+// other can move a rounding by one.  The 255 kernel runs only on small images, to cover FFT sizes
+// picked for an image much smaller than the kernel; the reference's direct sum is slow on more.
+const SOperation c_aOperations[] =
+{
+    { "gray",                   [](TargaImage& image, TargaImage* const*) { return image.To_Grayscale(); }, 0 },
+    { "quant-unif",             [](TargaImage& image, TargaImage* const*) { return image.Quant_Uniform(); }, 0 },
+    { "quant-pop",              [](TargaImage& image, TargaImage* const*) { return image.Quant_Populosity(); }, 0 },
+    { "dither-thresh",          [](TargaImage& image, TargaImage* const*) { return image.Dither_Threshold(); }, 0 },
+    { "dither-rand",            [](TargaImage& image, TargaImage* const*) { return image.Dither_Random(); }, 0 },
+    { "dither-fs",              [](TargaImage& image, TargaImage* const*) { return image.Dither_FS(); }, 0 },
+    { "dither-bright",          [](TargaImage& image, TargaImage* const*) { return image.Dither_Bright(); }, 0 },
+    { "dither-cluster",         [](TargaImage& image, TargaImage* const*) { return image.Dither_Cluster(); }, 0 },
+    { "dither-pattern 2",       [](TargaImage& image, TargaImage* const*) { return image.Dither_Pattern(2); }, 0 },
+    { "dither-pattern 8",       [](TargaImage& image, TargaImage* const*) { return image.Dither_Pattern(8); }, 0 },
+    { "dither-pattern 16",      [](TargaImage& image, TargaImage* const*) { return image.Dither_Pattern(16); }, 0 },
+    { "dither-pattern 8 cluster", [](TargaImage& image, TargaImage* const*) { return image.Dither_Pattern(8, MATRIX_CLUSTER); }, 0 },
+    { "dither-color",           [](TargaImage& image, TargaImage* const*) { return image.Dither_Color(); }, 0 },
+    { "filter-box",             [](TargaImage& image, TargaImage* const*) { return image.Filter_Box(); }, 0 },
+    { "filter-bartlett",        [](TargaImage& image, TargaImage* const*) { return image.Filter_Bartlett(); }, 0 },
+    { "filter-gauss",           [](TargaImage& image, TargaImage* const*) { return image.Filter_Gaussian(); }, 0 },
+    { "filter-gauss-n 7",       [](TargaImage& image, TargaImage* const*) { return image.Filter_Gaussian_N(7); }, 0 },
+    { "filter-edge",            [](TargaImage& image, TargaImage* const*) { return image.Filter_Edge(); }, 0 },
+    { "filter-enhance",         [](TargaImage& image, TargaImage* const*) { return image.Filter_Enhance(); }, 0 },
+    { "filter-median 0",        [](TargaImage& image, TargaImage* const*) { return image.Filter_Median(0); }, 0 },
+    { "filter-median 1",        [](TargaImage& image, TargaImage* const*) { return image.Filter_Median(1); }, 0 },
+    { "filter-median 4",        [](TargaImage& image, TargaImage* const*) { return image.Filter_Median(4); }, 0 },
+    { "filter-bilateral 3 24",  [](TargaImage& image, TargaImage* const*) { return image.Filter_Bilateral(3, 24); }, 1 },
+    { "filter-kernel 3",        [](TargaImage& image, TargaImage* const*) { return FilterRandomKernel(image, c_kernelSizes[0]); }, 0 },
+    { "filter-kernel 5",        [](TargaImage& image, TargaImage* const*) { return FilterRandomKernel(image, c_kernelSizes[1]); }, 0 },
+    { "filter-kernel 15",       [](TargaImage& image, TargaImage* const*) { return FilterRandomKernel(image, c_kernelSizes[2]); }, 1 },
+    { "filter-kernel 255",      [](TargaImage& image, TargaImage* const*) { return FilterRandomKernel(image, c_kernelSizes[3]); }, 1, c_maxKernelSide },
+    { "erode 1 1",              [](TargaImage& image, TargaImage* const*) { return image.Morphology(MORPH_ERODE, 1, 1); }, 0 },
+    { "erode 4 3",              [](TargaImage& image, TargaImage* const*) { return image.Morphology(MORPH_ERODE, 4, 3); }, 0 },
+    { "dilate 4 3",             [](TargaImage& image, TargaImage* const*) { return image.Morphology(MORPH_DILATE, 4, 3); }, 0 },
+    { "open 9 1",               [](TargaImage& image, TargaImage* const*) { return image.Morphology(MORPH_OPEN, 9, 1); }, 0 },
+    { "close 2 40",             [](TargaImage& image, TargaImage* const*) { return image.Morphology(MORPH_CLOSE, 2, 40); }, 0 },
+    { "distance",               [](TargaImage& image, TargaImage* const*) { return image.Distance_Field(); }, 0 },
+    { "npr-paint",              [](TargaImage& image, TargaImage* const*) { return image.NPR_Paint(); }, 0 },
+    { "half",                   [](TargaImage& image, TargaImage* const*) { return image.Half_Size(); }, 0 },
+    { "double",                 [](TargaImage& image, TargaImage* const*) { return image.Double_Size(); }, 0 },
+    { "scale 1.5",              [](TargaImage& image, TargaImage* const*) { return image.Resize(1.5f); }, 0 },
+    { "rotate 30",              [](TargaImage& image, TargaImage* const*) { return image.Rotate(30); }, 0 },
+    { "comp-over",              [](TargaImage& image, TargaImage* const* apLayers) { return image.Comp_Over(apLayers[0]); }, 0 },
+    { "comp-in",                [](TargaImage& image, TargaImage* const* apLayers) { return image.Comp_In(apLayers[0]); }, 0 },
+    { "comp-out",               [](TargaImage& image, TargaImage* const* apLayers) { return image.Comp_Out(apLayers[0]); }, 0 },
+    { "comp-atop",              [](TargaImage& image, TargaImage* const* apLayers) { return image.Comp_Atop(apLayers[0]); }, 0 },
+    { "comp-xor",               [](TargaImage& image, TargaImage* const* apLayers) { return image.Comp_Xor(apLayers[0]); }, 0 },
+    { "composite over in xor",  [](TargaImage& image, TargaImage* const* apLayers)
+                                {
+                                    ECompositeOp aOps[c_layerCount] = { COMPOSITE_OVER, COMPOSITE_IN, COMPOSITE_XOR };
+                                    return image.Composite(aOps, apLayers, c_layerCount);
+                                }, 0 },
+    { "diff",                   [](TargaImage& image, TargaImage* const* apLayers) { return image.Difference(apLayers[0]); }, 0 },
+};
+
+const int c_operationCount = sizeof(c_aOperations) / sizeof(c_aOperations[0]);
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Fill the image with random premultiplied pixels.  Alpha is 0 or 255
+//  for most pixels and random for the rest; colour never exceeds alpha.
+//  A few rows and columns are flat so that runs and ties appear.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void MakeImage(TargaImage& image, unsigned int seed)
+{
+    for (int y = 0; y < image.height; ++y)
+        for (int x = 0; x < image.width; ++x)
+        {
+            uint64_t index = (y % 11 == 5 || x % 13 == 7) ? 0 : (uint64_t)y * image.width + x + 1;
+            uint32_t bits = RandomBits(seed, index);
+            int alpha = (bits >> 24) % 3 == 0 ? 0 : (bits >> 24) % 3 == 1 ? 255 : (int)(bits >> 16 & 0xFF);
+
+            unsigned char* pPixel = image.data + ((size_t)y * image.width + x) * 4;
+            for (int channel = 0; channel < 3; ++channel)
+                pPixel[channel] = (unsigned char)((bits >> channel * 8 & 0xFF) * alpha / 255);
+            pPixel[3] = (unsigned char)alpha;
+        }// for
+}// MakeImage
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Run the operation on copies of the image in both backends and fold
+//  the largest channel difference into difference.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void CompareOperation(const SOperation& operation, const TargaImage& source, TargaImage* const* apLayers,
+                             unsigned int seed, SDifference& difference)
+{
+    TargaImage reference(source),
+               fast(source);
+
+    TargaImage::random_seed = seed;
+    TargaImage::backend = BACKEND_REFERENCE;
+    bool bReference = operation.operation(reference, apLayers);
+
+    TargaImage::backend = BACKEND_FAST;
+    bool bFast = operation.operation(fast, apLayers);
+
+    if (bReference != bFast || reference.width != fast.width || reference.height != fast.height)
+    {
+        if (!difference.bMismatch)
+        {
+            cout << "  " << operation.sName << " on " << source.width << " x " << source.height << ": reference "
+                 << (bReference ? "succeeded" : "failed") << " with " << reference.width << " x " << reference.height
+                 << ", fast " << (bFast ? "succeeded" : "failed") << " with " << fast.width << " x " << fast.height << endl;
+        }// if
+
+        difference.bMismatch = true;
+        return;
+    }// if
+
+    for (int y = 0; y < fast.height; ++y)
+        for (int x = 0; x < fast.width; ++x)
+            for (int channel = 0; channel < 4; ++channel)
+            {
+                size_t offset = ((size_t)y * fast.width + x) * 4 + channel;
+                int error = abs(fast.data[offset] - reference.data[offset]);
+                if (error <= difference.error)
+                    continue;
+
+                SDifference worst = { error, source.width, source.height, x, y, channel, difference.bMismatch };
+                difference = worst;
+            }// for
+}// CompareOperation
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the operation's command is in the comma separated
+//  list, or there is no list.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool IsSelected(const char* sOnly, const char* sName)
+{
+    if (!sOnly)
+        return true;
+
+    size_t commandLength = strcspn(sName, " ");
+    for (const char* sItem = sOnly; *sItem; sItem += strcspn(sItem, ","), sItem += *sItem == ',')
+        if (strcspn(sItem, ",") == commandLength && !strncmp(sItem, sName, commandLength))
+            return true;
+
+    return false;
+}// IsSelected
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Print the command line usage.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void Usage()
+{
+    cerr << "Usage:" << endl
+         << "ImageCompare [-seed n] [-shapes n] [-ops name,name]" << endl;
+}// Usage
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Main function.  Handle command line arguments and compare every
+//  operation.  Returns 1 if any operation is out of tolerance and 2 on bad
+//  arguments.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+{
+    unsigned int seed = c_defaultSeed;
+    int randomShapes = c_defaultRandomShapes;
+    const char* sOnly = NULL;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc)
+        {
+            Usage();
+            return 2;
+        }// if
+
+        if (!strcmp(argv[i], "-seed"))
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        else if (!strcmp(argv[i], "-shapes"))
+            randomShapes = Max(atoi(argv[i + 1]), 0);
+        else if (!strcmp(argv[i], "-ops"))
+            sOnly = argv[i + 1];
+        else
+        {
+            Usage();
+            return 2;
+        }// else
+
+        ++i;
+    }// for
+
+    vector<pair<int, int> > vShapes;
+    for (size_t shape = 0; shape < sizeof(c_aFixedShapes) / sizeof(c_aFixedShapes[0]); ++shape)
+        vShapes.push_back(make_pair(c_aFixedShapes[shape][0], c_aFixedShapes[shape][1]));
+    for (int shape = 0; shape < randomShapes; ++shape)
+        vShapes.push_back(make_pair(1 + RandomInt(seed, 2 * shape, c_maxRandomSide),
+                                    1 + RandomInt(seed, 2 * shape + 1, c_maxRandomSide)));
+
+    vector<SDifference> vDifferences(c_operationCount);
+    for (int shape = 0; shape < (int)vShapes.size(); ++shape)
+    {
+        int width = vShapes[shape].first,
+            height = vShapes[shape].second;
+        unsigned int imageSeed = seed + shape * (c_layerCount + 1);
+
+        TargaImage source(width, height);
+        MakeImage(source, imageSeed);
+
+        vector<TargaImage*> vpLayers(c_layerCount);
+        for (int layer = 0; layer < c_layerCount; ++layer)
+        {
+            vpLayers[layer] = new TargaImage(width, height);
+            MakeImage(*vpLayers[layer], imageSeed + 1 + layer);
+        }// for
+
+        for (int op = 0; op < c_operationCount; ++op)
+        {
+            if (!IsSelected(sOnly, c_aOperations[op].sName) ||
+                (c_aOperations[op].maxSide && Max(width, height) > c_aOperations[op].maxSide))
+                continue;
+
+            CompareOperation(c_aOperations[op], source, &vpLayers[0], imageSeed, vDifferences[op]);
+        }// for
+
+        for_each(vpLayers.begin(), vpLayers.end(), FDelete<TargaImage*>());
+    }// for
+
+    cout << "Compared on " << vShapes.size() << " images, seed " << seed << endl
+         << left << setw(26) << "operation" << right << setw(8) << "error" << setw(8) << "limit" << "  where" << endl;
+
+    bool bFailed = false;
+    for (int op = 0; op < c_operationCount; ++op)
+    {
+        const SOperation& operation = c_aOperations[op];
+        if (!IsSelected(sOnly, operation.sName))
+            continue;
+
+        const SDifference& difference = vDifferences[op];
+        bool bPassed = !difference.bMismatch && difference.error <= operation.tolerance;
+        bFailed |= !bPassed;
+
+        cout << left << setw(26) << operation.sName << right << setw(8) << difference.error << setw(8) << operation.tolerance;
+        if (difference.error)
+            cout << "  " << difference.width << " x " << difference.height << " at (" << difference.x << ", "
+                 << difference.y << ") channel " << difference.channel;
+        if (difference.bMismatch)
+            cout << "  backends disagree on success or size";
+        cout << (bPassed ? "" : "  FAILED") << endl;
+    }// for
+
+    return bFailed ? 1 : 0;
+}// main
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Composite.cpp
+//
+//      Implementation of the compositing stack.  Each block of pixels is
+//  loaded once, run through every layer while it stays in registers and
+//  stored once.  SSE2 handles four pixels at a time in 16 bit lanes; the
+//  scalar code does the same arithmetic for the remainder and for builds
+//  without SSE2, so both give identical results.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "Composite.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define COMPOSITE_SSE2
+    #include <emmintrin.h>
+#endif
+
+// constants
+const char      c_asOpNames[][8]        = { "over", "in", "out", "atop", "xor" };    // indexed by ECompositeOp
+const int       c_blockPixels           = 1 << 16;                      // pixels handed to one thread at a time
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Look up an operator by name.  Returns NUM_COMPOSITE_OPS if the name is
+//  not an operator.
+//
+///////////////////////////////////////////////////////////////////////////////
+ECompositeOp CompositeOpFromName(const char* sName)
+{
+    int op;
+    for (op = 0; op < NUM_COMPOSITE_OPS; ++op)
+        if (sName && !strcmp(sName, c_asOpNames[op]))
+            break;
+
+    return (ECompositeOp)op;
+}// CompositeOpFromName
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      x / 255 rounded to nearest, for 0 <= x <= 255 * 255.  The additions
+//  saturate at 16 bits exactly as the SSE2 version does.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline unsigned int Div255(unsigned int x)
+{
+    x = Min(x + 128, 0xFFFFu);
+    return Min(x + (x >> 8), 0xFFFFu) >> 8;
+}// Div255
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Apply one operator to one pixel.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline void CompositePixel(unsigned char* pAcc, const unsigned char* pLayer, ECompositeOp op)
+{
+    unsigned int invAlphaA = 255 - pAcc[3],
+                 alphaB = pLayer[3],
+                 invAlphaB = 255 - pLayer[3];
+
+    for (int channel = 0; channel < 4; ++channel)
+    {
+        unsigned int a = pAcc[channel],
+                     b = pLayer[channel],
+                     result = 0;
+
+        switch (op)
+        {
+            case COMPOSITE_OVER:    result = a + Div255(b * invAlphaA);                             break;
+            case COMPOSITE_IN:      result = Div255(a * alphaB);                                    break;
+            case COMPOSITE_OUT:     result = Div255(a * invAlphaB);                                 break;
+            case COMPOSITE_ATOP:    result = Div255(Min(a * alphaB + b * invAlphaA, 0xFFFFu));      break;
+            case COMPOSITE_XOR:     result = Div255(Min(a * invAlphaB + b * invAlphaA, 0xFFFFu));   break;
+            default:                result = a;                                                     break;
+        }// switch
+
+        pAcc[channel] = (unsigned char)Min(result, 255u);
+    }// for
+}// CompositePixel
+
+
+#ifdef COMPOSITE_SSE2
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Div255 on eight 16 bit lanes.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline __m128i Div255(__m128i x)
+{
+    x = _mm_adds_epu16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_adds_epu16(x, _mm_srli_epi16(x, 8)), 8);
+}// Div255
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Copy each pixel's alpha into all four of its lanes.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline __m128i SpreadAlpha(__m128i pixels)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xFF), 0xFF);
+}// SpreadAlpha
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Apply one operator to two pixels widened to 16 bit lanes.  The result
+//  may exceed 255 and is clamped by the caller.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline __m128i CompositeLanes(__m128i a, __m128i b, ECompositeOp op)
+{
+    const __m128i c_max = _mm_set1_epi16(255);
+    __m128i invAlphaA = _mm_sub_epi16(c_max, SpreadAlpha(a)),
+            alphaB = SpreadAlpha(b),
+            invAlphaB = _mm_sub_epi16(c_max, alphaB);
+
+    switch (op)
+    {
+        case COMPOSITE_OVER:    return _mm_add_epi16(a, Div255(_mm_mullo_epi16(b, invAlphaA)));
+        case COMPOSITE_IN:      return Div255(_mm_mullo_epi16(a, alphaB));
+        case COMPOSITE_OUT:     return Div255(_mm_mullo_epi16(a, invAlphaB));
+        case COMPOSITE_ATOP:    return Div255(_mm_adds_epu16(_mm_mullo_epi16(a, alphaB), _mm_mullo_epi16(b, invAlphaA)));
+        case COMPOSITE_XOR:     return Div255(_mm_adds_epu16(_mm_mullo_epi16(a, invAlphaB), _mm_mullo_epi16(b, invAlphaA)));
+        default:                return a;
+    }// switch
+}// CompositeLanes
+
+#endif // COMPOSITE_SSE2
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Composite the pixels [first, end) through the whole stack.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void CompositeBlock(unsigned char* pData, int first, int end, const ECompositeOp* aOps,
+                           const unsigned char* const* apLayers, int layerCount)
+{
+    int pixel = first;
+
+#ifdef COMPOSITE_SSE2
+    const __m128i c_zero = _mm_setzero_si128(),
+                  c_max = _mm_set1_epi16(255);
+    for (; pixel + 4 <= end; pixel += 4)
+    {
+        __m128i acc = _mm_loadu_si128((const __m128i*)(pData + pixel * 4));
+        __m128i accLo = _mm_unpacklo_epi8(acc, c_zero),
+                accHi = _mm_unpackhi_epi8(acc, c_zero);
+
+        for (int layer = 0; layer < layerCount; ++layer)
+        {
+            __m128i src = _mm_loadu_si128((const __m128i*)(apLayers[layer] + pixel * 4));
+
+            // clamp after each layer, as the scalar code does when it stores
+            accLo = _mm_min_epi16(CompositeLanes(accLo, _mm_unpacklo_epi8(src, c_zero), aOps[layer]), c_max);
+            accHi = _mm_min_epi16(CompositeLanes(accHi, _mm_unpackhi_epi8(src, c_zero), aOps[layer]), c_max);
+        }// for
+
+        _mm_storeu_si128((__m128i*)(pData + pixel * 4), _mm_packus_epi16(accLo, accHi));
+    }// for
+#endif
+
+    for (; pixel < end; ++pixel)
+        for (int layer = 0; layer < layerCount; ++layer)
+            CompositePixel(pData + pixel * 4, apLayers[layer] + pixel * 4, aOps[layer]);
+}// CompositeBlock
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Replace each pixel of pData with ((pData op[0] layer[0]) op[1]
+//  layer[1]) ... .  Blocks of pixels are spread across threads.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CompositeLayers(unsigned char* pData, int pixelCount, const ECompositeOp* aOps,
+                     const unsigned char* const* apLayers, int layerCount)
+{
+    if (!pData || pixelCount <= 0 || layerCount <= 0)
+        return;
+
+    int blocks = (pixelCount + c_blockPixels - 1) / c_blockPixels;
+    ParallelFor(0, blocks, [=](int block)
+    {
+        int first = block * c_blockPixels;
+        CompositeBlock(pData, first, Min(pixelCount, first + c_blockPixels), aOps, apLayers, layerCount);
+    });
+}// CompositeLayers
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Composite one pixel at a time on the calling thread.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CompositeLayersRef(unsigned char* pData, int pixelCount, const ECompositeOp* aOps,
+                        const unsigned char* const* apLayers, int layerCount)
+{
+    if (!pData)
+        return;
+
+    for (int pixel = 0; pixel < pixelCount; ++pixel)
+        for (int layer = 0; layer < layerCount; ++layer)
+            CompositePixel(pData + pixel * 4, apLayers[layer] + pixel * 4, aOps[layer]);
+}// CompositeLayersRef
@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Composite.h
+//
+//      Porter-Duff compositing of premultiplied RGBA layers.  A whole stack
+//  of layers is applied per pixel in one pass using integer arithmetic with
+//  exact rounding of the divide by 255.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _COMPOSITE_H_
+#define _COMPOSITE_H_
+
+enum ECompositeOp       // Porter-Duff operators, "accumulated op layer"
+{
+    COMPOSITE_OVER,
+    COMPOSITE_IN,
+    COMPOSITE_OUT,
+    COMPOSITE_ATOP,
+    COMPOSITE_XOR,
+    NUM_COMPOSITE_OPS
+};// ECompositeOp
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Look up an operator by name ("over", "in", "out", "atop", "xor").
+//  Returns NUM_COMPOSITE_OPS if the name is not an operator.
+//
+///////////////////////////////////////////////////////////////////////////////
+ECompositeOp CompositeOpFromName(const char* sName);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Replace each pixel of pData with ((pData op[0] layer[0]) op[1]
+//  layer[1]) ... .  Every layer holds pixelCount premultiplied RGBA pixels.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CompositeLayers(unsigned char* pData, int pixelCount, const ECompositeOp* aOps,
+                     const unsigned char* const* apLayers, int layerCount);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      The same on one thread with the scalar code only.  Kept as the
+//  reference CompositeLayers is checked against.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CompositeLayersRef(unsigned char* pData, int pixelCount, const ECompositeOp* aOps,
+                        const unsigned char* const* apLayers, int layerCount);
+
+#endif // _COMPOSITE_H_
@@ -0,0 +1,736 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Convolution.cpp
+//
+//      Implementation of the integer convolution path.  Rows are treated as
+//  byte arrays so sixteen channel values, four pixels, are filtered at once
+//  with SSE2; neighbouring pixels in a row are four bytes apart.  Rows are
+//  spread across threads.  Float kernels use a direct loop or a radix 2
+//  FFT with overlap-add.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "Convolution.h"
+#include <math.h>
+#include <complex>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define CONVOLUTION_SSE2
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// constants
+const unsigned int  c_maxSum            = 0xFFFF;                       // largest weighted sum a 16 bit lane holds
+const int           c_maxKernelSize     = 1024;                         // largest side read from a kernel file
+const double        c_twoPi             = 6.283185307179586;            // FFT twiddle angles are computed in double
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Find a multiplier and shift with (x * multiplier) >> (16 + shift) equal
+//  to x / divisor for every x up to maxValue.  Returns false if there is
+//  none that fits in 16 bits.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool FindReciprocal(unsigned int divisor, unsigned int maxValue, unsigned int& multiplier, int& shift)
+{
+    for (shift = 0; shift < 16; ++shift)
+    {
+        unsigned long long candidate = ((1ull << (16 + shift)) + divisor - 1) / divisor;
+        if (candidate > 0xFFFF)
+            continue;
+
+        bool bExact = true;
+        for (unsigned int x = 0; x <= maxValue && bExact; ++x)
+            bExact = ((x * candidate) >> (16 + shift)) == x / divisor;
+
+        if (bExact)
+        {
+            multiplier = (unsigned int)candidate;
+            return true;
+        }// if
+    }// for
+
+    return false;
+}// FindReciprocal
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Convert a float kernel and divisor to integers.  Returns false if a
+//  weight or the divisor is not a non-negative integer, or if a weighted sum
+//  of bytes could overflow 16 bits.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool MakeIntegerKernel(const float* pMatrix, float divide, int width, int height, SIntegerKernel& kernel)
+{
+    if (divide < 1 || divide != floorf(divide) || divide > c_maxSum)
+        return false;
+
+    kernel.width = width;
+    kernel.height = height;
+    kernel.vWeights.resize(width * height);
+
+    unsigned int weightSum = 0;
+    for (int i = 0; i < width * height; ++i)
+    {
+        if (pMatrix[i] < 0 || pMatrix[i] != floorf(pMatrix[i]) || pMatrix[i] > c_maxSum)
+            return false;
+
+        kernel.vWeights[i] = (int)pMatrix[i];
+        weightSum += kernel.vWeights[i];
+        if (weightSum * 255 > c_maxSum)
+            return false;
+    }// for
+
+    kernel.divisor = (unsigned int)divide;
+    kernel.bReciprocal = FindReciprocal(kernel.divisor, weightSum * 255, kernel.multiplier, kernel.shift);
+    return true;
+}// MakeIntegerKernel
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the kernel window around the given pixel lies inside
+//  the image.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool IsInteriorPixel(int x, int y, int width, int height, int kernelWidth, int kernelHeight)
+{
+    return x - (kernelWidth - 1) / 2 >= 0 && x + kernelWidth / 2 < width &&
+           y - (kernelHeight - 1) / 2 >= 0 && y + kernelHeight / 2 < height;
+}// IsInteriorPixel
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter the red, green and blue channels of every interior pixel with
+//  a kernel of any size, visiting only the taps with a weight.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void ConvolveInteriorAnySize(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                      const SIntegerKernel& kernel)
+{
+    int yMin = -(kernel.height - 1) / 2,
+        yMax = kernel.height / 2,
+        xMin = -(kernel.width - 1) / 2,
+        xMax = kernel.width / 2;
+    int rowBytes = width * 4,
+        firstByte = -xMin * 4,
+        endByte = (width - xMax) * 4;
+
+    if (firstByte >= endByte || -yMin >= height - yMax)
+        return;
+
+    // only taps with a weight are visited; each is a row and a byte offset
+    vector<int> vTapRows, vTapOffsets, vTapWeights;
+    for (int ky = 0; ky < kernel.height; ++ky)
+        for (int kx = 0; kx < kernel.width; ++kx)
+            if (kernel.vWeights[ky * kernel.width + kx])
+            {
+                vTapRows.push_back(ky + yMin);
+                vTapOffsets.push_back((kx + xMin) * 4);
+                vTapWeights.push_back(kernel.vWeights[ky * kernel.width + kx]);
+            }// if
+    int taps = (int)vTapWeights.size();
+
+    ParallelFor(-yMin, height - yMax, [&](int row)
+    {
+        const unsigned char* pRow = pSrc + row * rowBytes;
+        unsigned char* pOut = pDst + row * rowBytes;
+        int i = firstByte;
+
+#ifdef CONVOLUTION_SSE2
+        if (kernel.bReciprocal)
+        {
+            const __m128i c_zero = _mm_setzero_si128(),
+                          c_rgbMask = _mm_set1_epi32(0x00FFFFFF),
+                          c_multiplier = _mm_set1_epi16((short)kernel.multiplier);
+            const __m128i c_shift = _mm_cvtsi32_si128(kernel.shift);
+
+            for (; i + 16 <= endByte; i += 16)
+            {
+                __m128i sumLo = c_zero,
+                        sumHi = c_zero;
+
+                for (int tap = 0; tap < taps; ++tap)
+                {
+                    __m128i pixels = _mm_loadu_si128((const __m128i*)(pRow + vTapRows[tap] * rowBytes + i + vTapOffsets[tap]));
+                    __m128i weight = _mm_set1_epi16((short)vTapWeights[tap]);
+                    sumLo = _mm_add_epi16(sumLo, _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, c_zero), weight));
+                    sumHi = _mm_add_epi16(sumHi, _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, c_zero), weight));
+                }// for
+
+                sumLo = _mm_srl_epi16(_mm_mulhi_epu16(sumLo, c_multiplier), c_shift);
+                sumHi = _mm_srl_epi16(_mm_mulhi_epu16(sumHi, c_multiplier), c_shift);
+
+                __m128i result = _mm_packus_epi16(sumLo, sumHi),
+                        old = _mm_loadu_si128((const __m128i*)(pOut + i));
+                result = _mm_or_si128(_mm_and_si128(c_rgbMask, result), _mm_andnot_si128(c_rgbMask, old));
+                _mm_storeu_si128((__m128i*)(pOut + i), result);
+            }// for
+        }// if
+#endif
+
+        for (; i < endByte; ++i)
+        {
+            if ((i & 3) == 3)
+                continue;
+
+            unsigned int sum = 0;
+            for (int tap = 0; tap < taps; ++tap)
+                sum += pRow[vTapRows[tap] * rowBytes + i + vTapOffsets[tap]] * vTapWeights[tap];
+
+            pOut[i] = (unsigned char)Min(sum / kernel.divisor, 255u);
+        }// for
+    });
+}// ConvolveInteriorAnySize
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter the red, green and blue channels of every interior pixel with
+//  a KW x KH kernel.  The tap loops have constant trip counts so the
+//  compiler unrolls them completely.
+//
+///////////////////////////////////////////////////////////////////////////////
+template<int KW, int KH> void ConvolveInteriorSized(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                                                    const SIntegerKernel& kernel)
+{
+    const int c_yMin = -(KH - 1) / 2,
+              c_yMax = KH / 2,
+              c_xMin = -(KW - 1) / 2,
+              c_xMax = KW / 2;
+    int rowBytes = width * 4,
+        firstByte = -c_xMin * 4,
+        endByte = (width - c_xMax) * 4;
+
+    if (firstByte >= endByte || -c_yMin >= height - c_yMax)
+        return;
+
+    int aWeights[KH][KW];
+    for (int ky = 0; ky < KH; ++ky)
+        for (int kx = 0; kx < KW; ++kx)
+            aWeights[ky][kx] = kernel.vWeights[ky * KW + kx];
+
+    ParallelFor(-c_yMin, height - c_yMax, [&](int row)
+    {
+        const unsigned char* pRow = pSrc + row * rowBytes;
+        unsigned char* pOut = pDst + row * rowBytes;
+        int i = firstByte;
+
+#ifdef CONVOLUTION_SSE2
+        if (kernel.bReciprocal)
+        {
+            const __m128i c_zero = _mm_setzero_si128(),
+                          c_rgbMask = _mm_set1_epi32(0x00FFFFFF),
+                          c_multiplier = _mm_set1_epi16((short)kernel.multiplier);
+            const __m128i c_shift = _mm_cvtsi32_si128(kernel.shift);
+
+            __m128i aWeightLanes[KH][KW];
+            for (int ky = 0; ky < KH; ++ky)
+                for (int kx = 0; kx < KW; ++kx)
+                    aWeightLanes[ky][kx] = _mm_set1_epi16((short)aWeights[ky][kx]);
+
+            for (; i + 16 <= endByte; i += 16)
+            {
+                __m128i sumLo = c_zero,
+                        sumHi = c_zero;
+
+                for (int ky = 0; ky < KH; ++ky)
+                    for (int kx = 0; kx < KW; ++kx)
+                    {
+                        __m128i pixels = _mm_loadu_si128((const __m128i*)(pRow + (ky + c_yMin) * rowBytes + i + (kx + c_xMin) * 4));
+                        sumLo = _mm_add_epi16(sumLo, _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, c_zero), aWeightLanes[ky][kx]));
+                        sumHi = _mm_add_epi16(sumHi, _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, c_zero), aWeightLanes[ky][kx]));
+                    }// for
+
+                sumLo = _mm_srl_epi16(_mm_mulhi_epu16(sumLo, c_multiplier), c_shift);
+                sumHi = _mm_srl_epi16(_mm_mulhi_epu16(sumHi, c_multiplier), c_shift);
+
+                __m128i result = _mm_packus_epi16(sumLo, sumHi),
+                        old = _mm_loadu_si128((const __m128i*)(pOut + i));
+                result = _mm_or_si128(_mm_and_si128(c_rgbMask, result), _mm_andnot_si128(c_rgbMask, old));
+                _mm_storeu_si128((__m128i*)(pOut + i), result);
+            }// for
+        }// if
+#endif
+
+        for (; i < endByte; ++i)
+        {
+            if ((i & 3) == 3)
+                continue;
+
+            unsigned int sum = 0;
+            for (int ky = 0; ky < KH; ++ky)
+                for (int kx = 0; kx < KW; ++kx)
+                    sum += pRow[(ky + c_yMin) * rowBytes + i + (kx + c_xMin) * 4] * aWeights[ky][kx];
+
+            pOut[i] = (unsigned char)Min(sum / kernel.divisor, 255u);
+        }// for
+    });
+}// ConvolveInteriorSized
+
+// the shapes used by the canned filters, Half_Size, Double_Size and Rotate
+template void ConvolveInteriorSized<3, 3>(const unsigned char*, unsigned char*, int, int, const SIntegerKernel&);
+template void ConvolveInteriorSized<3, 4>(const unsigned char*, unsigned char*, int, int, const SIntegerKernel&);
+template void ConvolveInteriorSized<4, 3>(const unsigned char*, unsigned char*, int, int, const SIntegerKernel&);
+template void ConvolveInteriorSized<4, 4>(const unsigned char*, unsigned char*, int, int, const SIntegerKernel&);
+template void ConvolveInteriorSized<5, 5>(const unsigned char*, unsigned char*, int, int, const SIntegerKernel&);
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter the red, green and blue channels of every interior pixel,
+//  using an unrolled kernel when there is one for the shape.
+//
+///////////////////////////////////////////////////////////////////////////////
+void ConvolveInterior(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                      const SIntegerKernel& kernel)
+{
+    int kw = kernel.width,
+        kh = kernel.height;
+
+    if (kw == 3 && kh == 3)
+        ConvolveInteriorSized<3, 3>(pSrc, pDst, width, height, kernel);
+    else if (kw == 3 && kh == 4)
+        ConvolveInteriorSized<3, 4>(pSrc, pDst, width, height, kernel);
+    else if (kw == 4 && kh == 3)
+        ConvolveInteriorSized<4, 3>(pSrc, pDst, width, height, kernel);
+    else if (kw == 4 && kh == 4)
+        ConvolveInteriorSized<4, 4>(pSrc, pDst, width, height, kernel);
+    else if (kw == 5 && kh == 5)
+        ConvolveInteriorSized<5, 5>(pSrc, pDst, width, height, kernel);
+    else
+        ConvolveInteriorAnySize(pSrc, pDst, width, height, kernel);
+}// ConvolveInterior
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter the even pixels of the even rows into a half size image.  With
+//  SSE2 eight source pixels are loaded per tap and the even four kept, so
+//  four output pixels are filtered at once.
+//
+///////////////////////////////////////////////////////////////////////////////
+void ConvolveInteriorHalf(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                          const SIntegerKernel& kernel)
+{
+    int yMin = -(kernel.height - 1) / 2,
+        yMax = kernel.height / 2,
+        xMin = -(kernel.width - 1) / 2,
+        xMax = kernel.width / 2;
+    int rowBytes = width * 4,
+        halfRowBytes = (width / 2) * 4;
+
+    // output pixels whose source window is inside, and those whose eight pixel loads are too
+    int firstX = (1 - xMin) / 2,
+        endX = Min(width / 2, (width - xMax + 1) / 2),
+        endVectorX = Min(endX, (width - xMax) / 2),
+        firstY = (1 - yMin) / 2,
+        endY = Min(height / 2, (height - yMax + 1) / 2);
+
+    if (firstX >= endX || firstY >= endY)
+        return;
+
+    vector<int> vTapRows, vTapOffsets, vTapWeights;
+    for (int ky = 0; ky < kernel.height; ++ky)
+        for (int kx = 0; kx < kernel.width; ++kx)
+            if (kernel.vWeights[ky * kernel.width + kx])
+            {
+                vTapRows.push_back(ky + yMin);
+                vTapOffsets.push_back((kx + xMin) * 4);
+                vTapWeights.push_back(kernel.vWeights[ky * kernel.width + kx]);
+            }// if
+    int taps = (int)vTapWeights.size();
+
+    ParallelFor(firstY, endY, [&](int y)
+    {
+        const unsigned char* pRow = pSrc + 2 * y * rowBytes;
+        unsigned char* pOut = pDst + y * halfRowBytes;
+        int x = firstX;
+
+#ifdef CONVOLUTION_SSE2
+        if (kernel.bReciprocal)
+        {
+            const __m128i c_zero = _mm_setzero_si128(),
+                          c_rgbMask = _mm_set1_epi32(0x00FFFFFF),
+                          c_multiplier = _mm_set1_epi16((short)kernel.multiplier);
+            const __m128i c_shift = _mm_cvtsi32_si128(kernel.shift);
+
+            // the four even pixels of the eight starting at p
+            auto LoadEven = [](const unsigned char* p)
+            {
+                __m128i lo = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)p), _MM_SHUFFLE(2, 0, 2, 0)),
+                        hi = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(p + 16)), _MM_SHUFFLE(2, 0, 2, 0));
+                return _mm_unpacklo_epi64(lo, hi);
+            };
+
+            for (; x + 4 <= endVectorX; x += 4)
+            {
+                __m128i sumLo = c_zero,
+                        sumHi = c_zero;
+
+                for (int tap = 0; tap < taps; ++tap)
+                {
+                    __m128i pixels = LoadEven(pRow + vTapRows[tap] * rowBytes + x * 8 + vTapOffsets[tap]);
+                    __m128i weight = _mm_set1_epi16((short)vTapWeights[tap]);
+                    sumLo = _mm_add_epi16(sumLo, _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, c_zero), weight));
+                    sumHi = _mm_add_epi16(sumHi, _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, c_zero), weight));
+                }// for
+
+                sumLo = _mm_srl_epi16(_mm_mulhi_epu16(sumLo, c_multiplier), c_shift);
+                sumHi = _mm_srl_epi16(_mm_mulhi_epu16(sumHi, c_multiplier), c_shift);
+
+                __m128i result = _mm_packus_epi16(sumLo, sumHi),
+                        centre = LoadEven(pRow + x * 8);
+                result = _mm_or_si128(_mm_and_si128(c_rgbMask, result), _mm_andnot_si128(c_rgbMask, centre));
+                _mm_storeu_si128((__m128i*)(pOut + x * 4), result);
+            }// for
+        }// if
+#endif
+
+        for (; x < endX; ++x)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                unsigned int sum = 0;
+                for (int tap = 0; tap < taps; ++tap)
+                    sum += pRow[vTapRows[tap] * rowBytes + x * 8 + i + vTapOffsets[tap]] * vTapWeights[tap];
+
+                pOut[x * 4 + i] = (unsigned char)Min(sum / kernel.divisor, 255u);
+            }// for
+            pOut[x * 4 + 3] = pRow[x * 8 + 3];
+        }// for
+    });
+}// ConvolveInteriorHalf
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Read a square kernel from a text file.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool ReadKernelFile(const char* sFileName, vector<float>& vWeights, int& size, float& divide)
+{
+    ifstream kernelFile(sFileName);
+    if (!kernelFile || !(kernelFile >> size) || size < 1 || size > c_maxKernelSize)
+        return false;
+
+    vWeights.resize(size * size);
+    float sum = 0;
+    for (int i = 0; i < size * size; ++i)
+    {
+        if (!(kernelFile >> vWeights[i]))
+            return false;
+        sum += vWeights[i];
+    }// for
+
+    if (!(kernelFile >> divide))
+        divide = sum ? sum : 1;
+
+    return divide != 0;
+}// ReadKernelFile
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter directly, summing every tap at every pixel.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void ConvolveSpatial(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                            const float* pKernel, int size, float divide)
+{
+    int before = (size - 1) / 2;
+
+    // byte offset of every padded column, edge pixels repeated
+    vector<int> vColumnOffsets(width + size - 1);
+    for (int column = 0; column < width + size - 1; ++column)
+        vColumnOffsets[column] = Min(Max(column - before, 0), width - 1) * 4;
+
+    ParallelFor(0, height, [&](int y)
+    {
+        unsigned char* pOut = pDst + y * width * 4;
+        for (int x = 0; x < width; ++x)
+        {
+            float aSum[3] = { 0, 0, 0 };
+            for (int ky = 0; ky < size; ++ky)
+            {
+                const unsigned char* pRow = pSrc + Min(Max(y + ky - before, 0), height - 1) * width * 4;
+                const float* pWeights = pKernel + ky * size;
+                const int* pOffsets = &vColumnOffsets[x];
+
+                for (int kx = 0; kx < size; ++kx)
+                {
+                    const unsigned char* pPixel = pRow + pOffsets[kx];
+                    aSum[0] += pPixel[0] * pWeights[kx];
+                    aSum[1] += pPixel[1] * pWeights[kx];
+                    aSum[2] += pPixel[2] * pWeights[kx];
+                }// for
+            }// for
+
+            for (int channel = 0; channel < 3; ++channel)
+                pOut[x * 4 + channel] = (unsigned char)Min(Max(aSum[channel] / divide + 0.5f, 0.f), 255.f);
+        }// for
+    });
+}// ConvolveSpatial
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Bit reversal table and twiddle factors for a radix 2 FFT of size n.
+//
+///////////////////////////////////////////////////////////////////////////////
+struct SFFTPlan
+{
+    int                         n;
+    vector<int>                 vReversed;          // index with its log2(n) bits reversed
+    vector<complex<float> >     vTwiddles;          // exp(-2 pi i k / n) for k < n / 2
+
+    explicit SFFTPlan(int size) : n(size), vReversed(size), vTwiddles(size / 2)
+    {
+        int bits = 0;
+        while ((1 << bits) < n)
+            ++bits;
+
+        for (int i = 0; i < n; ++i)
+            for (int bit = 0; bit < bits; ++bit)
+                vReversed[i] |= ((i >> bit) & 1) << (bits - 1 - bit);
+
+        for (int k = 0; k < n / 2; ++k)
+            vTwiddles[k] = complex<float>((float)cos(-c_twoPi * k / n), (float)sin(-c_twoPi * k / n));
+    }// SFFTPlan
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      In place radix 2 FFT of plan.n values.  The inverse is not scaled.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void FFT(complex<float>* pData, const SFFTPlan& plan, bool bInverse)
+{
+    int n = plan.n;
+    for (int i = 0; i < n; ++i)
+        if (i < plan.vReversed[i])
+            swap(pData[i], pData[plan.vReversed[i]]);
+
+    for (int length = 2; length <= n; length <<= 1)
+    {
+        int half = length / 2,
+            step = n / length;
+
+        for (int start = 0; start < n; start += length)
+            for (int k = 0; k < half; ++k)
+            {
+                complex<float> twiddle = plan.vTwiddles[k * step];
+                if (bInverse)
+                    twiddle = conj(twiddle);
+
+                complex<float> odd = pData[start + k + half] * twiddle;
+                pData[start + k + half] = pData[start + k] - odd;
+                pData[start + k] += odd;
+            }// for
+    }// for
+}// FFT
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      In place 2D FFT of an n x n block, rows then columns.  vColumn is
+//  scratch space.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void FFT2D(complex<float>* pBlock, const SFFTPlan& plan, bool bInverse, vector<complex<float> >& vColumn)
+{
+    int n = plan.n;
+    for (int row = 0; row < n; ++row)
+        FFT(pBlock + row * n, plan, bInverse);
+
+    vColumn.resize(n);
+    for (int column = 0; column < n; ++column)
+    {
+        for (int row = 0; row < n; ++row)
+            vColumn[row] = pBlock[row * n + column];
+        FFT(&vColumn[0], plan, bInverse);
+        for (int row = 0; row < n; ++row)
+            pBlock[row * n + column] = vColumn[row];
+    }// for
+}// FFT2D
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter with FFTs using overlap-add.  The image, padded with repeated
+//  edge pixels, is cut into tile x tile blocks; each is zero padded to the
+//  FFT size, multiplied by the kernel's spectrum and added back into the
+//  output, overlapping its neighbours by size - 1.  Red and green share one
+//  complex transform as its real and imaginary parts, blue takes another.
+//  Tile rows only overlap the next tile row, so even rows run in parallel
+//  and then odd rows.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void ConvolveFFT(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                        const float* pKernel, int size, float divide)
+{
+    // the FFT size with the least work over all tiles; tiles must span the overlap, and
+    // no size need be larger than one tile covering the whole padded image
+    int n = 1;
+    while (n < 2 * (size - 1) || n < 2)
+        n <<= 1;
+
+    int largest = 1;
+    while (largest < Max(width, height) + 2 * (size - 1))
+        largest <<= 1;
+
+    double bestCost = 0;
+    int bestN = n;
+    for (int candidate = n; candidate <= 4 * n && candidate <= largest; candidate <<= 1)
+    {
+        int tile = candidate - size + 1;
+        double tiles = (double)((width + size - 2) / tile + 1) * ((height + size - 2) / tile + 1),
+               cost = tiles * candidate * (double)candidate * log((double)candidate);
+        if (candidate == n || cost < bestCost)
+        {
+            bestCost = cost;
+            bestN = candidate;
+        }// if
+    }// for
+    n = bestN;
+
+    int tile = n - size + 1,
+        before = (size - 1) / 2,
+        paddedWidth = width + size - 1,
+        paddedHeight = height + size - 1,
+        tileRows = (paddedHeight + tile - 1) / tile,
+        tileColumns = (paddedWidth + tile - 1) / tile;
+    SFFTPlan plan(n);
+
+    // spectrum of the flipped kernel, scaled for the unscaled inverse and the divisor
+    vector<complex<float> > vSpectrum(n * n), vColumn;
+    for (int ky = 0; ky < size; ++ky)
+        for (int kx = 0; kx < size; ++kx)
+            vSpectrum[ky * n + kx] = pKernel[(size - 1 - ky) * size + (size - 1 - kx)] / (divide * n * n);
+    FFT2D(&vSpectrum[0], plan, false, vColumn);
+
+    // output sums; result row y is row y + size - 1 of the full convolution
+    vector<float> vSums((size_t)width * height * 3, 0.f);
+
+    for (int phase = 0; phase < 2; ++phase)
+        ParallelFor(0, (tileRows - phase + 1) / 2, [&](int i)
+        {
+            int tileRow = 2 * i + phase;
+            vector<complex<float> > vRedGreen(n * n), vBlue(n * n), vScratch;
+
+            for (int tileColumn = 0; tileColumn < tileColumns; ++tileColumn)
+            {
+                int top = tileRow * tile,
+                    left = tileColumn * tile,
+                    rows = Min(tile, paddedHeight - top),
+                    columns = Min(tile, paddedWidth - left);
+
+                fill(vRedGreen.begin(), vRedGreen.end(), complex<float>());
+                fill(vBlue.begin(), vBlue.end(), complex<float>());
+                for (int row = 0; row < rows; ++row)
+                {
+                    const unsigned char* pRow = pSrc + Min(Max(top + row - before, 0), height - 1) * width * 4;
+                    for (int column = 0; column < columns; ++column)
+                    {
+                        const unsigned char* pPixel = pRow + Min(Max(left + column - before, 0), width - 1) * 4;
+                        vRedGreen[row * n + column] = complex<float>(pPixel[0], pPixel[1]);
+                        vBlue[row * n + column] = complex<float>(pPixel[2], 0);
+                    }// for
+                }// for
+
+                FFT2D(&vRedGreen[0], plan, false, vScratch);
+                FFT2D(&vBlue[0], plan, false, vScratch);
+                for (int bin = 0; bin < n * n; ++bin)
+                {
+                    vRedGreen[bin] *= vSpectrum[bin];
+                    vBlue[bin] *= vSpectrum[bin];
+                }// for
+                FFT2D(&vRedGreen[0], plan, true, vScratch);
+                FFT2D(&vBlue[0], plan, true, vScratch);
+
+                // add the block's full convolution into the output rows and columns it reaches
+                int firstRow = Max(0, size - 1 - top),
+                    lastRow = Min(rows + size - 1, height + size - 1 - top),
+                    firstColumn = Max(0, size - 1 - left),
+                    lastColumn = Min(columns + size - 1, width + size - 1 - left);
+                for (int row = firstRow; row < lastRow; ++row)
+                {
+                    float* pSum = &vSums[((size_t)(top + row - size + 1) * width + left - size + 1) * 3];
+                    for (int column = firstColumn; column < lastColumn; ++column)
+                    {
+                        const complex<float>& redGreen = vRedGreen[row * n + column];
+                        pSum[column * 3] += redGreen.real();
+                        pSum[column * 3 + 1] += redGreen.imag();
+                        pSum[column * 3 + 2] += vBlue[row * n + column].real();
+                    }// for
+                }// for
+            }// for
+        });
+
+    ParallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; ++x)
+            for (int channel = 0; channel < 3; ++channel)
+                pDst[(y * width + x) * 4 + channel] =
+                    (unsigned char)Min(Max(vSums[((size_t)y * width + x) * 3 + channel] + 0.5f, 0.f), 255.f);
+    });
+}// ConvolveFFT
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter with a float kernel, choosing direct or FFT convolution by
+//  kernel size.
+//
+///////////////////////////////////////////////////////////////////////////////
+void ConvolveKernel(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                    const float* pKernel, int size, float divide)
+{
+    if (width <= 0 || height <= 0 || size < 1 || !divide)
+        return;
+
+    if (size >= c_fftKernelSize)
+        ConvolveFFT(pSrc, pDst, width, height, pKernel, size, divide);
+    else
+        ConvolveSpatial(pSrc, pDst, width, height, pKernel, size, divide);
+}// ConvolveKernel
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter directly one pixel at a time, in the order ConvolveSpatial
+//  sums its taps.
+//
+///////////////////////////////////////////////////////////////////////////////
+void ConvolveKernelRef(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                       const float* pKernel, int size, float divide)
+{
+    if (width <= 0 || height <= 0 || size < 1 || !divide)
+        return;
+
+    int before = (size - 1) / 2;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            float aSum[3] = { 0, 0, 0 };
+            for (int ky = 0; ky < size; ++ky)
+                for (int kx = 0; kx < size; ++kx)
+                {
+                    const unsigned char* pPixel = pSrc + (Min(Max(y + ky - before, 0), height - 1) * width +
+                                                          Min(Max(x + kx - before, 0), width - 1)) * 4;
+                    for (int channel = 0; channel < 3; ++channel)
+                        aSum[channel] += pPixel[channel] * pKernel[ky * size + kx];
+                }// for
+
+            for (int channel = 0; channel < 3; ++channel)
+                pDst[(y * width + x) * 4 + channel] = (unsigned char)Min(Max(aSum[channel] / divide + 0.5f, 0.f), 255.f);
+        }// for
+}// ConvolveKernelRef
@@ -0,0 +1,210 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      DistanceImage.cpp
+//
+//      Implementation of the Euclidean distance transform.  Rows are
+//  transformed in parallel, then columns; each line only reads and writes
+//  its own pixels, so no two threads touch the same value.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "DistanceImage.h"
+#include "TargaImage.h"
+#include <math.h>
+
+using namespace std;
+
+// constants
+const float     c_farAway               = 1e20f;                        // squared distance of a pixel with no feature in reach
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Constructor.  Pixels whose average of red, green and blue is at least
+//  threshold are features, as in Dither_Threshold.  The reference backend
+//  transforms one line at a time by brute force.
+//
+///////////////////////////////////////////////////////////////////////////////
+DistanceImage::DistanceImage(const TargaImage& image, int threshold)
+    : width(image.width), height(image.height), squared((size_t)image.width * image.height)
+{
+    if (squared.empty())
+        return;
+
+    for (size_t i = 0; i < squared.size(); ++i)
+    {
+        const unsigned char* pPixel = image.data + i * 4;
+        squared[i] = pPixel[0] + pPixel[1] + pPixel[2] >= 3 * threshold ? 0 : c_farAway;
+    }// for
+
+    if (TargaImage::backend == BACKEND_REFERENCE)
+    {
+        vector<float> vScratch;
+        for (int row = 0; row < height; ++row)
+            Transform_Line_Ref(&squared[(size_t)row * width], 1, width, vScratch);
+        for (int column = 0; column < width; ++column)
+            Transform_Line_Ref(&squared[column], width, height, vScratch);
+        return;
+    }// if
+
+    ParallelFor(0, height, [&](int row)
+    {
+        vector<float> vScratch;
+        vector<int> vRoots;
+        Transform_Line(&squared[(size_t)row * width], 1, width, vScratch, vRoots);
+    });
+
+    ParallelFor(0, width, [&](int column)
+    {
+        vector<float> vScratch;
+        vector<int> vRoots;
+        Transform_Line(&squared[column], width, height, vScratch, vRoots);
+    });
+}// DistanceImage
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Replace the count values at pLine, stride apart, with their one
+//  dimensional squared distance transform: out[q] = min over p of
+//  (q - p)^2 + in[p].  Uses the lower envelope of the parabolas rooted at
+//  each p.
+//
+///////////////////////////////////////////////////////////////////////////////
+void DistanceImage::Transform_Line(float* pLine, int stride, int count, vector<float>& vScratch, vector<int>& vRoots)
+{
+    // scratch holds the input and the boundaries between the envelope's parabolas
+    vScratch.resize(count * 2 + 1);
+    vRoots.resize(count);
+    float* pValues = &vScratch[0];
+    float* pBoundaries = pValues + count;
+    int* pRoots = &vRoots[0];
+
+    int parabolas = 0;
+    for (int p = 0; p < count; ++p)
+    {
+        pValues[p] = pLine[(size_t)p * stride];
+        if (pValues[p] >= c_farAway)
+            continue;
+
+        // drop parabolas hidden below the new one
+        float boundary = -c_farAway;
+        while (parabolas > 0)
+        {
+            int root = pRoots[parabolas - 1];
+            boundary = ((pValues[p] + (float)p * p) - (pValues[root] + (float)root * root)) / (2.f * (p - root));
+            if (boundary > pBoundaries[parabolas - 1])
+                break;
+            --parabolas;
+        }// while
+
+        pRoots[parabolas] = p;
+        pBoundaries[parabolas] = parabolas ? boundary : -c_farAway;
+        ++parabolas;
+    }// for
+
+    if (!parabolas)
+        return;
+
+    pBoundaries[parabolas] = c_farAway;
+    int parabola = 0;
+    for (int q = 0; q < count; ++q)
+    {
+        while (pBoundaries[parabola + 1] < q)
+            ++parabola;
+
+        int root = pRoots[parabola];
+        pLine[(size_t)q * stride] = (float)(q - root) * (q - root) + pValues[root];
+    }// for
+}// Transform_Line
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Replace the count values at pLine, stride apart, with out[q] = min
+//  over p of (q - p)^2 + in[p], trying every p for every q.
+//
+///////////////////////////////////////////////////////////////////////////////
+void DistanceImage::Transform_Line_Ref(float* pLine, int stride, int count, vector<float>& vScratch)
+{
+    vScratch.resize(count);
+    for (int p = 0; p < count; ++p)
+        vScratch[p] = pLine[(size_t)p * stride];
+
+    for (int q = 0; q < count; ++q)
+    {
+        float nearest = c_farAway;
+        for (int p = 0; p < count; ++p)
+            if (vScratch[p] < c_farAway)
+                nearest = Min(nearest, (float)(q - p) * (q - p) + vScratch[p]);
+
+        pLine[(size_t)q * stride] = nearest;
+    }// for
+}// Transform_Line_Ref
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if any pixel was a feature.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool DistanceImage::Has_Features() const
+{
+    return !squared.empty() && squared[0] < c_farAway;
+}// Has_Features
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Distance from the pixel to the nearest feature.
+//
+///////////////////////////////////////////////////////////////////////////////
+float DistanceImage::Distance(int x, int y) const
+{
+    return sqrtf(squared[(size_t)y * width + x]);
+}// Distance
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Largest distance in the image.
+//
+///////////////////////////////////////////////////////////////////////////////
+float DistanceImage::Max_Distance() const
+{
+    float largest = 0;
+    for (size_t i = 0; i < squared.size(); ++i)
+        largest = Max(largest, squared[i]);
+
+    return sqrtf(largest);
+}// Max_Distance
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Write the distances, scaled so the largest is 255, into an opaque grey
+//  image of the same size.  Returns false if the sizes differ or there are
+//  no features.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool DistanceImage::To_Image(TargaImage& image) const
+{
+    if (image.width != width || image.height != height || !Has_Features())
+        return false;
+
+    float largest = Max_Distance(),
+          scale = largest > 0 ? 255.f / largest : 0;
+
+    ParallelFor(0, height, [&](int row)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char* pPixel = image.data + ((size_t)row * width + x) * 4;
+            pPixel[0] = pPixel[1] = pPixel[2] = (unsigned char)(Distance(x, row) * scale + 0.5f);
+            pPixel[3] = 255;
+        }// for
+    });
+
+    return true;
+}// To_Image
@@ -0,0 +1,47 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      DistanceImage.h
+//
+//      Exact Euclidean distance from every pixel to the nearest feature
+//  pixel of an image.  The transform is separable: the lower envelope of
+//  parabolas (Felzenszwalb and Huttenlocher) gives squared distances along
+//  each row and then each column in time linear in the number of pixels.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DISTANCE_IMAGE_H_
+#define _DISTANCE_IMAGE_H_
+
+#include <vector>
+
+class TargaImage;
+
+class DistanceImage
+{
+    // methods
+    public:
+        DistanceImage(const TargaImage& image, int threshold = 128);
+
+        bool Has_Features() const;                  // true if any pixel was a feature
+        float Distance(int x, int y) const;         // distance from the pixel to the nearest feature
+        float Max_Distance() const;                 // largest distance in the image
+
+        bool To_Image(TargaImage& image) const;     // write distances scaled to [0, 255] as an opaque grey image
+
+    private:
+    // one dimensional transform of a row or column
+        static void Transform_Line(float* pLine, int stride, int count, std::vector<float>& vScratch, std::vector<int>& vRoots);
+
+    // the same transform by trying every pair of pixels, the reference for Transform_Line
+        static void Transform_Line_Ref(float* pLine, int stride, int count, std::vector<float>& vScratch);
+
+    // members
+    public:
+        int                 width;          // width of the image in pixels
+        int                 height;         // height of the image in pixels
+
+    private:
+        std::vector<float>  squared;        // squared distance of each pixel, row major
+};
+
+#endif // _DISTANCE_IMAGE_H_
@@ -0,0 +1,338 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Dither.cpp
+//
+//      Implementation of ordered dithering.  Every threshold becomes the
+//  smallest sum of red, green and blue that turns a pixel white, so a pixel
+//  is compared without any float arithmetic or division; with SSE2 four
+//  pixel sums are compared against a row of the tiled matrix at once.  Rows
+//  are spread across threads.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "Dither.h"
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DITHER_SSE2
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+struct SDitherTable
+{
+    unsigned char   aThresholds[c_maxDitherSize][c_maxDitherSize];  // pixel is white if its grey is above this
+};
+
+struct SDitherSums
+{
+    uint16_t        aSums[c_maxDitherSize][c_maxDitherSize];        // pixel is white if r + g + b is at least this
+};
+
+// constants
+const int       c_numDitherSizes        = 4;                            // 2, 4, 8 and 16
+const int       c_groupPixels           = 4;                            // pixels compared in one SSE2 register
+const int       c_clusterMaskSize       = 4;                            // side of the Dither_Cluster mask
+const int       c_neverWhite            = 3 * 255 + 1;                  // sum threshold no pixel reaches
+
+// the clustered-dot mask Dither_Cluster has always used, compared against the average of r, g and b over 256
+static constexpr float c_aClusterMask[c_clusterMaskSize][c_clusterMaskSize] =
+{
+    { 0.7059f, 0.3529f, 0.5882f, 0.2353f },
+    { 0.0588f, 0.9412f, 0.8235f, 0.4118f },
+    { 0.4706f, 0.7647f, 0.8824f, 0.1176f },
+    { 0.1765f, 0.5294f, 0.2941f, 0.6471f }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return the rank of a cell in the Bayer matrix of side 1 << bits.
+//  Each bit pair of the rank interleaves a bit of x ^ y with a bit of y,
+//  most significant pair from the least significant coordinate bits.
+//
+///////////////////////////////////////////////////////////////////////////////
+static constexpr int BayerRank(int x, int y, int bits)
+{
+    int rank = 0;
+    for (int bit = 0; bit < bits; ++bit)
+        rank = (rank << 2) | ((((x ^ y) >> bit) & 1) << 1) | ((y >> bit) & 1);
+
+    return rank;
+}// BayerRank
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return the rank of a cell in the clustered-dot matrix of the given
+//  side.  Cells are ordered by distance from the centre of the tile, ties
+//  broken in row major order.
+//
+///////////////////////////////////////////////////////////////////////////////
+static constexpr int ClusterRank(int x, int y, int size)
+{
+    int distance = (2 * x + 1 - size) * (2 * x + 1 - size) + (2 * y + 1 - size) * (2 * y + 1 - size),
+        rank = 0;
+
+    for (int otherY = 0; otherY < size; ++otherY)
+        for (int otherX = 0; otherX < size; ++otherX)
+        {
+            int otherDistance = (2 * otherX + 1 - size) * (2 * otherX + 1 - size) +
+                                (2 * otherY + 1 - size) * (2 * otherY + 1 - size);
+            if (otherDistance < distance || (otherDistance == distance && otherY * size + otherX < y * size + x))
+                ++rank;
+        }// for
+
+    return rank;
+}// ClusterRank
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Build the threshold matrix of side 1 << bits.  Rank r of n cells
+//  becomes the byte threshold at the centre of the r-th of n equal steps,
+//  so black stays black and white stays white.
+//
+///////////////////////////////////////////////////////////////////////////////
+static constexpr SDitherTable MakeDitherTable(int bits, EDitherMatrix matrix)
+{
+    SDitherTable table = {};
+    int size = 1 << bits,
+        levels = size * size;
+
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+        {
+            int rank = matrix == MATRIX_BAYER ? BayerRank(x, y, bits) : ClusterRank(x, y, size);
+            table.aThresholds[y][x] = (unsigned char)((2 * rank + 1) * 255 / (2 * levels));
+        }// for
+
+    return table;
+}// MakeDitherTable
+
+
+// indexed by matrix and log2(size) - 1
+static constexpr SDitherTable c_aDitherTables[NUM_DITHER_MATRICES][c_numDitherSizes] =
+{
+    { MakeDitherTable(1, MATRIX_BAYER), MakeDitherTable(2, MATRIX_BAYER),
+      MakeDitherTable(3, MATRIX_BAYER), MakeDitherTable(4, MATRIX_BAYER) },
+    { MakeDitherTable(1, MATRIX_CLUSTER), MakeDitherTable(2, MATRIX_CLUSTER),
+      MakeDitherTable(3, MATRIX_CLUSTER), MakeDitherTable(4, MATRIX_CLUSTER) }
+};
+
+static_assert(c_aDitherTables[MATRIX_BAYER][0].aThresholds[0][1] == 159 &&
+              c_aDitherTables[MATRIX_BAYER][0].aThresholds[1][0] == 223, "Bayer matrix is not [0 2; 3 1]");
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return the smallest sum of red, green and blue that passes the
+//  Dither_Cluster test against the given mask entry, evaluated exactly as
+//  that test was so that every pixel lands on the same side.
+//
+///////////////////////////////////////////////////////////////////////////////
+static constexpr int ClusterMaskSum(float mask)
+{
+    int sum = 0;
+    while (sum < c_neverWhite && !((float)sum / 3 / 256.0 >= mask))
+        ++sum;
+
+    return sum;
+}// ClusterMaskSum
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Build the sum thresholds of the Dither_Cluster mask.
+//
+///////////////////////////////////////////////////////////////////////////////
+static constexpr SDitherSums MakeClusterMaskSums()
+{
+    SDitherSums sums = {};
+    for (int y = 0; y < c_clusterMaskSize; ++y)
+        for (int x = 0; x < c_clusterMaskSize; ++x)
+            sums.aSums[y][x] = (uint16_t)ClusterMaskSum(c_aClusterMask[y][x]);
+
+    return sums;
+}// MakeClusterMaskSums
+
+
+static constexpr SDitherSums c_clusterMaskSums = MakeClusterMaskSums();
+
+static_assert(c_clusterMaskSums.aSums[1][0] == 46 && c_clusterMaskSums.aSums[1][1] == 723,
+              "Dither_Cluster mask thresholds moved");
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return the index of the table of the given side, or -1 if there is
+//  none.
+//
+///////////////////////////////////////////////////////////////////////////////
+static int DitherTableIndex(int size)
+{
+    for (int index = 0; index < c_numDitherSizes; ++index)
+        if (size == 2 << index)
+            return index;
+
+    return -1;
+}// DitherTableIndex
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if there is a threshold matrix with the given side.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool IsDitherSize(int size)
+{
+    return DitherTableIndex(size) >= 0;
+}// IsDitherSize
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Dither the image against sum thresholds of the given side tiled over
+//  it.  A pixel turns white if its red, green and blue add up to at least
+//  its threshold.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void DitherSums(unsigned char* pData, int width, int height, const SDitherSums& sums, int size)
+{
+    if (!pData || width <= 0 || height <= 0)
+        return;
+
+    // each matrix row repeated out to whole SSE2 groups, one threshold per 16 bit half of a pixel
+    int tilePixels = Max(size, c_groupPixels);
+    vector<int16_t> vTileRows(size * tilePixels * 2);
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < tilePixels; ++x)
+            vTileRows[(y * tilePixels + x) * 2] = vTileRows[(y * tilePixels + x) * 2 + 1] = sums.aSums[y][x % size];
+
+    ParallelFor(0, height, [&](int row)
+    {
+        unsigned char* pRow = pData + row * width * 4;
+        const int16_t* pTile = &vTileRows[(row % size) * tilePixels * 2];
+        int pixel = 0;
+
+#ifdef DITHER_SSE2
+        const __m128i c_zero = _mm_setzero_si128(),
+                      c_rgbMask = _mm_set1_epi32(0x00FFFFFF),
+                      c_rgbWeights = _mm_set_epi16(0, 1, 1, 1, 0, 1, 1, 1);
+
+        for (; pixel + c_groupPixels <= width; pixel += c_groupPixels)
+        {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(pRow + pixel * 4)),
+                    thresholds = _mm_loadu_si128((const __m128i*)(pTile + (pixel % tilePixels) * 2));
+
+            // r + g + b of each pixel in both of its 32 bit lanes
+            __m128i sumLo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, c_zero), c_rgbWeights),
+                    sumHi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, c_zero), c_rgbWeights);
+            sumLo = _mm_add_epi32(sumLo, _mm_shuffle_epi32(sumLo, _MM_SHUFFLE(2, 3, 0, 1)));
+            sumHi = _mm_add_epi32(sumHi, _mm_shuffle_epi32(sumHi, _MM_SHUFFLE(2, 3, 0, 1)));
+
+            // below its threshold, in all four bytes of the pixel
+            __m128i black = _mm_cmplt_epi16(_mm_packs_epi32(sumLo, sumHi), thresholds);
+            black = _mm_packs_epi16(black, black);
+            black = _mm_unpacklo_epi8(black, black);
+
+            _mm_storeu_si128((__m128i*)(pRow + pixel * 4),
+                             _mm_or_si128(_mm_andnot_si128(black, c_rgbMask), _mm_andnot_si128(c_rgbMask, pixels)));
+        }// for
+#endif
+
+        for (; pixel < width; ++pixel)
+        {
+            unsigned char* pPixel = pRow + pixel * 4;
+            int sum = pPixel[0] + pPixel[1] + pPixel[2];
+
+            pPixel[0] = pPixel[1] = pPixel[2] = sum >= pTile[(pixel % tilePixels) * 2] ? 255 : 0;
+        }// for
+    });
+}// DitherSums
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Dither the image against the matrix tiled over it.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool DitherOrdered(unsigned char* pData, int width, int height, int size, EDitherMatrix matrix)
+{
+    int index = DitherTableIndex(size);
+    if (index < 0 || matrix < 0 || matrix >= NUM_DITHER_MATRICES)
+        return false;
+
+    // the average is above t exactly when the sum is at least 3t + 3
+    const SDitherTable& table = c_aDitherTables[matrix][index];
+    SDitherSums sums;
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            sums.aSums[y][x] = (uint16_t)(3 * table.aThresholds[y][x] + 3);
+
+    DitherSums(pData, width, height, sums, size);
+    return true;
+}// DitherOrdered
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Dither the image against the Dither_Cluster mask tiled over it.
+//
+///////////////////////////////////////////////////////////////////////////////
+void DitherCluster(unsigned char* pData, int width, int height)
+{
+    DitherSums(pData, width, height, c_clusterMaskSums, c_clusterMaskSize);
+}// DitherCluster
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Dither one pixel at a time against the matrix, on the calling thread.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool DitherOrderedRef(unsigned char* pData, int width, int height, int size, EDitherMatrix matrix)
+{
+    int index = DitherTableIndex(size);
+    if (index < 0 || matrix < 0 || matrix >= NUM_DITHER_MATRICES)
+        return false;
+
+    if (!pData || width <= 0 || height <= 0)
+        return true;
+
+    const SDitherTable& table = c_aDitherTables[matrix][index];
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char* pPixel = pData + (y * width + x) * 4;
+            unsigned int grey = (pPixel[0] + pPixel[1] + pPixel[2]) / 3;
+
+            pPixel[0] = pPixel[1] = pPixel[2] = grey > table.aThresholds[y % size][x % size] ? 255 : 0;
+        }// for
+
+    return true;
+}// DitherOrderedRef
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Dither against the Dither_Cluster mask as Dither_Cluster always has,
+//  one pixel at a time with the float test.
+//
+///////////////////////////////////////////////////////////////////////////////
+void DitherClusterRef(unsigned char* pData, int width, int height)
+{
+    for (int h = 0; h < height; h++) {
+        int offset = h * width * 4;     //length of one row
+
+        for (int w = 0; w < width; w++) {
+
+            if ((float)(pData[offset + w * 4] + pData[offset + w * 4 + 1] + pData[offset + w * 4 + 2]) / 3 / 256.0 >= c_aClusterMask[h % 4][w % 4])
+                pData[offset + w * 4] = pData[offset + w * 4 + 1] = pData[offset + w * 4 + 2] = 255;
+            else
+                pData[offset + w * 4] = pData[offset + w * 4 + 1] = pData[offset + w * 4 + 2] = 0;
+        }
+    }
+}// DitherClusterRef
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Dither.h
+//
+//      Ordered dithering with Bayer and clustered-dot threshold matrices.
+//  The matrices are built at compile time for every power-of-two size up to
+//  16 x 16, the largest with no repeated thresholds in the byte domain.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DITHER_H_
+#define _DITHER_H_
+
+enum EDitherMatrix      // how ranks are laid out in a threshold matrix
+{
+    MATRIX_BAYER,       // dispersed dots, recursive Bayer order
+    MATRIX_CLUSTER,     // one dot per tile growing out from its centre
+    NUM_DITHER_MATRICES
+};// EDitherMatrix
+
+const int       c_maxDitherSize         = 16;                           // largest threshold matrix side
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if there is a threshold matrix with the given side.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool IsDitherSize(int size);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Set each pixel of pData to black or white by comparing the average of
+//  its red, green and blue with the matrix tiled over the image.  Alpha is
+//  left unchanged.  Returns false if there is no matrix of that size.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool DitherOrdered(unsigned char* pData, int width, int height, int size, EDitherMatrix matrix);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Dither the image with the 4 x 4 clustered-dot mask of Dither_Cluster,
+//  giving exactly the pixels that mask always has.  Alpha is left unchanged.
+//
+///////////////////////////////////////////////////////////////////////////////
+void DitherCluster(unsigned char* pData, int width, int height);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      The original Dither_Cluster loop, testing each pixel's average in
+//  float.  Kept as the reference DitherCluster is checked against.
+//
+///////////////////////////////////////////////////////////////////////////////
+void DitherClusterRef(unsigned char* pData, int width, int height);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      The same one pixel at a time on the calling thread.  Kept as the
+//  reference DitherOrdered is checked against.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool DitherOrderedRef(unsigned char* pData, int width, int height, int size, EDitherMatrix matrix);
+
+#endif // _DITHER_H_
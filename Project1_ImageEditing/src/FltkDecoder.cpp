@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      FltkDecoder.cpp
+//
+//      Implementation of CFltkDecoder methods.  FLTK decodes the whole file
+//  into its own buffer of 1 to 4 channels, which CImageDecoder converts.
+//  The FLTK image objects keep no shared state, so separate files decode on
+//  separate threads.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FltkDecoder.h"
+#include "ImageDecoder.h"
+#include "TargaImage.h"
+#include <Fl/Fl_JPEG_Image.h>
+#include <Fl/Fl_PNG_Image.h>
+#include <iostream>
+
+using namespace std;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Decode a PNG or JPEG file, averaging each reduction by reduction block
+//  of pixels into one.  Returns a new image owned by the caller, or NULL on
+//  failure.
+//
+///////////////////////////////////////////////////////////////////////////////
+TargaImage* CFltkDecoder::Load(const char* sFilename, int reduction)
+{
+    Fl_RGB_Image* pDecoded;
+    if (CImageDecoder::IsPNGFile(sFilename))
+        pDecoded = new Fl_PNG_Image(sFilename);
+    else
+        pDecoded = new Fl_JPEG_Image(sFilename);
+
+    int width = pDecoded->w(),
+        height = pDecoded->h(),
+        channels = pDecoded->d();
+    if (pDecoded->fail() || width <= 0 || height <= 0 || channels < 1 || channels > 4 || !pDecoded->count())
+    {
+        cout << "Unable to decode image:  " << sFilename << endl;
+        delete pDecoded;
+        return NULL;
+    }// if
+
+    // FLTK leaves the row length at zero when rows are packed
+    int rowBytes = pDecoded->ld() ? pDecoded->ld() : width * channels;
+    TargaImage* pResult = CImageDecoder::Convert((const unsigned char*)pDecoded->data()[0], width, height,
+                                                 channels, rowBytes, false, reduction);
+
+    delete pDecoded;
+    return pResult;
+}// Load
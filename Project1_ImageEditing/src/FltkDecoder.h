@@ -0,0 +1,30 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      FltkDecoder.h
+//
+//      PNG and JPEG decoding through the FLTK image libraries, registered
+//  with CImageDecoder by the GUI program.  Kept apart so that the headless
+//  tools link without FLTK.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _C_FLTK_DECODER
+#define _C_FLTK_DECODER
+
+class TargaImage;
+
+class CFltkDecoder
+{
+    // methods
+    public:
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Decode a PNG or JPEG file, averaging each reduction by reduction
+        //  block of pixels into one.  Returns a new image owned by the caller, or
+        //  NULL on failure.  Safe to call from several threads at once.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static TargaImage* Load(const char* sFilename, int reduction);
+};// CFltkDecoder
+
+#endif // _C_FLTK_DECODER
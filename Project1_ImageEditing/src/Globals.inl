@@ -9,6 +9,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <functional>
+#include <thread>
+#include <vector>
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -71,3 +73,33 @@ template<class T> struct FDelete : public std::unary_function<T, void>
 };// FDelete
 
 
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Call func(i) for every i in [begin, end).  The range is split into one
+//  contiguous block per hardware thread and the calling thread runs the
+//  first block.  Calls for different i must be independent.
+//
+///////////////////////////////////////////////////////////////////////////////
+template<class Func> void ParallelFor(int begin, int end, Func func)
+{
+    int count = end - begin;
+    if (count <= 0)
+        return;
+
+    int threads = Min<int>(count, Max<int>(1, (int)std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+
+    for (int block = 1; block < threads; ++block)
+    {
+        int first = begin + (int)((long long)count * block / threads);
+        int last = begin + (int)((long long)count * (block + 1) / threads);
+        workers.push_back(std::thread([=]() { for (int i = first; i < last; ++i) func(i); }));
+    }// for
+
+    int last = begin + (int)((long long)count / threads);
+    for (int i = begin; i < last; ++i)
+        func(i);
+
+    for (size_t block = 0; block < workers.size(); ++block)
+        workers[block].join();
+}// ParallelFor
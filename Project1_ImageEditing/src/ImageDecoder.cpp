@@ -0,0 +1,207 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      ImageDecoder.cpp
+//
+//      Implementation of CImageDecoder methods.  The registered decoder
+//  turns the whole file into a buffer of 1 to 4 channels; the rows are then
+//  premultiplied and box averaged straight into the result, one output row
+//  per task.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "ImageDecoder.h"
+#include "TargaImage.h"
+#include <ctype.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// constants
+const char      c_asPNGExtensions[][8]  = { ".png" };                   // extensions decoded as PNG
+const char      c_asJPEGExtensions[][8] = { ".jpg", ".jpeg", ".jpe" };  // extensions decoded as JPEG
+const int       c_maxReduction          = 8;                            // largest reduction in each direction
+
+FDecodeFile CImageDecoder::s_decode = NULL;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the filename ends in the given extension, ignoring case.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool HasExtension(const char* sFilename, const char* sExtension)
+{
+    size_t nameLength = strlen(sFilename),
+           extLength = strlen(sExtension);
+    if (nameLength < extLength)
+        return false;
+
+    const char* sEnd = sFilename + nameLength - extLength;
+    for (size_t i = 0; i < extLength; ++i)
+        if (tolower((unsigned char)sEnd[i]) != sExtension[i])
+            return false;
+
+    return true;
+}// HasExtension
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the filename ends in any of the given extensions.
+//
+///////////////////////////////////////////////////////////////////////////////
+template<size_t N> static bool HasAnyExtension(const char* sFilename, const char (&asExtensions)[N][8])
+{
+    for (size_t i = 0; i < N; ++i)
+        if (HasExtension(sFilename, asExtensions[i]))
+            return true;
+
+    return false;
+}// HasAnyExtension
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Set the function that decodes PNG and JPEG files.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CImageDecoder::SetFileDecoder(FDecodeFile decode)
+{
+    s_decode = decode;
+}// SetFileDecoder
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Build an image from rows of grey, grey and alpha, RGB or RGBA pixels,
+//  averaging each reduction by reduction block.  Pixels that are not yet
+//  premultiplied are premultiplied before they are averaged.
+//
+///////////////////////////////////////////////////////////////////////////////
+TargaImage* CImageDecoder::Convert(const unsigned char* pPixels, int width, int height, int channels,
+                                   int rowBytes, bool bPremultiplied, int reduction)
+{
+    int outWidth = (width + reduction - 1) / reduction,
+        outHeight = (height + reduction - 1) / reduction;
+    TargaImage* pResult = new TargaImage(outWidth, outHeight);
+
+    ParallelFor(0, outHeight, [&](int outY)
+    {
+        vector<unsigned int> vSums(outWidth * 4, 0);
+        int firstRow = outY * reduction,
+            lastRow = Min(height, firstRow + reduction);
+
+        for (int y = firstRow; y < lastRow; ++y)
+        {
+            const unsigned char* pIn = pPixels + (size_t)y * rowBytes;
+            for (int x = 0; x < width; ++x, pIn += channels)
+            {
+                unsigned int aPixel[4];
+                if (channels < 3)
+                    aPixel[0] = aPixel[1] = aPixel[2] = pIn[0];
+                else
+                {
+                    aPixel[0] = pIn[0];
+                    aPixel[1] = pIn[1];
+                    aPixel[2] = pIn[2];
+                }// else
+                aPixel[3] = (channels == 2 || channels == 4) ? pIn[channels - 1] : 255;
+
+                if (!bPremultiplied && aPixel[3] != 255)
+                    for (int c = 0; c < 3; ++c)
+                        aPixel[c] = (aPixel[c] * aPixel[3] + 127) / 255;
+
+                unsigned int* pSum = &vSums[(x / reduction) * 4];
+                for (int c = 0; c < 4; ++c)
+                    pSum[c] += aPixel[c];
+            }// for
+        }// for
+
+        unsigned char* pOut = pResult->data + (size_t)outY * outWidth * 4;
+        int rows = lastRow - firstRow;
+        for (int outX = 0; outX < outWidth; ++outX)
+        {
+            unsigned int count = rows * (Min(width, (outX + 1) * reduction) - outX * reduction);
+            for (int c = 0; c < 4; ++c)
+                pOut[outX * 4 + c] = (unsigned char)((vSums[outX * 4 + c] + count / 2) / count);
+        }// for
+    });
+
+    return pResult;
+}// Convert
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the filename has a PNG or JPEG extension.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool CImageDecoder::IsDecodedFile(const char* sFilename)
+{
+    return HasAnyExtension(sFilename, c_asPNGExtensions) || HasAnyExtension(sFilename, c_asJPEGExtensions);
+}// IsDecodedFile
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the filename has a PNG extension.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool CImageDecoder::IsPNGFile(const char* sFilename)
+{
+    return HasAnyExtension(sFilename, c_asPNGExtensions);
+}// IsPNGFile
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the reduction is 1, 2, 4 or 8.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool CImageDecoder::IsValidReduction(int reduction)
+{
+    return reduction >= 1 && reduction <= c_maxReduction && !(reduction & (reduction - 1));
+}// IsValidReduction
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Decode a PNG or JPEG file with the registered decoder, averaging each
+//  reduction by reduction block of pixels into one.  Returns a new image
+//  owned by the caller, or NULL on failure.
+//
+///////////////////////////////////////////////////////////////////////////////
+TargaImage* CImageDecoder::Load(const char* sFilename, int reduction)
+{
+    if (!IsValidReduction(reduction))
+    {
+        cout << "Reduction must be 1, 2, 4 or 8." << endl;
+        return NULL;
+    }// if
+
+    if (!s_decode)
+    {
+        cout << "No PNG or JPEG decoder in this program:  " << sFilename << endl;
+        return NULL;
+    }// if
+
+    return s_decode(sFilename, reduction);
+}// Load
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return a new image averaging each reduction by reduction block of the
+//  given image into one pixel.
+//
+///////////////////////////////////////////////////////////////////////////////
+TargaImage* CImageDecoder::Reduce(const TargaImage& image, int reduction)
+{
+    if (!IsValidReduction(reduction) || image.width <= 0 || image.height <= 0)
+        return NULL;
+
+    return Convert(image.data, image.width, image.height, 4, image.width * 4, true, reduction);
+}// Reduce
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      ImageDecoder.h
+//
+//      PNG and JPEG input.  The files are decoded by whichever decoder the
+//  program registers, so tools without the FLTK image libraries still link;
+//  the GUI registers CFltkDecoder.  Decoded pixels are premultiplied into a
+//  TargaImage, optionally reduced by 2, 4 or 8 in each direction in the same
+//  pass so that a preview never holds a second full resolution RGBA copy.
+//  Reduction is also available for images that were loaded some other way.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _C_IMAGE_DECODER
+#define _C_IMAGE_DECODER
+
+class TargaImage;
+
+// decodes a PNG or JPEG file into a new image reduced as CImageDecoder::Load, or returns NULL
+typedef TargaImage* (*FDecodeFile)(const char* sFilename, int reduction);
+
+class CImageDecoder
+{
+    // methods
+    public:
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Set the function that decodes PNG and JPEG files.  Call before any
+        //  image is loaded.  Until one is set those files fail to load.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static void SetFileDecoder(FDecodeFile decode);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Return true if the filename has a PNG or JPEG extension.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static bool IsDecodedFile(const char* sFilename);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Return true if the filename has a PNG extension.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static bool IsPNGFile(const char* sFilename);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Return true if the reduction is 1, 2, 4 or 8.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static bool IsValidReduction(int reduction);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Decode a PNG or JPEG file, averaging each reduction by reduction
+        //  block of pixels into one.  Returns a new image owned by the caller, or
+        //  NULL on failure.  Safe to call from several threads at once.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static TargaImage* Load(const char* sFilename, int reduction = 1);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Return a new image averaging each reduction by reduction block of
+        //  the given image into one pixel.  Partial blocks at the right and
+        //  bottom edges average the pixels they hold.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static TargaImage* Reduce(const TargaImage& image, int reduction);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Return a new image from rows of grey, grey and alpha, RGB or RGBA
+        //  pixels, averaging each reduction by reduction block into one.  Pixels
+        //  that are not yet premultiplied are premultiplied before they are
+        //  averaged.  Used by the file decoders.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static TargaImage* Convert(const unsigned char* pPixels, int width, int height, int channels,
+                                   int rowBytes, bool bPremultiplied, int reduction);
+
+    // members
+    private:
+        static FDecodeFile  s_decode;       // decoder for PNG and JPEG files, or NULL
+};// CImageDecoder
+
+#endif // _C_IMAGE_DECODER
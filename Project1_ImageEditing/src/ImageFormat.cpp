@@ -0,0 +1,693 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      ImageFormat.cpp
+//
+//      Implementation of CImageFormat methods.  Uncompressed files are
+//  mapped copy-on-write so the image can be edited without touching the
+//  file.  Compressed files are split into chunks of whole rows; each row is
+//  replaced by its difference from the pixel to the left and the chunk is
+//  LZ compressed, so chunks encode and decode on separate threads.  Saves
+//  go to a temporary file that is then renamed over the target, so an image
+//  mapped from the file it is saved to keeps reading the old file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "Globals.h"
+#include "ImageFormat.h"
+#include "TargaImage.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// constants
+const char      c_sExtension[]          = ".nim";                       // uncompressed file extension
+const char      c_sCompressedExtension[]= ".nimz";                      // compressed file extension
+const char      c_sTempSuffix[]         = ".tmp";                       // appended to the name while saving
+const char      c_acMagic[4]            = { 'N', 'I', 'M', 'G' };      // first bytes of every file
+const uint16_t  c_version               = 1;                            // current file version
+const uint16_t  c_compressedFlag        = 1;                            // header flag for compressed files
+const size_t    c_headerSize            = 64;                           // bytes before the pixel data
+const size_t    c_rowAlignment          = 64;                           // uncompressed row alignment
+const size_t    c_chunkBytes            = 1 << 18;                      // target uncompressed bytes per chunk
+const uint32_t  c_storedChunk           = 0x80000000u;                  // chunk size flag for uncompressed chunks
+const int       c_hashBits              = 14;                           // log2 of the match table size
+const size_t    c_minMatch              = 4;                            // shortest match encoded
+const size_t    c_maxOffset             = 65535;                        // farthest match reachable
+const size_t    c_lastLiterals          = 5;                            // bytes at the end that are always literals
+const size_t    c_matchSearchEnd        = 12;                           // no match starts this close to the end
+
+// file header, stored in host (little-endian) byte order
+struct SHeader
+{
+    char        acMagic[4];
+    uint16_t    version;
+    uint16_t    flags;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    stride;             // bytes per row, uncompressed files
+    uint32_t    rowsPerChunk;       // rows per chunk, compressed files
+    uint32_t    chunkCount;         // chunks, compressed files
+    uint32_t    reserved;
+    uint64_t    payloadSize;        // bytes following the header
+    uint8_t     aPad[24];
+};
+
+static_assert(sizeof(SHeader) == c_headerSize, "native image header must be 64 bytes");
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the filename ends in the given extension, ignoring case.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool HasExtension(const char* sFilename, const char* sExtension)
+{
+    size_t nameLength = strlen(sFilename),
+           extLength = strlen(sExtension);
+
+    if (nameLength < extLength)
+        return false;
+
+    const char* sEnd = sFilename + nameLength - extLength;
+    for (size_t i = 0; i < extLength; ++i)
+        if (tolower((unsigned char)sEnd[i]) != sExtension[i])
+            return false;
+
+    return true;
+}// HasExtension
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Round a byte count up to a multiple of the row alignment.
+//
+///////////////////////////////////////////////////////////////////////////////
+static size_t AlignUp(size_t bytes)
+{
+    return (bytes + c_rowAlignment - 1) & ~(c_rowAlignment - 1);
+}// AlignUp
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Map a whole file copy-on-write.  Returns NULL on failure.
+//
+///////////////////////////////////////////////////////////////////////////////
+static SImageMapping* MapFile(const char* sFilename)
+{
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(sFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(hFile);
+        return NULL;
+    }// if
+
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    void* pView = hMapping ? MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0) : NULL;
+    if (!pView)
+    {
+        if (hMapping)
+            CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return NULL;
+    }// if
+
+    SImageMapping* pMapping = new SImageMapping;
+    pMapping->pView = pView;
+    pMapping->size = (size_t)fileSize.QuadPart;
+    pMapping->hFile = hFile;
+    pMapping->hMapping = hMapping;
+    return pMapping;
+#else
+    int file = open(sFilename, O_RDONLY);
+    if (file < 0)
+        return NULL;
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0)
+    {
+        close(file);
+        return NULL;
+    }// if
+
+    void* pView = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    close(file);
+    if (pView == MAP_FAILED)
+        return NULL;
+
+    SImageMapping* pMapping = new SImageMapping;
+    pMapping->pView = pView;
+    pMapping->size = (size_t)info.st_size;
+    return pMapping;
+#endif
+}// MapFile
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Rename a finished temporary file over the target, replacing it.  The
+//  old file lives on for any mapping of it.  Returns false on failure.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool MoveOver(const char* sTempFilename, const char* sFilename)
+{
+#ifdef _WIN32
+    return MoveFileExA(sTempFilename, sFilename, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(sTempFilename, sFilename) == 0;
+#endif
+}// MoveOver
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Largest possible compressed size of the given number of bytes.
+//
+///////////////////////////////////////////////////////////////////////////////
+static size_t CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}// CompressBound
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Read four unaligned bytes.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline uint32_t Read32(const unsigned char* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}// Read32
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Write the part of a length that doesn't fit in a token nibble.
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned char* WriteLength(unsigned char* pOut, size_t length)
+{
+    for (length -= 15; length >= 255; length -= 255)
+        *pOut++ = 255;
+    *pOut++ = (unsigned char)length;
+    return pOut;
+}// WriteLength
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Write one sequence: a token holding the literal count and match
+//  length less four, any extra length bytes, the literals and a two byte
+//  match offset.  A match length of zero writes the final, literal only,
+//  sequence.
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned char* WriteSequence(unsigned char* pOut, const unsigned char* pLiterals, size_t literals,
+                                    size_t matchLength, size_t offset)
+{
+    unsigned char* pToken = pOut++;
+    size_t matchCode = matchLength ? matchLength - c_minMatch : 0;
+
+    *pToken = (unsigned char)((Min<size_t>(literals, 15) << 4) | Min<size_t>(matchCode, 15));
+    if (literals >= 15)
+        pOut = WriteLength(pOut, literals);
+    memcpy(pOut, pLiterals, literals);
+    pOut += literals;
+
+    if (matchLength)
+    {
+        *pOut++ = (unsigned char)offset;
+        *pOut++ = (unsigned char)(offset >> 8);
+        if (matchCode >= 15)
+            pOut = WriteLength(pOut, matchCode);
+    }// if
+
+    return pOut;
+}// WriteSequence
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Greedy LZ compression with a single entry hash table.  The search
+//  steps further ahead the longer it goes without a match, so data that
+//  doesn't compress passes through quickly.  The output buffer must hold
+//  CompressBound(size) bytes.  Returns the compressed size.
+//
+///////////////////////////////////////////////////////////////////////////////
+static size_t Compress(const unsigned char* pSrc, size_t size, unsigned char* pDst)
+{
+    vector<uint32_t> table(1 << c_hashBits, 0);
+    unsigned char* pOut = pDst;
+    size_t anchor = 0;
+
+    if (size > c_matchSearchEnd)
+    {
+        size_t searchEnd = size - c_matchSearchEnd,
+               matchEnd = size - c_lastLiterals,
+               misses = 0;
+
+        for (size_t pos = 1; pos < searchEnd; )
+        {
+            uint32_t sequence = Read32(pSrc + pos);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - c_hashBits);
+            size_t candidate = table[hash];
+            table[hash] = (uint32_t)pos;
+
+            if (candidate >= pos || pos - candidate > c_maxOffset || Read32(pSrc + candidate) != sequence)
+            {
+                pos += 1 + (misses++ >> 6);
+                continue;
+            }// if
+
+            // grow the match back over pending literals, then forward
+            while (pos > anchor && candidate > 0 && pSrc[pos - 1] == pSrc[candidate - 1])
+            {
+                --pos;
+                --candidate;
+            }// while
+
+            size_t end = pos + c_minMatch,
+                   from = candidate + c_minMatch;
+            while (end + 8 <= matchEnd)
+            {
+                uint64_t a, b;
+                memcpy(&a, pSrc + end, sizeof(a));
+                memcpy(&b, pSrc + from, sizeof(b));
+                if (a != b)
+                    break;
+                end += 8;
+                from += 8;
+            }// while
+            while (end < matchEnd && pSrc[end] == pSrc[from])
+            {
+                ++end;
+                ++from;
+            }// while
+
+            pOut = WriteSequence(pOut, pSrc + anchor, pos - anchor, end - pos, pos - candidate);
+            if (end - 2 > pos)
+                table[(Read32(pSrc + end - 2) * 2654435761u) >> (32 - c_hashBits)] = (uint32_t)(end - 2);
+            pos = anchor = end;
+            misses = 0;
+        }// for
+    }// if
+
+    pOut = WriteSequence(pOut, pSrc + anchor, size - anchor, 0, 0);
+    return pOut - pDst;
+}// Compress
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Read the extension bytes of a length.  Returns false if the input runs
+//  out first.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool ReadLength(const unsigned char*& pIn, const unsigned char* pInEnd, size_t& length)
+{
+    unsigned char byte;
+    do
+    {
+        if (pIn >= pInEnd)
+            return false;
+        byte = *pIn++;
+        length += byte;
+    } while (byte == 255);
+
+    return true;
+}// ReadLength
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Undo Compress.  Every length and offset is checked, so a damaged file
+//  fails instead of writing out of bounds.  Returns true if exactly
+//  dstSize bytes were produced.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool Decompress(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize)
+{
+    const unsigned char* pIn = pSrc;
+    const unsigned char* pInEnd = pSrc + srcSize;
+    unsigned char* pOut = pDst;
+    unsigned char* pOutEnd = pDst + dstSize;
+
+    for (;;)
+    {
+        if (pIn >= pInEnd)
+            return false;
+
+        unsigned int token = *pIn++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !ReadLength(pIn, pInEnd, literals))
+            return false;
+        if ((size_t)(pInEnd - pIn) < literals || (size_t)(pOutEnd - pOut) < literals)
+            return false;
+
+        memcpy(pOut, pIn, literals);
+        pIn += literals;
+        pOut += literals;
+
+        if (pIn == pInEnd)
+            return pOut == pOutEnd;
+        if (pInEnd - pIn < 2)
+            return false;
+
+        size_t offset = pIn[0] | (pIn[1] << 8);
+        pIn += 2;
+        if (offset == 0 || offset > (size_t)(pOut - pDst))
+            return false;
+
+        size_t length = token & 15;
+        if (length == 15 && !ReadLength(pIn, pInEnd, length))
+            return false;
+        length += c_minMatch;
+        if ((size_t)(pOutEnd - pOut) < length)
+            return false;
+
+        // copies may overlap the bytes they produce, so go forward
+        const unsigned char* pMatch = pOut - offset;
+        size_t i = 0;
+        if (offset >= 8)
+            for (; i + 8 <= length; i += 8)
+                memcpy(pOut + i, pMatch + i, 8);
+        for (; i < length; ++i)
+            pOut[i] = pMatch[i];
+        pOut += length;
+    }// for
+}// Decompress
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return true if the filename has a native format extension.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool CImageFormat::IsNativeFile(const char* sFilename)
+{
+    return sFilename && (HasExtension(sFilename, c_sExtension) || HasExtension(sFilename, c_sCompressedExtension));
+}// IsNativeFile
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Write the image to the given file, compressed if the extension is
+//  ".nimz".  Returns false on failure.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool CImageFormat::Save(const TargaImage& image, const char* sFilename)
+{
+    bool bCompressed = HasExtension(sFilename, c_sCompressedExtension);
+    int width = image.data ? image.width : 0,
+        height = image.data ? image.height : 0;
+    size_t rowBytes = (size_t)width * 4;
+    if (!rowBytes)
+        height = 0;
+
+    SHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.acMagic, c_acMagic, sizeof(c_acMagic));
+    header.version = c_version;
+    header.flags = bCompressed ? c_compressedFlag : 0;
+    header.width = width;
+    header.height = height;
+
+    // the image may be mapped from the target, so leave it whole until the end
+    string sTempFilename = string(sFilename) + c_sTempSuffix;
+    FILE* pFile = fopen(sTempFilename.c_str(), "wb");
+    if (!pFile)
+    {
+        cout << "Unable to open file:  " << sFilename << endl;
+        return false;
+    }// if
+
+    if (!bCompressed)
+    {
+        header.stride = (uint32_t)AlignUp(rowBytes);
+        header.payloadSize = (uint64_t)header.stride * height;
+        fwrite(&header, sizeof(header), 1, pFile);
+
+        if (header.stride == rowBytes)
+            fwrite(image.data, 1, rowBytes * height, pFile);
+        else
+        {
+            unsigned char acPad[c_rowAlignment] = { 0 };
+            for (int row = 0; row < height; ++row)
+            {
+                fwrite(image.data + row * rowBytes, 1, rowBytes, pFile);
+                fwrite(acPad, 1, header.stride - rowBytes, pFile);
+            }// for
+        }// else
+    }// if
+    else
+    {
+        int rowsPerChunk = rowBytes ? (int)Max<size_t>(1, c_chunkBytes / rowBytes) : 1;
+        int chunkCount = (height + rowsPerChunk - 1) / rowsPerChunk;
+        vector< vector<unsigned char> > vChunks(chunkCount);
+        vector<uint32_t> vSizes(chunkCount);
+
+        ParallelFor(0, chunkCount, [&](int chunk)
+        {
+            int firstRow = chunk * rowsPerChunk,
+                endRow = Min(height, firstRow + rowsPerChunk);
+            size_t chunkBytes = (endRow - firstRow) * rowBytes;
+            const unsigned char* pSrc = image.data + firstRow * rowBytes;
+
+            // left-neighbour differences turn flat areas and gradients into repeats
+            vector<unsigned char> vFiltered(chunkBytes);
+            for (int row = 0; row < endRow - firstRow; ++row)
+            {
+                const unsigned char* pRow = pSrc + row * rowBytes;
+                unsigned char* pOut = &vFiltered[row * rowBytes];
+                memcpy(pOut, pRow, Min<size_t>(4, rowBytes));
+                for (size_t i = 4; i < rowBytes; ++i)
+                    pOut[i] = (unsigned char)(pRow[i] - pRow[i - 4]);
+            }// for
+
+            vector<unsigned char>& vOut = vChunks[chunk];
+            vOut.resize(CompressBound(chunkBytes));
+            size_t compressedBytes = Compress(&vFiltered[0], chunkBytes, &vOut[0]);
+
+            if (compressedBytes < chunkBytes)
+            {
+                vOut.resize(compressedBytes);
+                vSizes[chunk] = (uint32_t)compressedBytes;
+            }// if
+            else
+            {
+                vOut.assign(pSrc, pSrc + chunkBytes);
+                vSizes[chunk] = (uint32_t)chunkBytes | c_storedChunk;
+            }// else
+        });
+
+        size_t tableBytes = AlignUp(chunkCount * sizeof(uint32_t));
+        header.rowsPerChunk = rowsPerChunk;
+        header.chunkCount = chunkCount;
+        header.payloadSize = tableBytes;
+        for (int chunk = 0; chunk < chunkCount; ++chunk)
+            header.payloadSize += vChunks[chunk].size();
+
+        vSizes.resize(tableBytes / sizeof(uint32_t), 0);
+        fwrite(&header, sizeof(header), 1, pFile);
+        if (tableBytes)
+            fwrite(&vSizes[0], 1, tableBytes, pFile);
+        for (int chunk = 0; chunk < chunkCount; ++chunk)
+            fwrite(&vChunks[chunk][0], 1, vChunks[chunk].size(), pFile);
+    }// else
+
+    bool bResult = !ferror(pFile);
+    if (fclose(pFile) != 0)
+        bResult = false;
+    if (bResult)
+        bResult = MoveOver(sTempFilename.c_str(), sFilename);
+
+    if (!bResult)
+    {
+        remove(sTempFilename.c_str());
+        cout << "Unable to write file:  " << sFilename << endl;
+    }// if
+
+    return bResult;
+}// Save
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Load a native format file.  Returns a new image owned by the caller,
+//  or NULL on failure.
+//
+///////////////////////////////////////////////////////////////////////////////
+TargaImage* CImageFormat::Load(const char* sFilename)
+{
+    if (!sFilename)
+        return NULL;
+
+    SImageMapping* pMapping = MapFile(sFilename);
+    if (!pMapping)
+        return NULL;
+
+    const unsigned char* pFile = (const unsigned char*)pMapping->pView;
+    SHeader header;
+    bool bValid = pMapping->size >= c_headerSize;
+    if (bValid)
+    {
+        memcpy(&header, pFile, sizeof(header));
+        bValid = !memcmp(header.acMagic, c_acMagic, sizeof(c_acMagic)) && header.version == c_version &&
+                 (uint64_t)header.width * header.height * 4 < 0x80000000u &&
+                 header.payloadSize <= pMapping->size - c_headerSize;
+    }// if
+
+    size_t rowBytes = bValid ? (size_t)header.width * 4 : 0;
+    TargaImage* pImage = NULL;
+
+    if (bValid && !(header.flags & c_compressedFlag))
+    {
+        bValid = header.stride >= rowBytes && header.payloadSize == (uint64_t)header.stride * header.height;
+        if (bValid)
+        {
+            pImage = new TargaImage();
+            pImage->width = header.width;
+            pImage->height = header.height;
+
+            if (header.stride == rowBytes && rowBytes && header.height)
+            {
+                // rows are contiguous, so the view itself is the pixel data
+                pImage->data = (unsigned char*)pMapping->pView + c_headerSize;
+                pImage->mapping = pMapping;
+                return pImage;
+            }// if
+
+            pImage->data = new unsigned char[rowBytes * header.height];
+            for (uint32_t row = 0; row < header.height; ++row)
+                memcpy(pImage->data + row * rowBytes, pFile + c_headerSize + row * header.stride, rowBytes);
+        }// if
+    }// if
+    else if (bValid)
+    {
+        size_t tableBytes = AlignUp((size_t)header.chunkCount * sizeof(uint32_t));
+        bValid = header.rowsPerChunk > 0 &&
+                 (uint64_t)header.chunkCount == ((uint64_t)header.height + header.rowsPerChunk - 1) / header.rowsPerChunk &&
+                 tableBytes <= header.payloadSize;
+
+        // find where each chunk starts
+        vector<uint32_t> vSizes(bValid ? header.chunkCount : 0);
+        vector<size_t> vOffsets(vSizes.size());
+        size_t offset = c_headerSize + tableBytes;
+        if (!vSizes.empty())
+            memcpy(&vSizes[0], pFile + c_headerSize, vSizes.size() * sizeof(uint32_t));
+        for (size_t chunk = 0; chunk < vSizes.size(); ++chunk)
+        {
+            vOffsets[chunk] = offset;
+            offset += vSizes[chunk] & ~c_storedChunk;
+        }// for
+        bValid = bValid && offset - c_headerSize == header.payloadSize;
+
+        if (bValid)
+        {
+            pImage = new TargaImage();
+            pImage->width = header.width;
+            pImage->height = header.height;
+            pImage->data = new unsigned char[rowBytes * header.height];
+
+            int height = header.height,
+                rowsPerChunk = header.rowsPerChunk;
+            vector<char> vbChunkValid(vSizes.size(), 0);
+
+            ParallelFor(0, (int)vSizes.size(), [&](int chunk)
+            {
+                int firstRow = chunk * rowsPerChunk,
+                    endRow = Min(height, firstRow + rowsPerChunk);
+                size_t chunkBytes = (endRow - firstRow) * rowBytes;
+                const unsigned char* pSrc = pFile + vOffsets[chunk];
+                unsigned char* pDst = pImage->data + firstRow * rowBytes;
+
+                if (vSizes[chunk] & c_storedChunk)
+                {
+                    vbChunkValid[chunk] = (vSizes[chunk] & ~c_storedChunk) == chunkBytes;
+                    if (vbChunkValid[chunk])
+                        memcpy(pDst, pSrc, chunkBytes);
+                    return;
+                }// if
+
+                vbChunkValid[chunk] = Decompress(pSrc, vSizes[chunk], pDst, chunkBytes);
+                if (!vbChunkValid[chunk])
+                    return;
+
+                // add the differences back a pixel at a time, four bytes per add
+                // with the carries between channels masked off
+                for (int row = 0; rowBytes && row < endRow - firstRow; ++row)
+                {
+                    unsigned char* pRow = pDst + row * rowBytes;
+                    uint32_t pixel = Read32(pRow);
+                    for (size_t i = 4; i < rowBytes; i += 4)
+                    {
+                        uint32_t delta = Read32(pRow + i);
+                        pixel = ((pixel & 0x7F7F7F7Fu) + (delta & 0x7F7F7F7Fu)) ^ ((pixel ^ delta) & 0x80808080u);
+                        memcpy(pRow + i, &pixel, sizeof(pixel));
+                    }// for
+                }// for
+            });
+
+            for (size_t chunk = 0; chunk < vbChunkValid.size(); ++chunk)
+                bValid = bValid && vbChunkValid[chunk];
+        }// if
+    }// else if
+
+    ReleaseMapping(pMapping);
+
+    if (!bValid)
+    {
+        cout << "Not a valid image file:  " << sFilename << endl;
+        delete pImage;
+        return NULL;
+    }// if
+
+    return pImage;
+}// Load
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Unmap and free a mapping made by Load.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CImageFormat::ReleaseMapping(SImageMapping* pMapping)
+{
+    if (!pMapping)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(pMapping->pView);
+    CloseHandle(pMapping->hMapping);
+    CloseHandle(pMapping->hFile);
+#else
+    munmap(pMapping->pView, pMapping->size);
+#endif
+
+    delete pMapping;
+}// ReleaseMapping
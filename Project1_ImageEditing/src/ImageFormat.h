@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      ImageFormat.h
+//
+//      Native intermediate image format for multi-step pipelines.  Files
+//  hold the premultiplied RGBA rows of a TargaImage behind a fixed 64 byte
+//  header, either uncompressed with rows padded to 64 bytes (".nim") or
+//  delta filtered and LZ compressed in independent row chunks (".nimz").
+//  Uncompressed files are mapped straight into the image when the rows need
+//  no padding.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _C_IMAGE_FORMAT
+#define _C_IMAGE_FORMAT
+
+#include <stddef.h>
+
+class TargaImage;
+
+// a file view backing the pixel data of a TargaImage
+struct SImageMapping
+{
+    void*       pView;                      // start of the mapped file
+    size_t      size;                       // bytes mapped
+#ifdef _WIN32
+    void*       hFile;                      // file handle
+    void*       hMapping;                   // file mapping handle
+#endif
+};
+
+class CImageFormat
+{
+    // methods
+    public:
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Return true if the filename has a native format extension.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static bool IsNativeFile(const char* sFilename);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Write the image to the given file, compressed if the extension is
+        //  ".nimz".  Returns false on failure.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static bool Save(const TargaImage& image, const char* sFilename);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Load a native format file.  Returns a new image owned by the caller,
+        //  or NULL on failure.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static TargaImage* Load(const char* sFilename);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Unmap and free a mapping made by Load.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static void ReleaseMapping(SImageMapping* pMapping);
+};// CImageFormat
+
+#endif // _C_IMAGE_FORMAT
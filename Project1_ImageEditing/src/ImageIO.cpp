@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      ImageIO.cpp
+//
+//      Implementation of CImageIO methods.  A single writer thread drains a
+//  bounded queue of saves, and loads are started early with std::async so
+//  their disk time overlaps with the commands before them.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "ImageIO.h"
+#include "TargaImage.h"
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// constants
+const size_t    c_maxQueuedWrites       = 4;                            // saves allowed to wait before Save blocks
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Get the I/O queue shared by all script commands.
+//
+///////////////////////////////////////////////////////////////////////////////
+CImageIO& CImageIO::Instance()
+{
+    static CImageIO s_instance;
+    return s_instance;
+}// Instance
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Constructor.  Start the writer thread.
+//
+///////////////////////////////////////////////////////////////////////////////
+CImageIO::CImageIO() : m_bWriteFailed(false), m_bShutdown(false)
+{
+    m_writer = thread(&CImageIO::WriterLoop, this);
+}// CImageIO
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Destructor.  Finish outstanding writes, stop the writer and drop any
+//  prefetched images nobody asked for.
+//
+///////////////////////////////////////////////////////////////////////////////
+CImageIO::~CImageIO()
+{
+    Flush();
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_bShutdown = true;
+    }
+    m_queueChanged.notify_all();
+    m_writer.join();
+
+    for (map<pair<string, int>, future<TargaImage*> >::iterator i = m_prefetched.begin(); i != m_prefetched.end(); ++i)
+        delete i->second.get();
+}// ~CImageIO
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Start loading the given file in the background, reduced as for
+//  TargaImage::Load_Image.  Does nothing if a load of this file at this
+//  reduction is already in flight.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CImageIO::Prefetch(const char* sFilename, int reduction)
+{
+    if (!sFilename)
+        return;
+
+    lock_guard<mutex> lock(m_mutex);
+    pair<string, int> key(sFilename, reduction);
+    if (m_prefetched.count(key))
+        return;
+
+    string sName(sFilename);
+    m_prefetched[key] = async(launch::async, [this, sName, reduction]() -> TargaImage*
+    {
+        WaitForWrites(sName);
+        string sPath(sName);
+        return TargaImage::Load_Image(&sPath[0], reduction);
+    });
+}// Prefetch
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return a new image loaded from the given file at the given reduction,
+//  taking a prefetched result if there is one.  Pending saves to the same
+//  file are completed first.  Returns NULL on failure; the caller owns the
+//  image.
+//
+///////////////////////////////////////////////////////////////////////////////
+TargaImage* CImageIO::Load(const char* sFilename, int reduction)
+{
+    if (!sFilename)
+        return TargaImage::Load_Image(NULL);
+
+    string sName(sFilename);
+    future<TargaImage*> pending;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        map<pair<string, int>, future<TargaImage*> >::iterator i = m_prefetched.find(make_pair(sName, reduction));
+        if (i != m_prefetched.end())
+        {
+            pending = move(i->second);
+            m_prefetched.erase(i);
+        }// if
+    }
+
+    if (pending.valid())
+        return pending.get();
+
+    WaitForWrites(sName);
+    return TargaImage::Load_Image(&sName[0], reduction);
+}// Load
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Queue a copy of the image to be written to the given file.  Blocks
+//  only while the write queue is full.  Prefetches of the same file are
+//  thrown away since they would read the old contents.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CImageIO::Save(const TargaImage& image, const char* sFilename)
+{
+    SWriteRequest request;
+    request.pImage = new TargaImage(image);
+    request.sFilename = sFilename;
+
+    vector<future<TargaImage*> > vStale;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_queueChanged.wait(lock, [this]() { return m_writeQueue.size() < c_maxQueuedWrites; });
+
+        map<pair<string, int>, future<TargaImage*> >::iterator i = m_prefetched.lower_bound(make_pair(request.sFilename, 0));
+        while (i != m_prefetched.end() && i->first.first == request.sFilename)
+        {
+            vStale.push_back(move(i->second));
+            m_prefetched.erase(i++);
+        }// while
+
+        ++m_pendingWrites[request.sFilename];
+        m_writeQueue.push_back(request);
+    }
+    m_queueChanged.notify_all();
+
+    for (size_t i = 0; i < vStale.size(); ++i)
+        delete vStale[i].get();
+}// Save
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Wait until every queued save has been written.  Returns false if any
+//  of them failed since the last flush.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool CImageIO::Flush()
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_queueChanged.wait(lock, [this]() { return m_pendingWrites.empty(); });
+
+    bool bResult = !m_bWriteFailed;
+    m_bWriteFailed = false;
+    return bResult;
+}// Flush
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Wait for queued or in-progress saves to the given file to complete.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CImageIO::WaitForWrites(const string& sFilename)
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_queueChanged.wait(lock, [this, &sFilename]() { return !m_pendingWrites.count(sFilename); });
+}// WaitForWrites
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Body of the writer thread.  Write queued images in order until told to
+//  shut down.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CImageIO::WriterLoop()
+{
+    unique_lock<mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_queueChanged.wait(lock, [this]() { return m_bShutdown || !m_writeQueue.empty(); });
+        if (m_writeQueue.empty())
+            return;
+
+        SWriteRequest request = m_writeQueue.front();
+        m_writeQueue.pop_front();
+        m_queueChanged.notify_all();
+
+        lock.unlock();
+        bool bResult = request.pImage->Save_Image(request.sFilename.c_str());
+        if (!bResult)
+            cout << "Unable to save image:  " << request.sFilename << endl;
+        delete request.pImage;
+        lock.lock();
+
+        if (!bResult)
+            m_bWriteFailed = true;
+        if (--m_pendingWrites[request.sFilename] == 0)
+            m_pendingWrites.erase(request.sFilename);
+        m_queueChanged.notify_all();
+    }// for
+}// WriterLoop
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      ImageIO.h
+//
+//      Background image I/O for the script handler.  Loads can be issued
+//  ahead of the command that uses them and saves are handed to a writer
+//  thread so that the next command overlaps with disk I/O.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _C_IMAGE_IO
+#define _C_IMAGE_IO
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+class TargaImage;
+
+class CImageIO
+{
+    // methods
+    public:
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Get the I/O queue shared by all script commands.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static CImageIO& Instance();
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Start loading the given file in the background, reduced as for
+        //  TargaImage::Load_Image.  Does nothing if a load of this file at this
+        //  reduction is already in flight.  Several prefetches decode at once.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        void Prefetch(const char* sFilename, int reduction = 1);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Return a new image loaded from the given file at the given reduction,
+        //  taking a prefetched result if there is one.  Pending saves to the same
+        //  file are completed first.  Returns NULL on failure; the caller owns the
+        //  image.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        TargaImage* Load(const char* sFilename, int reduction = 1);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Queue a copy of the image to be written to the given file.  Blocks
+        //  only while the write queue is full.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        void Save(const TargaImage& image, const char* sFilename);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Wait until every queued save has been written.  Returns false if any
+        //  of them failed since the last flush.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        bool Flush();
+
+    private:
+        CImageIO();
+        ~CImageIO();
+
+        void WriterLoop();                                  // body of the writer thread
+        void WaitForWrites(const std::string& sFilename);   // wait for pending saves to one file
+
+    // members
+    private:
+        struct SWriteRequest
+        {
+            TargaImage*     pImage;                         // private copy of the image to write
+            std::string     sFilename;                      // destination file
+        };
+
+        std::mutex                                  m_mutex;            // guards everything below
+        std::condition_variable                     m_queueChanged;     // signalled on push, pop and completion
+        std::deque<SWriteRequest>                   m_writeQueue;       // saves waiting for the writer
+        std::map<std::string, int>                  m_pendingWrites;    // queued or in-progress saves per file
+        std::map<std::pair<std::string, int>, std::future<TargaImage*> > m_prefetched;  // loads issued ahead of use, by file and reduction
+        bool                                        m_bWriteFailed;     // a save failed since the last flush
+        bool                                        m_bShutdown;        // tell the writer thread to exit
+        std::thread                                 m_writer;           // write-behind thread
+};// CImageIO
+
+#endif // _C_IMAGE_IO
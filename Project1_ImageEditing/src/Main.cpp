@@ -21,7 +21,11 @@
 #include <vector>
 #include "TargaImage.h"
 #include "ImageWidget.h"
+#include "FltkDecoder.h"
+#include "ImageDecoder.h"
 #include "ScriptHandler.h"
+#include "ImageIO.h"
+#include "Profiler.h"
 
 
 using namespace std;
@@ -29,6 +33,8 @@ using namespace std;
 // constants
 const char      c_sNames[]          = "-names";             // display student names command line switch
 const char      c_sHeadless[]       = "-headless";          // headless command line switch
+const char      c_sProfile[]        = "-profile";           // profile script commands, optionally followed by a trace file
+const char      c_sTraceExtension[] = ".json";              // extension that marks the argument after -profile as a trace file
 
 // globals
 std::vector<char*>  vsStudentNames;
@@ -95,9 +101,13 @@ int main(int argc, char *argv[])
     // fill in the names
     MakeNames();
 
+    // decode PNG and JPEG files with FLTK
+    CImageDecoder::SetFileDecoder(CFltkDecoder::Load);
+
     // check command line arguments
     TargaImage* pImage = NULL;
     bool bHeadless = false;
+    bool bSucceeded = true;
 
     for (int i = script_arg; i < argc; ++i)
     {
@@ -105,15 +115,28 @@ int main(int argc, char *argv[])
             DisplayNames();
         else if (!bHeadless && !strcmp(argv[i], c_sHeadless))           // go headless
             bHeadless = true;
+        else if (!strcmp(argv[i], c_sProfile))                          // profile scripts
+        {
+            const char* sTrace = NULL;
+            if (i + 1 < argc && strlen(argv[i + 1]) > strlen(c_sTraceExtension) &&
+                !strcmp(argv[i + 1] + strlen(argv[i + 1]) - strlen(c_sTraceExtension), c_sTraceExtension))
+                sTrace = argv[++i];
+
+            CProfiler::Instance().Enable(sTrace);
+        }// else if
         else if (bHeadless && strcmp(argv[i], c_sHeadless))             // run script file
-            CScriptHandler::HandleScriptFile(argv[i], pImage);
+            bSucceeded = CScriptHandler::HandleScriptFile(argv[i], pImage) && bSucceeded;
         else
         {
-            cerr << "Usage:" << endl << "Project1 [-names] [-headless scriptFilenames . . .]" << endl;
+            cerr << "Usage:" << endl << "Project1 [-names] [-profile [trace.json]] [-headless scriptFilenames . . .]" << endl;
             return 0;
         }// else
     }// for
 
+    // make sure script saves are on disk before the GUI or exit
+    bSucceeded = CImageIO::Instance().Flush() && bSucceeded;
+    CProfiler::Instance().Report();
+
     // print name reminder
 //    if (vsStudentNames.empty())
 //        cout << "This project has no author names.  Please add your" << endl
@@ -136,7 +159,7 @@ int main(int argc, char *argv[])
         return Fl::run();
     }// else
 
-    return 0;
+    return bSucceeded ? 0 : 1;
 }// main
 
 
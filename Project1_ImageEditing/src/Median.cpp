@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Median.cpp
+//
+//      Implementation of the constant time median filter.  Histograms have
+//  a coarse level of 16 bins over the high nibble and a fine level of 256
+//  bins.  The window's coarse histogram is kept up to date at every pixel;
+//  a fine segment is only brought up to date when the median falls in it.
+//  The image is cut into horizontal strips, one per thread, each sweeping
+//  its own column histograms down its rows.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "Median.h"
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+// constants
+const int       c_coarseBins            = 16;                           // bins indexed by value >> 4
+const int       c_fineBins              = 256;                          // bins indexed by value
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Clamp an index to [0, size).
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline int ClampIndex(int index, int size)
+{
+    return Min(Max(index, 0), size - 1);
+}// ClampIndex
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Add or subtract 16 bins.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline void AddBins(uint16_t* pTarget, const uint16_t* pSource)
+{
+    for (int bin = 0; bin < 16; ++bin)
+        pTarget[bin] += pSource[bin];
+}// AddBins
+
+static inline void SubtractBins(uint16_t* pTarget, const uint16_t* pSource)
+{
+    for (int bin = 0; bin < 16; ++bin)
+        pTarget[bin] -= pSource[bin];
+}// SubtractBins
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter one channel of the rows [first, last).
+//
+///////////////////////////////////////////////////////////////////////////////
+static void MedianStrip(const unsigned char* pSrc, unsigned char* pDst, int width, int height, int radius,
+                        int channel, int first, int last)
+{
+    vector<uint16_t> vColumnCoarse(width * c_coarseBins), vColumnFine(width * c_fineBins);
+    int rowBytes = width * 4,
+        half = (2 * radius + 1) * (2 * radius + 1) / 2;     // the median has exactly this many values below it
+
+    auto addRow = [&](int row, uint16_t delta)
+    {
+        const unsigned char* pRow = pSrc + ClampIndex(row, height) * rowBytes + channel;
+        for (int x = 0; x < width; ++x)
+        {
+            vColumnCoarse[x * c_coarseBins + (pRow[x * 4] >> 4)] += delta;
+            vColumnFine[x * c_fineBins + pRow[x * 4]] += delta;
+        }// for
+    };
+
+    for (int row = first - radius; row <= first + radius; ++row)
+        addRow(row, 1);
+
+    for (int y = first; y < last; ++y)
+    {
+        // move the column histograms down a row, counts wrap around harmlessly
+        if (y > first)
+        {
+            addRow(y - radius - 1, (uint16_t)-1);
+            addRow(y + radius, 1);
+        }// if
+
+        uint16_t aCoarse[c_coarseBins] = { 0 },
+                 aFine[c_fineBins];
+        int aFineColumn[c_coarseBins];      // column each fine segment was last brought up to, -1 if never
+        for (int segment = 0; segment < c_coarseBins; ++segment)
+            aFineColumn[segment] = -1;
+
+        for (int column = -radius; column <= radius; ++column)
+            AddBins(aCoarse, &vColumnCoarse[ClampIndex(column, width) * c_coarseBins]);
+
+        unsigned char* pOut = pDst + y * rowBytes + channel;
+        for (int x = 0; x < width; ++x)
+        {
+            if (x > 0)
+            {
+                AddBins(aCoarse, &vColumnCoarse[ClampIndex(x + radius, width) * c_coarseBins]);
+                SubtractBins(aCoarse, &vColumnCoarse[ClampIndex(x - radius - 1, width) * c_coarseBins]);
+            }// if
+
+            int below = 0,
+                segment = 0;
+            while (below + aCoarse[segment] <= half)
+                below += aCoarse[segment++];
+
+            // bring the segment's fine bins to this column, from scratch if that is cheaper
+            uint16_t* pFine = aFine + segment * 16;
+            int offset = segment * 16;
+            if (aFineColumn[segment] < 0 || x - aFineColumn[segment] > radius)
+            {
+                memset(pFine, 0, 16 * sizeof(uint16_t));
+                for (int column = x - radius; column <= x + radius; ++column)
+                    AddBins(pFine, &vColumnFine[ClampIndex(column, width) * c_fineBins + offset]);
+            }// if
+            else
+            {
+                for (int column = aFineColumn[segment] + 1; column <= x; ++column)
+                {
+                    AddBins(pFine, &vColumnFine[ClampIndex(column + radius, width) * c_fineBins + offset]);
+                    SubtractBins(pFine, &vColumnFine[ClampIndex(column - radius - 1, width) * c_fineBins + offset]);
+                }// for
+            }// else
+            aFineColumn[segment] = x;
+
+            int bin = 0;
+            while (below + pFine[bin] <= half)
+                below += pFine[bin++];
+
+            pOut[x * 4] = (unsigned char)(offset + bin);
+        }// for
+    }// for
+}// MedianStrip
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Median filter every channel, one strip of rows per thread.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool MedianFilter(const unsigned char* pSrc, unsigned char* pDst, int width, int height, int radius)
+{
+    if (radius < 0 || radius > c_maxMedianRadius)
+        return false;
+
+    if (!pSrc || !pDst || width <= 0 || height <= 0)
+        return true;
+
+    // each strip pays 2 * radius + 1 rows to start its column histograms
+    int strips = Min(height, Max(1, (int)thread::hardware_concurrency()));
+    ParallelFor(0, strips, [&](int strip)
+    {
+        int first = (int)((long long)height * strip / strips),
+            last = (int)((long long)height * (strip + 1) / strips);
+
+        for (int channel = 0; channel < 4; ++channel)
+            MedianStrip(pSrc, pDst, width, height, radius, channel, first, last);
+    });
+
+    return true;
+}// MedianFilter
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Median filter by partially sorting the window of every pixel.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool MedianFilterRef(const unsigned char* pSrc, unsigned char* pDst, int width, int height, int radius)
+{
+    if (radius < 0 || radius > c_maxMedianRadius)
+        return false;
+
+    if (!pSrc || !pDst || width <= 0 || height <= 0)
+        return true;
+
+    vector<unsigned char> vWindow((2 * radius + 1) * (2 * radius + 1));
+    size_t half = vWindow.size() / 2;
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            for (int channel = 0; channel < 4; ++channel)
+            {
+                size_t count = 0;
+                for (int dy = -radius; dy <= radius; ++dy)
+                    for (int dx = -radius; dx <= radius; ++dx)
+                        vWindow[count++] = pSrc[(ClampIndex(y + dy, height) * width + ClampIndex(x + dx, width)) * 4 + channel];
+
+                nth_element(vWindow.begin(), vWindow.begin() + half, vWindow.end());
+                pDst[(y * width + x) * 4 + channel] = vWindow[half];
+            }// for
+
+    return true;
+}// MedianFilterRef
@@ -0,0 +1,35 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Median.h
+//
+//      Median filter whose cost per pixel does not grow with the radius,
+//  after Perreault and Hebert, "Median Filtering in Constant Time".  Each
+//  column keeps a histogram of the rows under the window and the window's
+//  histogram slides along a row by adding one column and removing another.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MEDIAN_H_
+#define _MEDIAN_H_
+
+const int       c_maxMedianRadius       = 127;                          // keeps window counts in 16 bits
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Write to pDst the median of each channel over the (2 * radius + 1)
+//  square around every pixel of pSrc, repeating edge pixels outside the
+//  image.  Both images are width x height RGBA.  Returns false if the
+//  radius is negative or larger than c_maxMedianRadius.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool MedianFilter(const unsigned char* pSrc, unsigned char* pDst, int width, int height, int radius);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      The same by sorting every window on the calling thread.  Kept as the
+//  reference MedianFilter is checked against.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool MedianFilterRef(const unsigned char* pSrc, unsigned char* pDst, int width, int height, int radius);
+
+#endif // _MEDIAN_H_
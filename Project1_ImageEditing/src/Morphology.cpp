@@ -0,0 +1,206 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Morphology.cpp
+//
+//      Implementation of van Herk / Gil-Werman morphology.  A line is cut
+//  into blocks the length of the element; the extreme over any window is
+//  then the suffix extreme of one block and the prefix extreme of the next.
+//  The horizontal pass walks pixels and is spread across rows; the
+//  vertical pass walks whole rows at once, so with SSE2 it compares 16
+//  bytes at a time, and is spread across strips of columns.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "Morphology.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MORPHOLOGY_SSE2
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// constants
+const int       c_stripBytes            = 256;                          // bytes of a row per vertical pass strip
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Store the per-byte minimum or maximum of pA and pB in pDst.
+//
+///////////////////////////////////////////////////////////////////////////////
+static inline void Extreme(unsigned char* pDst, const unsigned char* pA, const unsigned char* pB, int bytes, bool bMax)
+{
+    int i = 0;
+
+#ifdef MORPHOLOGY_SSE2
+    for (; i + 16 <= bytes; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(pA + i)),
+                b = _mm_loadu_si128((const __m128i*)(pB + i));
+        _mm_storeu_si128((__m128i*)(pDst + i), bMax ? _mm_max_epu8(a, b) : _mm_min_epu8(a, b));
+    }// for
+#endif
+
+    for (; i < bytes; ++i)
+        pDst[i] = bMax ? Max(pA[i], pB[i]) : Min(pA[i], pB[i]);
+}// Extreme
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Running minimum or maximum over a window of size elements along a
+//  line of count elements, each lanes bytes wide.  Element i of pSrc is at
+//  pSrc + i * srcStride.  vPrefix and vSuffix are scratch space.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void RunningExtreme(const unsigned char* pSrc, int srcStride, unsigned char* pDst, int dstStride,
+                           int count, int lanes, int size, bool bMax,
+                           vector<unsigned char>& vPrefix, vector<unsigned char>& vSuffix)
+{
+    // the line is padded so window i covers padded elements [i, i + size);
+    // dilation uses the reflected window so that opening and closing pair up
+    int before = bMax ? size / 2 : (size - 1) / 2,
+        blocks = (count + size - 1 + size - 1) / size,
+        padded = blocks * size;
+    vector<unsigned char> vIdentity(lanes, bMax ? 0 : 255);
+    vPrefix.resize((size_t)padded * lanes);
+    vSuffix.resize((size_t)padded * lanes);
+
+    auto element = [&](int j) -> const unsigned char*
+    {
+        j -= before;
+        return j >= 0 && j < count ? pSrc + (size_t)j * srcStride : &vIdentity[0];
+    };
+
+    for (int block = 0; block < padded; block += size)
+    {
+        unsigned char* pPrefix = &vPrefix[(size_t)block * lanes];
+        memcpy(pPrefix, element(block), lanes);
+        for (int j = 1; j < size; ++j)
+            Extreme(pPrefix + j * lanes, pPrefix + (j - 1) * lanes, element(block + j), lanes, bMax);
+
+        unsigned char* pSuffix = &vSuffix[(size_t)block * lanes];
+        memcpy(pSuffix + (size - 1) * lanes, element(block + size - 1), lanes);
+        for (int j = size - 2; j >= 0; --j)
+            Extreme(pSuffix + j * lanes, pSuffix + (j + 1) * lanes, element(block + j), lanes, bMax);
+    }// for
+
+    for (int i = 0; i < count; ++i)
+        Extreme(pDst + (size_t)i * dstStride, &vSuffix[(size_t)i * lanes], &vPrefix[(size_t)(i + size - 1) * lanes], lanes, bMax);
+}// RunningExtreme
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Erode or dilate pData in place, using vTemp between the passes.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void ErodeDilate(unsigned char* pData, vector<unsigned char>& vTemp, int width, int height,
+                        int elementWidth, int elementHeight, bool bMax)
+{
+    int rowBytes = width * 4;
+
+    ParallelFor(0, height, [&](int row)
+    {
+        vector<unsigned char> vPrefix, vSuffix;
+        RunningExtreme(pData + row * rowBytes, 4, &vTemp[row * rowBytes], 4,
+                       width, 4, elementWidth, bMax, vPrefix, vSuffix);
+    });
+
+    int strips = (rowBytes + c_stripBytes - 1) / c_stripBytes;
+    ParallelFor(0, strips, [&](int strip)
+    {
+        vector<unsigned char> vPrefix, vSuffix;
+        int first = strip * c_stripBytes;
+        RunningExtreme(&vTemp[first], rowBytes, pData + first, rowBytes,
+                       height, Min(c_stripBytes, rowBytes - first), elementHeight, bMax, vPrefix, vSuffix);
+    });
+}// ErodeDilate
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Apply a morphological operation.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool Morphology(unsigned char* pData, int width, int height, EMorphologyOp op, int elementWidth, int elementHeight)
+{
+    if (elementWidth < 1 || elementHeight < 1 || op < 0 || op >= NUM_MORPHOLOGY_OPS)
+        return false;
+
+    if (!pData || width <= 0 || height <= 0)
+        return true;
+
+    // beyond this every window already covers the whole line
+    elementWidth = Min(elementWidth, 2 * width + 1);
+    elementHeight = Min(elementHeight, 2 * height + 1);
+
+    vector<unsigned char> vTemp(width * height * 4);
+    bool bFirstMax = op == MORPH_DILATE || op == MORPH_CLOSE;
+
+    ErodeDilate(pData, vTemp, width, height, elementWidth, elementHeight, bFirstMax);
+    if (op == MORPH_OPEN || op == MORPH_CLOSE)
+        ErodeDilate(pData, vTemp, width, height, elementWidth, elementHeight, !bFirstMax);
+
+    return true;
+}// Morphology
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Erode or dilate pSrc into pDst, taking the minimum or maximum over
+//  the element placed as RunningExtreme places its windows.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void ErodeDilateRef(const unsigned char* pSrc, unsigned char* pDst, int width, int height,
+                           int elementWidth, int elementHeight, bool bMax)
+{
+    int left = bMax ? elementWidth / 2 : (elementWidth - 1) / 2,
+        top = bMax ? elementHeight / 2 : (elementHeight - 1) / 2;
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            for (int channel = 0; channel < 4; ++channel)
+            {
+                unsigned char extreme = bMax ? 0 : 255;
+                for (int ey = y - top; ey < y - top + elementHeight; ++ey)
+                    for (int ex = x - left; ex < x - left + elementWidth; ++ex)
+                        if (ey >= 0 && ey < height && ex >= 0 && ex < width)
+                        {
+                            unsigned char value = pSrc[(ey * width + ex) * 4 + channel];
+                            extreme = bMax ? Max(extreme, value) : Min(extreme, value);
+                        }// if
+
+                pDst[(y * width + x) * 4 + channel] = extreme;
+            }// for
+}// ErodeDilateRef
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Apply a morphological operation directly.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool MorphologyRef(unsigned char* pData, int width, int height, EMorphologyOp op, int elementWidth, int elementHeight)
+{
+    if (elementWidth < 1 || elementHeight < 1 || op < 0 || op >= NUM_MORPHOLOGY_OPS)
+        return false;
+
+    if (!pData || width <= 0 || height <= 0)
+        return true;
+
+    vector<unsigned char> vTemp(pData, pData + width * height * 4);
+    bool bFirstMax = op == MORPH_DILATE || op == MORPH_CLOSE;
+
+    ErodeDilateRef(&vTemp[0], pData, width, height, elementWidth, elementHeight, bFirstMax);
+    if (op == MORPH_OPEN || op == MORPH_CLOSE)
+    {
+        vTemp.assign(pData, pData + width * height * 4);
+        ErodeDilateRef(&vTemp[0], pData, width, height, elementWidth, elementHeight, !bFirstMax);
+    }// if
+
+    return true;
+}// MorphologyRef
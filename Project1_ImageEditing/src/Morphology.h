@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Morphology.h
+//
+//      Erosion, dilation, opening and closing with rectangular structuring
+//  elements.  Each pass uses the van Herk / Gil-Werman running minimum and
+//  maximum, which costs three comparisons per pixel whatever the element
+//  size.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MORPHOLOGY_H_
+#define _MORPHOLOGY_H_
+
+enum EMorphologyOp
+{
+    MORPH_ERODE,        // minimum over the element
+    MORPH_DILATE,       // maximum over the element
+    MORPH_OPEN,         // erode then dilate
+    MORPH_CLOSE,        // dilate then erode
+    NUM_MORPHOLOGY_OPS
+};// EMorphologyOp
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Apply the operation to every channel of the width x height RGBA
+//  image.  Erosion centres the element as a filter kernel is and dilation
+//  uses its reflection; pixels outside the image are ignored.  Returns
+//  false if an element side is less than one.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool Morphology(unsigned char* pData, int width, int height, EMorphologyOp op, int elementWidth, int elementHeight);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      The same by scanning the whole element at every pixel on the calling
+//  thread.  Kept as the reference Morphology is checked against.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool MorphologyRef(unsigned char* pData, int width, int height, EMorphologyOp op, int elementWidth, int elementHeight);
+
+#endif // _MORPHOLOGY_H_
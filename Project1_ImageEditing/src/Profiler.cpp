@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Profiler.cpp
+//
+//      Implementation of CProfiler methods.  Allocated bytes are counted by
+//  replacing the global operator new, which costs one relaxed atomic add
+//  per allocation whether or not profiling is on; memory allocated by the
+//  C library (libtarga) is not counted.  CPU time and peak resident set
+//  come from the operating system.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Globals.h"
+#include "Profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+    #include <psapi.h>
+    #pragma comment(lib, "psapi.lib")
+#else
+    #include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// globals
+static atomic<unsigned long long>   s_allocatedBytes(0);                // requested from operator new since start
+static const chrono::steady_clock::time_point s_start = chrono::steady_clock::now();
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Global allocation functions, counting the bytes requested.
+//
+///////////////////////////////////////////////////////////////////////////////
+void* operator new(size_t size)
+{
+    s_allocatedBytes.fetch_add(size, memory_order_relaxed);
+
+    void* pMemory = malloc(size ? size : 1);
+    if (!pMemory)
+        throw bad_alloc();
+
+    return pMemory;
+}// operator new
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}// operator new[]
+
+void operator delete(void* pMemory) noexcept
+{
+    free(pMemory);
+}// operator delete
+
+void operator delete[](void* pMemory) noexcept
+{
+    free(pMemory);
+}// operator delete[]
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+    free(pMemory);
+}// operator delete
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+    free(pMemory);
+}// operator delete[]
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Get the profiler shared by all script commands.
+//
+///////////////////////////////////////////////////////////////////////////////
+CProfiler& CProfiler::Instance()
+{
+    static CProfiler s_instance;
+    return s_instance;
+}// Instance
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Constructor.  Profiling starts disabled.
+//
+///////////////////////////////////////////////////////////////////////////////
+CProfiler::CProfiler() : m_bEnabled(false)
+{}// CProfiler
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Start recording commands.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CProfiler::Enable(const char* sTraceFilename)
+{
+    m_bEnabled = true;
+    m_sTraceFilename = sTraceFilename ? sTraceFilename : "";
+}// Enable
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Read the process counters.
+//
+///////////////////////////////////////////////////////////////////////////////
+CProfiler::SSnapshot CProfiler::Snapshot() const
+{
+    SSnapshot snapshot;
+    snapshot.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - s_start).count();
+    snapshot.allocatedBytes = s_allocatedBytes.load(memory_order_relaxed);
+
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    snapshot.cpuSeconds = ((((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+                           (((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime)) * 1e-7;
+
+    PROCESS_MEMORY_COUNTERS memory;
+    GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+    snapshot.peakResidentBytes = memory.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    snapshot.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                          (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+
+    #ifdef __APPLE__
+        snapshot.peakResidentBytes = usage.ru_maxrss;               // bytes on macOS
+    #else
+        snapshot.peakResidentBytes = usage.ru_maxrss * 1024ull;     // kilobytes elsewhere
+    #endif
+#endif
+
+    return snapshot;
+}// Snapshot
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Record a command that ran from start until now.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CProfiler::Record(const string& sCommand, const SSnapshot& start, double megapixels)
+{
+    if (!m_bEnabled)
+        return;
+
+    SSnapshot end = Snapshot();
+    SEvent event = { sCommand, start.wallSeconds, end.wallSeconds - start.wallSeconds,
+                     end.cpuSeconds - start.cpuSeconds, end.allocatedBytes - start.allocatedBytes, megapixels };
+    m_events.push_back(event);
+
+    size_t nameStart = sCommand.find_first_not_of(" \t\r\n");
+    string sName = nameStart == string::npos ? "" : sCommand.substr(nameStart, sCommand.find_first_of(" \t\r\n", nameStart) - nameStart);
+
+    STotals& totals = m_totals[sName];
+    totals.calls++;
+    totals.wallSeconds += event.wallSeconds;
+    totals.cpuSeconds += event.cpuSeconds;
+    totals.peakResidentGrowth += end.peakResidentBytes - start.peakResidentBytes;
+    totals.allocatedBytes += event.allocatedBytes;
+    totals.megapixels += megapixels;
+}// Record
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Print the command table and write the trace.
+//
+///////////////////////////////////////////////////////////////////////////////
+void CProfiler::Report()
+{
+    if (!m_bEnabled)
+        return;
+
+    vector<pair<string, STotals> > vRows(m_totals.begin(), m_totals.end());
+    sort(vRows.begin(), vRows.end(), [](const pair<string, STotals>& a, const pair<string, STotals>& b)
+    {
+        return a.second.wallSeconds > b.second.wallSeconds;
+    });
+
+    cout << endl << "Profile (times include nested scripts)" << endl
+         << left << setw(20) << "command" << right << setw(7) << "calls" << setw(12) << "wall ms" << setw(12) << "cpu ms"
+         << setw(14) << "peak rss +KB" << setw(14) << "allocated KB" << setw(11) << "megapixels" << endl;
+    for (size_t row = 0; row < vRows.size(); ++row)
+    {
+        const STotals& totals = vRows[row].second;
+        cout << left << setw(20) << vRows[row].first << right << setw(7) << totals.calls << fixed << setprecision(1)
+             << setw(12) << totals.wallSeconds * 1000 << setw(12) << totals.cpuSeconds * 1000
+             << setw(14) << totals.peakResidentGrowth / 1024 << setw(14) << totals.allocatedBytes / 1024
+             << setw(11) << setprecision(2) << totals.megapixels << endl;
+    }// for
+
+    if (m_sTraceFilename.empty())
+        return;
+
+    ofstream traceFile(m_sTraceFilename.c_str());
+    if (!traceFile)
+    {
+        cout << "Unable to write profile trace:  " << m_sTraceFilename << endl;
+        return;
+    }// if
+
+    // complete events on one thread; Chrome nests them by time
+    traceFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < m_events.size(); ++i)
+    {
+        const SEvent& event = m_events[i];
+        string sName;
+        for (size_t c = 0; c < event.sCommand.size(); ++c)
+        {
+            char character = event.sCommand[c];
+            if (character == '"' || character == '\\')
+                sName += '\\';
+            if ((unsigned char)character >= ' ')
+                sName += character;
+        }// for
+
+        traceFile << (i ? ",\n" : "\n") << fixed << setprecision(3)
+                  << "{\"name\":\"" << sName << "\",\"cat\":\"command\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+                  << ",\"ts\":" << event.startSeconds * 1e6 << ",\"dur\":" << event.wallSeconds * 1e6
+                  << ",\"args\":{\"cpu_ms\":" << event.cpuSeconds * 1000 << ",\"allocated_bytes\":" << event.allocatedBytes
+                  << ",\"megapixels\":" << event.megapixels << "}}";
+    }// for
+    traceFile << "\n]}" << endl;
+}// Report
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Profiler.h
+//
+//      Per command profiling for scripts.  When enabled with -profile, each
+//  script command records its wall time, CPU time, growth of the peak
+//  resident set, bytes allocated with new and the megapixels it worked on.
+//  A table sorted by wall time is printed at exit, and the commands can be
+//  written as a Chrome trace in which nested "run" scripts show as nested
+//  slices.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _C_PROFILER
+#define _C_PROFILER
+
+#include <map>
+#include <string>
+#include <vector>
+
+class CProfiler
+{
+    // methods
+    public:
+        struct SSnapshot                                    // process counters at one moment
+        {
+            double              wallSeconds;                // since the profiler was created
+            double              cpuSeconds;                 // user and system time of the process
+            unsigned long long  peakResidentBytes;          // largest resident set so far
+            unsigned long long  allocatedBytes;             // total requested from operator new so far
+        };
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Get the profiler shared by all script commands.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        static CProfiler& Instance();
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Start recording commands.  If sTraceFilename is not NULL a Chrome
+        //  trace is written to it by Report.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        void Enable(const char* sTraceFilename);
+
+        bool IsEnabled() const { return m_bEnabled; }
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Read the process counters.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        SSnapshot Snapshot() const;
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Record a command that ran from start until now over the given
+        //  number of megapixels.  Commands are grouped by their first word.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        void Record(const std::string& sCommand, const SSnapshot& start, double megapixels);
+
+        ///////////////////////////////////////////////////////////////////////////////
+        //
+        //      Print the table of commands sorted by total wall time and write the
+        //  trace file if one was requested.  Does nothing if not enabled.
+        //
+        ///////////////////////////////////////////////////////////////////////////////
+        void Report();
+
+    private:
+        CProfiler();
+
+    // members
+    private:
+        struct STotals                                      // sums over every call of one command
+        {
+            int                 calls;
+            double              wallSeconds;
+            double              cpuSeconds;
+            unsigned long long  peakResidentGrowth;
+            unsigned long long  allocatedBytes;
+            double              megapixels;
+        };
+
+        struct SEvent                                       // one command for the trace
+        {
+            std::string         sCommand;                   // the whole script line
+            double              startSeconds;
+            double              wallSeconds;
+            double              cpuSeconds;
+            unsigned long long  allocatedBytes;
+            double              megapixels;
+        };
+
+        bool                                m_bEnabled;         // record commands
+        std::string                         m_sTraceFilename;   // where Report writes the trace, empty for none
+        std::map<std::string, STotals>      m_totals;           // by command name
+        std::vector<SEvent>                 m_events;           // in order of completion
+};// CProfiler
+
+#endif // _C_PROFILER
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Random.h
+//
+//      Counter-based random numbers for stochastic image operations.  Each
+//  value is a pure function of (seed, index, stream): the Philox4x32-10
+//  block cipher encrypts the counter (index, stream) under the key seed.
+//  Pixels or strokes can therefore be processed in any order, on any
+//  number of threads, and still give bit-identical results for a seed.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+#include <stdint.h>
+
+// streams keep unrelated uses of the same seed and index independent
+enum ERandomStream
+{
+    RANDOM_DITHER,
+    RANDOM_STROKE,
+    NUM_RANDOM_STREAMS
+};// ERandomStream
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Run the ten Philox4x32 rounds on the counter in place.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void Philox4x32(uint32_t counter[4], uint32_t key0, uint32_t key1)
+{
+    for (int round = 0; round < 10; ++round)
+    {
+        uint64_t product0 = (uint64_t)0xD2511F53u * counter[0],
+                 product1 = (uint64_t)0xCD9E8D57u * counter[2];
+
+        uint32_t next[4] = { (uint32_t)(product1 >> 32) ^ counter[1] ^ key0, (uint32_t)product1,
+                             (uint32_t)(product0 >> 32) ^ counter[3] ^ key1, (uint32_t)product0 };
+
+        counter[0] = next[0];
+        counter[1] = next[1];
+        counter[2] = next[2];
+        counter[3] = next[3];
+
+        key0 += 0x9E3779B9u;
+        key1 += 0xBB67AE85u;
+    }// for
+}// Philox4x32
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return 32 random bits for the given seed, index and stream.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline uint32_t RandomBits(uint32_t seed, uint64_t index, ERandomStream stream = RANDOM_DITHER)
+{
+    uint32_t counter[4] = { (uint32_t)index, (uint32_t)(index >> 32), (uint32_t)stream, 0 };
+    Philox4x32(counter, seed, 0);
+    return counter[0];
+}// RandomBits
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return a random integer in [0, range) for the given seed, index and
+//  stream.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline int RandomInt(uint32_t seed, uint64_t index, int range, ERandomStream stream = RANDOM_DITHER)
+{
+    return (int)(((uint64_t)RandomBits(seed, index, stream) * (uint32_t)range) >> 32);
+}// RandomInt
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Return a random float in [0, 1) for the given seed, index and stream.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline float RandomFloat(uint32_t seed, uint64_t index, ERandomStream stream = RANDOM_DITHER)
+{
+    return (RandomBits(seed, index, stream) >> 8) * (1.0f / 16777216.0f);
+}// RandomFloat
+
+#endif // _RANDOM_H_
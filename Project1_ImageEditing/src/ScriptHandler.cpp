@@ -14,12 +14,22 @@
 #include <iostream>
 #include <fstream>
 #include <string.h>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
 #include "TargaImage.h"
+#include "Convolution.h"
+#include "ImageDecoder.h"
+#include "ImageIO.h"
+#include "Median.h"
+#include "Profiler.h"
 
 using namespace std;
 
 // constants
 const int       c_maxLineLength         = 1000;                         // maximum length of a command in a script
+const int       c_prefetchDepth         = 4;                            // script lines scanned ahead for loads to start early
 const char      c_sWhiteSpace[]         = " \t\n\r"; 
 const char      c_asCommands[][32]      = { "load",                     // valid commands
                                             "save",
@@ -40,6 +50,14 @@ const char      c_asCommands[][32]      = { "load",                     // valid
                                             "filter-gauss-n",
                                             "filter-edge",
                                             "filter-enhance",
+                                            "filter-median",
+                                            "filter-bilateral",
+                                            "filter-kernel",
+                                            "erode",
+                                            "dilate",
+                                            "open",
+                                            "close",
+                                            "distance",
                                             "npr-paint",
                                             "half",
                                             "double",
@@ -49,8 +67,12 @@ const char      c_asCommands[][32]      = { "load",                     // valid
                                             "comp-out",
                                             "comp-atop",
                                             "comp-xor",
+                                            "composite",
                                             "diff",
-                                            "rotate"
+                                            "rotate",
+                                            "flush",
+                                            "seed",
+                                            "backend"
                                           };
 
 enum ECommands          // command ids
@@ -74,6 +96,14 @@ enum ECommands          // command ids
     FILTER_GAUSS_N,
     FILTER_EDGE,
     FILTER_ENHANCE,
+    FILTER_MEDIAN,
+    FILTER_BILATERAL,
+    FILTER_KERNEL,
+    ERODE,
+    DILATE,
+    OPEN,
+    CLOSE,
+    DISTANCE,
     NPR_PAINT,
     HALF,
     DOUBLE,
@@ -83,12 +113,37 @@ enum ECommands          // command ids
     COMP_OUT,
     COMP_ATOP,
     COMP_XOR,
+    COMPOSITE,
     DIFF,
     ROTATE,
+    FLUSH,
+    SEED,
+    BACKEND,
     NUM_COMMANDS
 };// ECommands
 
 
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Read the optional preview reduction after a load filename, written as
+//  "1/2", "1/4" or "1/8".  A missing token means full size.  Returns false
+//  if the token is not a valid reduction.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool ParseReduction(const char* sToken, int& reduction)
+{
+    reduction = 1;
+    if (!sToken)
+        return true;
+
+    if (strncmp(sToken, "1/", 2))
+        return false;
+
+    reduction = atoi(sToken + 2);
+    return CImageDecoder::IsValidReduction(reduction);
+}// ParseReduction
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //      Execute the given command string on the given image.  If the command
@@ -112,7 +167,8 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
             break;
 
     // if there's no image only a subset of commands are valid
-    if (!pImage && command != LOAD && command != RUN && command != NUM_COMMANDS)
+    if (!pImage && command != LOAD && command != RUN && command != FLUSH && command != SEED &&
+        command != BACKEND && command != NUM_COMMANDS)
     {
         cout << "No image to operate on.  Use \"load\" command to load image." << endl;
         return false;
@@ -126,10 +182,18 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
     {
         case LOAD:
         {
+            char* sFilename = strtok(NULL, c_sWhiteSpace);
+            int reduction;
+            if (!ParseReduction(strtok(NULL, c_sWhiteSpace), reduction))
+            {
+                cout << "Preview size must be 1/2, 1/4 or 1/8." << endl;
+                bResult = bParsed = false;
+                break;
+            }// if
+
             if (pImage)
                 delete pImage;
-            char* sFilename = strtok(NULL, c_sWhiteSpace);
-            bResult = (pImage = TargaImage::Load_Image(sFilename)) != NULL;
+            bResult = (pImage = CImageIO::Instance().Load(sFilename, reduction)) != NULL;
 
             if (!bResult)
             {
@@ -150,13 +214,16 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
                 cout << "No filename given." << endl;
 
             bParsed = sFilename != NULL;
-            bResult =  bParsed && pImage->Save_Image(sFilename);
+            if (bParsed)
+                CImageIO::Instance().Save(*pImage, sFilename);
+            bResult = bParsed;
             break;
         }// SAVE
 
         case RUN:
         {
-            bResult = HandleScriptFile(strtok(NULL, c_sWhiteSpace), pImage);
+            // a nested script that failed, or whose saves failed, stops this one too
+            bResult = bParsed = HandleScriptFile(strtok(NULL, c_sWhiteSpace), pImage);
             break;
         }// RUN
 
@@ -208,6 +275,24 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
             break;
         }// DITHER_CLUSTER
         
+        case DITHER_PATTERN:
+        {
+            char *sSize = strtok(NULL, c_sWhiteSpace),
+                 *sMatrix = strtok(NULL, c_sWhiteSpace);
+            int size = sSize ? atoi(sSize) : 0;
+            EDitherMatrix matrix = !sMatrix || !strcmp(sMatrix, "bayer") ? MATRIX_BAYER :
+                                   !strcmp(sMatrix, "cluster") ? MATRIX_CLUSTER : NUM_DITHER_MATRICES;
+
+            if (!IsDitherSize(size) || matrix == NUM_DITHER_MATRICES)
+            {
+                cout << "Invalid dither pattern.  Give a size of 2, 4, 8 or 16, optionally followed by \"bayer\" or \"cluster\"." << endl;
+                bResult = bParsed = false;
+            }// if
+            else
+                bResult = pImage->Dither_Pattern(size, matrix);
+            break;
+        }// DITHER_PATTERN
+
         case DITHER_COLOR:
         {
             bResult = pImage->Dither_Color();
@@ -256,6 +341,91 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
             break;
         }// FILTER_ENHANCE
 
+        case FILTER_MEDIAN:
+        {
+            char *sRadius = strtok(NULL, c_sWhiteSpace);
+            int radius;
+
+            if (!sRadius || sscanf(sRadius, "%d", &radius) != 1 || radius < 0 || radius > c_maxMedianRadius)
+            {
+                cout << "Invalid median radius; it must be from 0 to " << c_maxMedianRadius << "." << endl;
+                bResult = bParsed = false;
+            }// if
+            else
+                bResult = pImage->Filter_Median(radius);
+            break;
+        }// FILTER_MEDIAN
+
+        case FILTER_BILATERAL:
+        {
+            char *sSigmaSpace = strtok(NULL, c_sWhiteSpace),
+                 *sSigmaRange = strtok(NULL, c_sWhiteSpace);
+            float sigmaSpace = sSigmaSpace ? (float)atof(sSigmaSpace) : 0,
+                  sigmaRange = sSigmaRange ? (float)atof(sSigmaRange) : 0;
+
+            if (sigmaSpace < 1 || sigmaRange < 1)
+            {
+                cout << "Invalid bilateral sigmas; both must be at least 1." << endl;
+                bResult = bParsed = false;
+            }// if
+            else if (!(bResult = pImage->Filter_Bilateral(sigmaSpace, sigmaRange)))
+                cout << "Bilateral grid too large; use larger sigmas." << endl;
+            break;
+        }// FILTER_BILATERAL
+
+        case FILTER_KERNEL:
+        {
+            char *sFileName = strtok(NULL, c_sWhiteSpace);
+            vector<float> vWeights;
+            int size;
+            float divide;
+
+            if (!sFileName || !ReadKernelFile(sFileName, vWeights, size, divide))
+            {
+                cout << "Unable to read kernel file " << (sFileName ? sFileName : "") << "." << endl;
+                bResult = bParsed = false;
+            }// if
+            else
+                bResult = pImage->Filter_Kernel(&vWeights[0], size, divide);
+            break;
+        }// FILTER_KERNEL
+
+        case ERODE:
+        case DILATE:
+        case OPEN:
+        case CLOSE:
+        {
+            // the element height defaults to its width
+            char *sWidth = strtok(NULL, c_sWhiteSpace),
+                 *sHeight = strtok(NULL, c_sWhiteSpace);
+            int elementWidth = sWidth ? atoi(sWidth) : 0,
+                elementHeight = sHeight ? atoi(sHeight) : elementWidth;
+
+            if (elementWidth < 1 || elementHeight < 1)
+            {
+                cout << "Invalid structuring element; give a width and optionally a height of at least 1." << endl;
+                bResult = bParsed = false;
+            }// if
+            else
+                bResult = pImage->Morphology((EMorphologyOp)(MORPH_ERODE + command - ERODE), elementWidth, elementHeight);
+            break;
+        }// ERODE, DILATE, OPEN, CLOSE
+
+        case DISTANCE:
+        {
+            char *sThreshold = strtok(NULL, c_sWhiteSpace);
+            int threshold = sThreshold ? atoi(sThreshold) : 128;
+
+            if (threshold < 0 || threshold > 255)
+            {
+                cout << "Invalid distance threshold; it must be from 0 to 255." << endl;
+                bResult = bParsed = false;
+            }// if
+            else if (!(bResult = pImage->Distance_Field(threshold)))
+                cout << "No pixels reach the distance threshold." << endl;
+            break;
+        }// DISTANCE
+
         case NPR_PAINT:
         {
             bResult = pImage->NPR_Paint();
@@ -293,7 +463,7 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
         case COMP_OVER:
         {
             char* sFilename = strtok(NULL, c_sWhiteSpace);
-            TargaImage* pNewImage = TargaImage::Load_Image(sFilename);
+            TargaImage* pNewImage = CImageIO::Instance().Load(sFilename);
             if (!pNewImage)
             {
                 if (sFilename)
@@ -310,7 +480,7 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
         case COMP_IN:
         {
             char* sFilename = strtok(NULL, c_sWhiteSpace);
-            TargaImage* pNewImage = TargaImage::Load_Image(sFilename);
+            TargaImage* pNewImage = CImageIO::Instance().Load(sFilename);
             if (!pNewImage)
             {
                 if (sFilename)
@@ -328,7 +498,7 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
         case COMP_OUT:
         {
             char* sFilename = strtok(NULL, c_sWhiteSpace);
-            TargaImage* pNewImage = TargaImage::Load_Image(sFilename);
+            TargaImage* pNewImage = CImageIO::Instance().Load(sFilename);
             if (!pNewImage)
             {
                 if (sFilename)
@@ -346,7 +516,7 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
         case COMP_ATOP:
         {
             char* sFilename = strtok(NULL, c_sWhiteSpace);
-            TargaImage* pNewImage = TargaImage::Load_Image(sFilename);
+            TargaImage* pNewImage = CImageIO::Instance().Load(sFilename);
             if (!pNewImage)
             {
                 if (sFilename)
@@ -364,7 +534,7 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
         case COMP_XOR:
         {
             char* sFilename = strtok(NULL, c_sWhiteSpace);
-            TargaImage* pNewImage = TargaImage::Load_Image(sFilename);
+            TargaImage* pNewImage = CImageIO::Instance().Load(sFilename);
             if (!pNewImage)
             {
                 if (sFilename)
@@ -379,10 +549,49 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
             break;
         }// COMP_XOR
 
+        case COMPOSITE:
+        {
+            // operators and layer filenames alternate
+            vector<ECompositeOp> vOps;
+            vector<TargaImage*> vpLayers;
+            char* sOp;
+
+            while (bParsed && (sOp = strtok(NULL, c_sWhiteSpace)) != NULL)
+            {
+                ECompositeOp op = CompositeOpFromName(sOp);
+                char* sFilename = strtok(NULL, c_sWhiteSpace);
+                TargaImage* pLayer = NULL;
+
+                if (op == NUM_COMPOSITE_OPS)
+                    cout << "Unknown compositing operator:  " << sOp << endl;
+                else if (!sFilename)
+                    cout << "No filename given." << endl;
+                else if (!(pLayer = CImageIO::Instance().Load(sFilename)))
+                    cout << "Unable to load image:  " << sFilename << endl;
+
+                bParsed = pLayer != NULL;
+                if (bParsed)
+                {
+                    vOps.push_back(op);
+                    vpLayers.push_back(pLayer);
+                }// if
+            }// while
+
+            if (bParsed && vOps.empty())
+            {
+                cout << "No layers given." << endl;
+                bParsed = false;
+            }// if
+
+            bResult = bParsed && pImage->Composite(&vOps[0], &vpLayers[0], (int)vOps.size());
+            for_each(vpLayers.begin(), vpLayers.end(), FDelete<TargaImage*>());
+            break;
+        }// COMPOSITE
+
         case DIFF:
         {
             char* sFilename = strtok(NULL, c_sWhiteSpace);
-            TargaImage* pNewImage = TargaImage::Load_Image(sFilename);
+            TargaImage* pNewImage = CImageIO::Instance().Load(sFilename);
             if (!pNewImage)
             {
                 if (sFilename)
@@ -414,6 +623,41 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
             break;
         }// ROTATE
 
+        case SEED:
+        {
+            char* sSeed = strtok(NULL, c_sWhiteSpace);
+            unsigned int seed;
+
+            bParsed = sSeed && sscanf(sSeed, "%u", &seed) == 1;
+            if (bParsed)
+                TargaImage::random_seed = seed;
+            else
+                cout << "Invalid random seed." << endl;
+
+            bResult = bParsed;
+            break;
+        }// SEED
+
+        case BACKEND:
+        {
+            char* sBackend = strtok(NULL, c_sWhiteSpace);
+
+            bParsed = sBackend && (!strcmp(sBackend, "fast") || !strcmp(sBackend, "reference"));
+            if (bParsed)
+                TargaImage::backend = !strcmp(sBackend, "fast") ? BACKEND_FAST : BACKEND_REFERENCE;
+            else
+                cout << "Invalid backend.  Give \"fast\" or \"reference\"." << endl;
+
+            bResult = bParsed;
+            break;
+        }// BACKEND
+
+        case FLUSH:
+        {
+            bResult = CImageIO::Instance().Flush();
+            break;
+        }// FLUSH
+
         default:
         {
             cout << "Unable to parse command:  " << sCommand << endl;
@@ -428,12 +672,84 @@ bool CScriptHandler::HandleCommand(const char* sCommand, TargaImage*& pImage)
 }// HandleCommand
 
 
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Start background loads for the images named by the next few script
+//  lines, beginning at the given line.  A file that is saved before it is
+//  loaded again is skipped since its contents aren't known yet, and the scan
+//  stops at a nested script because it may save anything.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void PrefetchAhead(const vector<string>& vsLines, size_t first)
+{
+    set<string> ssSaved;
+
+    for (size_t line = first; line < vsLines.size() && line < first + c_prefetchDepth; ++line)
+    {
+        vector<char> sCommandLine(vsLines[line].begin(), vsLines[line].end());
+        sCommandLine.push_back('\0');
+
+        char* sToken = strtok(&sCommandLine[0], c_sWhiteSpace);
+        if (!sToken)
+            continue;
+
+        int command;
+        for (command = 0; command < NUM_COMMANDS; ++command)
+            if (!strcmp(sToken, c_asCommands[command]))
+                break;
+
+        if (command == RUN)
+            break;
+
+        if (command == COMPOSITE)
+        {
+            // operators and layer filenames alternate
+            char* sLayer;
+            while (strtok(NULL, c_sWhiteSpace) && (sLayer = strtok(NULL, c_sWhiteSpace)) != NULL)
+                if (!ssSaved.count(sLayer))
+                    CImageIO::Instance().Prefetch(sLayer);
+            continue;
+        }// if
+
+        char* sFilename = strtok(NULL, c_sWhiteSpace);
+        if (!sFilename)
+            continue;
+
+        switch (command)
+        {
+            case SAVE:
+                ssSaved.insert(sFilename);
+                break;
+
+            case LOAD:
+            {
+                int reduction;
+                if (!ssSaved.count(sFilename) && ParseReduction(strtok(NULL, c_sWhiteSpace), reduction))
+                    CImageIO::Instance().Prefetch(sFilename, reduction);
+                break;
+            }// LOAD
+
+            case COMP_OVER:
+            case COMP_IN:
+            case COMP_OUT:
+            case COMP_ATOP:
+            case COMP_XOR:
+            case DIFF:
+                if (!ssSaved.count(sFilename))
+                    CImageIO::Instance().Prefetch(sFilename);
+                break;
+        }// switch
+    }// for
+}// PrefetchAhead
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //      The given script file is executed on the given image.  If the file is 
 //  not correctly parsed an error message is printed and false is returned.  
 //  If all commands in the script execute correctly true is returned,
-//  otherwise false is returned.
+//  otherwise false is returned.  Images the script loads are read ahead of
+//  the commands that use them.
 //
 ///////////////////////////////////////////////////////////////////////////////
 bool CScriptHandler::HandleScriptFile(const char* sFilename, TargaImage*& pImage)
@@ -452,19 +768,43 @@ bool CScriptHandler::HandleScriptFile(const char* sFilename, TargaImage*& pImage
         return false;
     }// if
 
-    bool bResult = true;
+    vector<string> vsLines;
     char sLine[c_maxLineLength + 1];
-    while (!inFile.eof() && bResult)
+    while (!inFile.eof())
     {
         inFile.getline(sLine, c_maxLineLength);
 
         if (!inFile.eof())
-            bResult = HandleCommand(sLine, pImage);
+            vsLines.push_back(sLine);
     }// while
 
     inFile.close();
-    return bResult;
-}// CScriptHandler
 
+    bool bResult = true;
+    PrefetchAhead(vsLines, 0);
+    CProfiler& profiler = CProfiler::Instance();
+    for (size_t line = 0; line < vsLines.size() && bResult; ++line)
+    {
+        // an image may be replaced or freed by the command, so count its pixels up front
+        bool bProfile = profiler.IsEnabled() && vsLines[line].find_first_not_of(c_sWhiteSpace) != string::npos;
+        CProfiler::SSnapshot start;
+        double megapixels = 0;
+        if (bProfile)
+        {
+            start = profiler.Snapshot();
+            megapixels = pImage ? pImage->width * (double)pImage->height / 1e6 : 0;
+        }// if
+
+        bResult = HandleCommand(vsLines[line].c_str(), pImage);
 
+        if (bProfile)
+            profiler.Record(vsLines[line], start, Max(megapixels, pImage ? pImage->width * (double)pImage->height / 1e6 : 0));
+        PrefetchAhead(vsLines, line + 1);
+    }// for
 
+    // a script whose saves didn't all reach the disk failed
+    if (!CImageIO::Instance().Flush())
+        bResult = false;
+
+    return bResult;
+}// CScriptHandler
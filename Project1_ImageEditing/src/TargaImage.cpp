@@ -11,6 +11,15 @@
 
 #include "Globals.h"
 #include "TargaImage.h"
+#include "Bilateral.h"
+#include "Convolution.h"
+#include "Dither.h"
+#include "DistanceImage.h"
+#include "ImageDecoder.h"
+#include "ImageFormat.h"
+#include "Median.h"
+#include "Morphology.h"
+#include "Random.h"
 #include "libtarga.h"
 #include <stdlib.h>
 #include <assert.h>
@@ -29,6 +38,12 @@ const int           GREEN           = 1;                // green channel
 const int           BLUE            = 2;                // blue channel
 const unsigned char BACKGROUND[3]   = { 0, 0, 0 };      // background color
 
+// key for stochastic operations, changed with the "seed" script command
+unsigned int TargaImage::random_seed = 0;
+
+// implementation of the operations, changed with the "backend" script command
+EImageBackend TargaImage::backend = BACKEND_FAST;
+
 
 // Computes n choose s, efficiently
 double Binomial(int n, int s)
@@ -48,7 +63,7 @@ double Binomial(int n, int s)
 //      Constructor.  Initialize member variables.
 //
 ///////////////////////////////////////////////////////////////////////////////
-TargaImage::TargaImage() : width(0), height(0), data(NULL)
+TargaImage::TargaImage() : width(0), height(0), data(NULL), mapping(NULL)
 {}// TargaImage
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -56,7 +71,7 @@ TargaImage::TargaImage() : width(0), height(0), data(NULL)
 //      Constructor.  Initialize member variables.
 //
 ///////////////////////////////////////////////////////////////////////////////
-TargaImage::TargaImage(int w, int h) : width(w), height(h)
+TargaImage::TargaImage(int w, int h) : width(w), height(h), mapping(NULL)
 {
    data = new unsigned char[width * height * 4];
    ClearToBlack();
@@ -69,7 +84,7 @@ TargaImage::TargaImage(int w, int h) : width(w), height(h)
 //      Constructor.  Initialize member variables to values given.
 //
 ///////////////////////////////////////////////////////////////////////////////
-TargaImage::TargaImage(int w, int h, unsigned char *d)
+TargaImage::TargaImage(int w, int h, unsigned char *d) : mapping(NULL)
 {
     int i;
 
@@ -86,7 +101,7 @@ TargaImage::TargaImage(int w, int h, unsigned char *d)
 //      Copy Constructor.  Initialize member to that of input
 //
 ///////////////////////////////////////////////////////////////////////////////
-TargaImage::TargaImage(const TargaImage& image) 
+TargaImage::TargaImage(const TargaImage& image) : mapping(NULL)
 {
    width = image.width;
    height = image.height;
@@ -105,11 +120,28 @@ TargaImage::TargaImage(const TargaImage& image)
 ///////////////////////////////////////////////////////////////////////////////
 TargaImage::~TargaImage()
 {
-    if (data)
-        delete[] data;
+    Release_Data();
 }// ~TargaImage
 
 
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Free the pixel data.  Images loaded from native format files may point
+//  into a file mapping instead of memory from new[].
+//
+///////////////////////////////////////////////////////////////////////////////
+void TargaImage::Release_Data()
+{
+    if (mapping)
+        CImageFormat::ReleaseMapping(mapping);
+    else if (data)
+        delete[] data;
+
+    data = NULL;
+    mapping = NULL;
+}// Release_Data
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //      Converts an image to RGB form, and returns the rgb pixel data - 24 
@@ -148,6 +180,9 @@ unsigned char* TargaImage::To_RGB(void)
 ///////////////////////////////////////////////////////////////////////////////
 bool TargaImage::Save_Image(const char *filename)
 {
+    if (CImageFormat::IsNativeFile(filename))
+        return CImageFormat::Save(*this, filename);
+
     TargaImage	*out_image = Reverse_Rows();
 
     if (! out_image)
@@ -167,11 +202,13 @@ bool TargaImage::Save_Image(const char *filename)
 
 ///////////////////////////////////////////////////////////////////////////////
 //
-//      Load a targa image from a file.  Return a new TargaImage object which 
-//  must be deleted by caller.  Return NULL on failure.
+//      Load a targa, native, PNG or JPEG image from a file, averaging each
+//  reduction by reduction block of pixels into one for previews.  Return a
+//  new TargaImage object which must be deleted by caller.  Return NULL on
+//  failure.
 //
 ///////////////////////////////////////////////////////////////////////////////
-TargaImage* TargaImage::Load_Image(char *filename)
+TargaImage* TargaImage::Load_Image(char *filename, int reduction)
 {
     unsigned char   *temp_data;
     TargaImage	    *temp_image;
@@ -184,19 +221,40 @@ TargaImage* TargaImage::Load_Image(char *filename)
         return NULL;
     }// if
 
-    temp_data = (unsigned char*)tga_load(filename, &width, &height, TGA_TRUECOLOR_32);
-    if (!temp_data)
+    if (!CImageDecoder::IsValidReduction(reduction))
     {
-        cout << "TGA Error: %s\n", tga_error_string(tga_get_last_error());
-	    width = height = 0;
-	    return NULL;
-    }
-    temp_image = new TargaImage(width, height, temp_data);
-    free(temp_data);
+        cout << "Reduction must be 1, 2, 4 or 8." << endl;
+        return NULL;
+    }// if
+
+    if (CImageDecoder::IsDecodedFile(filename))
+        return CImageDecoder::Load(filename, reduction);
+
+    if (CImageFormat::IsNativeFile(filename))
+        result = CImageFormat::Load(filename);
+    else
+    {
+        temp_data = (unsigned char*)tga_load(filename, &width, &height, TGA_TRUECOLOR_32);
+        if (!temp_data)
+        {
+            cout << "TGA Error: %s\n", tga_error_string(tga_get_last_error());
+            width = height = 0;
+            return NULL;
+        }
+        temp_image = new TargaImage(width, height, temp_data);
+        free(temp_data);
+
+        result = temp_image->Reverse_Rows();
 
-    result = temp_image->Reverse_Rows();
+        delete temp_image;
+    }// else
 
-    delete temp_image;
+    if (result && reduction > 1)
+    {
+        temp_image = result;
+        result = CImageDecoder::Reduce(*temp_image, reduction);
+        delete temp_image;
+    }// if
 
     return result;
 }// Load_Image
@@ -334,14 +392,14 @@ bool TargaImage::Dither_Random()
     //cout << "sum: " << sum << endl;
     //cout << "thresh: " << thresh/256 << endl;
 
-    // 
-    for (int h = 0; h < height; h++) {
+    // noise depends only on the seed and the pixel index, so rows can go in any order
+    auto ditherRow = [&](int h) {
         int offset = h * width * 4;     //length of one row
 
         for (int w = 0; w < width; w++) {
-            float random = (float)(-2 + rand() % 5) / 10.0;
+            float random = (float)(-2 + RandomInt(random_seed, (uint64_t)h * width + w, 5)) / 10.0;
 
-            intensity = 0.299 * data[offset + w * 4] + 0.587 * data[offset + w * 4 + 1] + 0.114 * data[offset + w * 4 + 2];
+            float intensity = 0.299 * data[offset + w * 4] + 0.587 * data[offset + w * 4 + 1] + 0.114 * data[offset + w * 4 + 2];
             intensity /= 256.0;
             intensity += random;
 
@@ -351,7 +409,13 @@ bool TargaImage::Dither_Random()
                 data[offset + w * 4] = data[offset + w * 4 + 1] = data[offset + w * 4 + 2] = 0;
 
         }
-    }
+    };
+
+    if (backend == BACKEND_REFERENCE)
+        for (int h = 0; h < height; h++)
+            ditherRow(h);
+    else
+        ParallelFor(0, height, ditherRow);
 
 
     return true;
@@ -446,30 +510,28 @@ bool TargaImage::Dither_Bright()
 ///////////////////////////////////////////////////////////////////////////////
 bool TargaImage::Dither_Cluster()
 {
-    float mask[4][4] = {
-        {0.7059, 0.3529, 0.5882, 0.2353},
-        {0.0588, 0.9412, 0.8235, 0.4118},
-        {0.4706, 0.7647, 0.8824, 0.1176},
-        {0.1765, 0.5294, 0.2941, 0.6471}
-    };
-
-    for (int h = 0; h < height; h++) {
-        int offset = h * width * 4;     //length of one row
+    if (backend == BACKEND_REFERENCE)
+        DitherClusterRef(data, width, height);
+    else
+        DitherCluster(data, width, height);
 
-        for (int w = 0; w < width; w++) {
+    return true;
+}// Dither_Cluster
 
-            if ((float)(data[offset + w * 4] + data[offset + w * 4 + 1] + data[offset + w * 4 + 2]) / 3 / 256.0 >= mask[h % 4][w % 4])
-                data[offset + w * 4] = data[offset + w * 4 + 1] = data[offset + w * 4 + 2] = 255;
-            else
-                data[offset + w * 4] = data[offset + w * 4 + 1] = data[offset + w * 4 + 2] = 0;
-        }
-    }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Perform ordered dithering with a threshold matrix of the given size.
+//  Return success of operation.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool TargaImage::Dither_Pattern(int size, EDitherMatrix matrix)
+{
+    if (backend == BACKEND_REFERENCE)
+        return DitherOrderedRef(data, width, height, size, matrix);
 
-    return true;
-    //ClearToBlack();
-    //return false;
-}// Dither_Cluster
+    return DitherOrdered(data, width, height, size, matrix);
+}// Dither_Pattern
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -500,8 +562,8 @@ bool TargaImage::Comp_Over(TargaImage* pImage)
         return false;
     }
 
-    ClearToBlack();
-    return false;
+    ECompositeOp op = COMPOSITE_OVER;
+    return Composite(&op, &pImage, 1);
 }// Comp_Over
 
 
@@ -519,8 +581,8 @@ bool TargaImage::Comp_In(TargaImage* pImage)
         return false;
     }
 
-    ClearToBlack();
-    return false;
+    ECompositeOp op = COMPOSITE_IN;
+    return Composite(&op, &pImage, 1);
 }// Comp_In
 
 
@@ -538,8 +600,8 @@ bool TargaImage::Comp_Out(TargaImage* pImage)
         return false;
     }
 
-    ClearToBlack();
-    return false;
+    ECompositeOp op = COMPOSITE_OUT;
+    return Composite(&op, &pImage, 1);
 }// Comp_Out
 
 
@@ -557,8 +619,8 @@ bool TargaImage::Comp_Atop(TargaImage* pImage)
         return false;
     }
 
-    ClearToBlack();
-    return false;
+    ECompositeOp op = COMPOSITE_ATOP;
+    return Composite(&op, &pImage, 1);
 }// Comp_Atop
 
 
@@ -576,11 +638,45 @@ bool TargaImage::Comp_Xor(TargaImage* pImage)
         return false;
     }
 
-    ClearToBlack();
-    return false;
+    ECompositeOp op = COMPOSITE_XOR;
+    return Composite(&op, &pImage, 1);
 }// Comp_Xor
 
 
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Composite a stack of layers onto this image in a single pass: the
+//  image becomes ((this op[0] layer[0]) op[1] layer[1]) ... .  All layers
+//  must be the size of this image.  Return success of operation.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool TargaImage::Composite(const ECompositeOp* aOps, TargaImage* const* apLayers, int layerCount)
+{
+    vector<const unsigned char*> vpLayerData(layerCount);
+
+    for (int layer = 0; layer < layerCount; ++layer)
+    {
+        if (!apLayers[layer] || aOps[layer] < 0 || aOps[layer] >= NUM_COMPOSITE_OPS)
+            return false;
+
+        if (width != apLayers[layer]->width || height != apLayers[layer]->height)
+        {
+            cout << "Composite: Images not the same size\n";
+            return false;
+        }// if
+
+        vpLayerData[layer] = apLayers[layer]->data;
+    }// for
+
+    if (layerCount && backend == BACKEND_REFERENCE)
+        CompositeLayersRef(data, width * height, aOps, &vpLayerData[0], layerCount);
+    else if (layerCount)
+        CompositeLayers(data, width * height, aOps, &vpLayerData[0], layerCount);
+
+    return true;
+}// Composite
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //      Calculate the difference bewteen this imag and the given one.  Image 
@@ -658,6 +754,9 @@ float TargaImage::findKernelValue(float* kernel, int x, int y, int kernel_width,
         if (kernel[pattern[i]] != 9999.0)
             return kernel[pattern[i]];
     }
+
+    // images smaller than the kernel can have no mirrored tap inside them
+    return 0;
 }
 
 float TargaImage::filter_pixel(float* filter_matrix, float divide, int kernel_width, int kernel_height, int w, int h, int channel) {
@@ -720,6 +819,7 @@ float TargaImage::filter_pixel(float* filter_matrix, float divide, int kernel_wi
         }
     }
 
+    delete[] kernel;
     return sum / divide;
 }
 
@@ -729,10 +829,19 @@ void TargaImage::filter(float* filter_matrix, float divide, int kernel_size) {
 
     int min = -(kernel_size - 1) / 2;
     int max = kernel_size / 2;
+
+    // integral kernels filter the interior in fixed point, leaving the border
+    SIntegerKernel integer_kernel;
+    bool integral = backend == BACKEND_FAST &&
+                    MakeIntegerKernel(filter_matrix, divide, kernel_size, kernel_size, integer_kernel);
+    if (integral)
+        ConvolveInterior(data, newdata, width, height, integer_kernel);
     
     // iterate pixels of image
     for (int h = 0; h < height; h++) {
         for (int w = 0; w < width; w++) {
+            if (integral && IsInteriorPixel(w, h, width, height, kernel_size, kernel_size))
+                continue;
 
             // itertate RGB channel
             for (int i = 0; i < 3; i++) {
@@ -861,6 +970,88 @@ bool TargaImage::Filter_Enhance()
 }// Filter_Enhance
 
 
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Replace each channel of each pixel with its median over the square of
+//  the given radius.  Return success of operation.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool TargaImage::Filter_Median(int radius)
+{
+    vector<unsigned char> source(data, data + width * height * 4);
+    if (backend == BACKEND_REFERENCE)
+        return MedianFilterRef(&source[0], data, width, height, radius);
+
+    return MedianFilter(&source[0], data, width, height, radius);
+}// Filter_Median
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Smooth the image while keeping edges, using a bilateral filter with
+//  the given spatial (pixels) and range (grey levels) standard deviations.
+//  Return success of operation.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool TargaImage::Filter_Bilateral(float sigmaSpace, float sigmaRange)
+{
+    if (backend == BACKEND_REFERENCE)
+        return BilateralFilterRef(data, width, height, sigmaSpace, sigmaRange);
+
+    return BilateralFilter(data, width, height, sigmaSpace, sigmaRange);
+}// Filter_Bilateral
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Filter the image with a square kernel of any size, repeating edge
+//  pixels outside the image.  Return success of operation.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool TargaImage::Filter_Kernel(const float* pKernel, int size, float divide)
+{
+    if (!pKernel || size < 1 || !divide)
+        return false;
+
+    vector<unsigned char> source(data, data + width * height * 4);
+    if (backend == BACKEND_REFERENCE)
+        ConvolveKernelRef(&source[0], data, width, height, pKernel, size, divide);
+    else
+        ConvolveKernel(&source[0], data, width, height, pKernel, size, divide);
+    return true;
+}// Filter_Kernel
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Erode, dilate, open or close the image with a rectangular structuring
+//  element of the given size.  Return success of operation.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool TargaImage::Morphology(EMorphologyOp op, int elementWidth, int elementHeight)
+{
+    if (backend == BACKEND_REFERENCE)
+        return MorphologyRef(data, width, height, op, elementWidth, elementHeight);
+
+    return ::Morphology(data, width, height, op, elementWidth, elementHeight);
+}// Morphology
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//      Replace the image with its distance field: the distance from each
+//  pixel to the nearest pixel whose average intensity is at least the
+//  threshold, scaled so the farthest pixel is white.  Return success of
+//  operation.
+//
+///////////////////////////////////////////////////////////////////////////////
+bool TargaImage::Distance_Field(int threshold)
+{
+    DistanceImage distances(*this, threshold);
+    return distances.To_Image(*this);
+}// Distance_Field
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //      Run simplified version of Hertzmann's painterly image filter.
@@ -894,8 +1085,16 @@ bool TargaImage::Half_Size()
     unsigned char* newdata = new unsigned char[(height / 2) * (width / 2) * 4];
     //memset(newdata, 0, (height / 2) * (width / 2) * 4);
 
+    // filter the kept interior pixels in fixed point first
+    SIntegerKernel integer_kernel;
+    bool integral = backend == BACKEND_FAST && MakeIntegerKernel(filter_matrix, 16, 3, 3, integer_kernel);
+    if (integral)
+        ConvolveInteriorHalf(data, newdata, width, height, integer_kernel);
+
     for (int h = 0; h < height / 2; h++) {
         for (int w = 0; w < width / 2; w++) {
+            if (integral && IsInteriorPixel(w * 2, h * 2, width, height, 3, 3))
+                continue;
 
             //rgb channel
             for (int i = 0; i < 4; i++) {
@@ -931,8 +1130,51 @@ bool TargaImage::Double_Size()
 {
     unsigned char* newdata = new unsigned char[height * 2 * width * 2 * 4];
 
+    // interpolation kernels, indexed by (newH % 2) * 2 + newW % 2
+    float filter_even[9] = {
+        1, 2, 1,
+        2, 4, 2,
+        1 ,2, 1
+    };
+    float filter_odd[16] = {
+        1, 3, 3, 1,
+        3, 9, 9, 3,
+        3, 9, 9, 3,
+        1, 3, 3, 1
+    };
+    float filter_odd_row[12] = {
+        1, 2, 1,
+        3, 6, 3,
+        3, 6, 3,
+        1, 2, 1
+    };
+    float filter_odd_col[12] = {
+        1, 3, 3, 1,
+        2, 6, 6, 2,
+        1, 3, 3, 1
+    };
+    float* filter_matrix[4] = { filter_even, filter_odd_col, filter_odd_row, filter_odd };
+    int kernel_width[4] = { 3, 4, 3, 4 };
+    int kernel_height[4] = { 3, 3, 4, 4 };
+    float divide[4] = { 16, 32, 32, 64 };
+
+    // filter the interior of the original with each kernel in fixed point first
+    vector<unsigned char> filtered[4];
+    bool integral[4];
+    for (int k = 0; k < 4; k++) {
+        SIntegerKernel integer_kernel;
+        integral[k] = backend == BACKEND_FAST &&
+                      MakeIntegerKernel(filter_matrix[k], divide[k], kernel_width[k], kernel_height[k], integer_kernel);
+        if (integral[k]) {
+            filtered[k].assign(data, data + width * height * 4);
+            ConvolveInterior(data, &filtered[k][0], width, height, integer_kernel);
+        }
+    }
+
     for (int newH = 0; newH < height * 2; newH++) {
         for (int newW = 0; newW < width * 2; newW++) {
+            int k = (newH % 2) * 2 + newW % 2;
+            bool interior = integral[k] && IsInteriorPixel(newW / 2, newH / 2, width, height, kernel_width[k], kernel_height[k]);
 
             // RGBA channel
             for (int i = 0; i < 4; i++) {
@@ -948,49 +1190,15 @@ bool TargaImage::Double_Size()
                 }
 
                 // RGB
-                if (newH % 2 == 0 && newW % 2 == 0) {
-                    float filter_matrix[9] = {
-                        1, 2, 1,
-                        2, 4, 2,
-                        1 ,2, 1
-                    };
-
-                    newdata[newRow + newCol] = filter_pixel(filter_matrix, 16, 3, 3, newW / 2, newH / 2, i);
-                }
-                else if (newH % 2 == 1 && newW % 2 == 1) {
-                    float filter_matrix[16] = {
-                        1, 3, 3, 1,
-                        3, 9, 9, 3,
-                        3, 9, 9, 3,
-                        1, 3, 3, 1
-                    };
-
-                    newdata[newRow + newCol] = filter_pixel(filter_matrix, 64, 4, 4, newW / 2, newH / 2, i);
-                }
-                else if (newH % 2 == 1 && newW % 2 == 0) {
-                    float filter_matrix[12] = {
-                        1, 2, 1,
-                        3, 6, 3,
-                        3, 6, 3,
-                        1, 2, 1
-                    };
-
-                    newdata[newRow + newCol] = filter_pixel(filter_matrix, 32, 3, 4, newW / 2, newH / 2, i);
-                }
-                else {
-                    float filter_matrix[12] = {
-                        1, 3, 3, 1,
-                        2, 6, 6, 2,
-                        1, 3, 3, 1
-                    };
-
-                    newdata[newRow + newCol] = filter_pixel(filter_matrix, 32, 4, 3, newW / 2, newH / 2, i);
-                }
+                if (interior)
+                    newdata[newRow + newCol] = filtered[k][row + col];
+                else
+                    newdata[newRow + newCol] = filter_pixel(filter_matrix[k], divide[k], kernel_width[k], kernel_height[k], newW / 2, newH / 2, i);
             }
         }
     }
 
-    delete data;
+    Release_Data();
     data = newdata;
     height *= 2;
     width *= 2;
@@ -1056,7 +1264,7 @@ bool TargaImage::Rotate(float angleDegrees)
         }
     }
 
-    delete[] data;
+    Release_Data();
     data = newdata;
 
     return true;
@@ -15,9 +15,20 @@
 #include <Fl/Fl.h>
 #include <Fl/Fl_Widget.h>
 #include <stdio.h>
+#include "Composite.h"
+#include "Dither.h"
+#include "Morphology.h"
 
 class Stroke;
 class DistanceImage;
+struct SImageMapping;
+
+enum EImageBackend      // which implementation of the operations to run
+{
+    BACKEND_FAST,       // SIMD, threaded and fixed point paths
+    BACKEND_REFERENCE,  // plain scalar code on one thread, that the fast paths are checked against
+    NUM_IMAGE_BACKENDS
+};// EImageBackend
 
 class TargaImage
 {
@@ -31,7 +42,7 @@ class TargaImage
 
         unsigned char*	To_RGB(void);	            // Convert the image to RGB format,
         bool Save_Image(const char*);               // save the image to a file
-        static TargaImage* Load_Image(char*);       // Load a file and return a pointer to a new TargaImage object.  Returns NULL on failure
+        static TargaImage* Load_Image(char*, int reduction = 1);    // Load a file, shrunk by 1, 2, 4 or 8, and return a pointer to a new TargaImage object.  Returns NULL on failure
 
         bool To_Grayscale();
 
@@ -44,6 +55,7 @@ class TargaImage
         bool Dither_FS();
         bool Dither_Bright();
         bool Dither_Cluster();
+        bool Dither_Pattern(int size, EDitherMatrix matrix = MATRIX_BAYER);
         bool Dither_Color();
 
         bool Comp_Over(TargaImage* pImage);
@@ -51,6 +63,7 @@ class TargaImage
         bool Comp_Out(TargaImage* pImage);
         bool Comp_Atop(TargaImage* pImage);
         bool Comp_Xor(TargaImage* pImage);
+        bool Composite(const ECompositeOp* aOps, TargaImage* const* apLayers, int layerCount);
 
         bool Difference(TargaImage* pImage);
 
@@ -60,6 +73,12 @@ class TargaImage
         bool Filter_Gaussian_N(unsigned int N);
         bool Filter_Edge();
         bool Filter_Enhance();
+        bool Filter_Median(int radius);
+        bool Filter_Bilateral(float sigmaSpace, float sigmaRange);
+        bool Filter_Kernel(const float* pKernel, int size, float divide);
+
+        bool Morphology(EMorphologyOp op, int elementWidth, int elementHeight);
+        bool Distance_Field(int threshold = 128);
 
         bool NPR_Paint();
 
@@ -69,6 +88,9 @@ class TargaImage
         bool Rotate(float angleDegrees);
 
     private:
+    // free the pixel data, whether allocated or mapped from a file
+        void Release_Data();
+
 	// helper function for format conversion
         void RGBA_To_RGB(unsigned char *rgba, unsigned char *rgb);
 
@@ -96,6 +118,10 @@ class TargaImage
         int		width;	    // width of the image in pixels
         int		height;	    // height of the image in pixels
         unsigned char	*data;	    // pixel data for the image, assumed to be in pre-multiplied RGBA format.
+        SImageMapping   *mapping;   // file view holding data, or NULL if data was allocated with new[]
+
+        static unsigned int random_seed;    // key for the random numbers used by stochastic operations
+        static EImageBackend backend;       // implementation used by operations with a fast path
 
 };
 
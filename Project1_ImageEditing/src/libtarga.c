@@ -3,8 +3,18 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <malloc.h>
 
+/* system headers go before libtarga.h, which redefines 'byte' */
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 #include "libtarga.h"
 
 
@@ -69,6 +79,35 @@ static void tga_write_pixel_to_mem( ubyte * dat, ubyte img_spec, uint32 number,
                                    uint32 w, uint32 h, uint32 pixel, uint32 format );
 
 
+/* RLE writer internals */
+
+#define RLE_MAX_THREADS     (16)
+#define RLE_GROUP_BYTES     (1 << 22)   /* rough encoded size of one row group */
+
+typedef struct {
+    const ubyte * dat;      /* the whole image */
+    int width;
+    int height;
+    unsigned int format;
+    int first_row;          /* rows [first_row, end_row) are encoded */
+    int end_row;
+    uint32 * px;            /* one converted row */
+    ubyte * out;            /* encoded packets */
+    size_t used;
+} tga_rle_group;
+
+static void tga_rle_init_tables( void );
+static uint32 tga_rle_pixel( const ubyte * src, unsigned int format );
+static ubyte * tga_rle_put( ubyte * out, uint32 pixel, unsigned int format );
+static void tga_rle_encode_group( tga_rle_group * group );
+static ubyte * tga_rle_encode_row( const uint32 * px, int width, int last, uint32 before, 
+                                   unsigned int format, ubyte * out );
+static int tga_rle_run_end( const uint32 * px, int from, int end, uint32 val );
+static int tga_rle_raw_end( const uint32 * px, int from, int end );
+static int tga_cpu_count( void );
+static void tga_run_groups( tga_rle_group * groups, int count );
+
+
 /* returns the last error encountered */
 int tga_get_last_error() {
     return( TargaError );
@@ -611,10 +650,172 @@ int tga_write_raw( const char * file, int width, int height, unsigned char * dat
 
 
 
+/*
+    Run-length encoded writer.  Rows are converted and packed into memory
+    by several threads at once and the packets are written out in large
+    blocks.  The output matches tga_write_rle_ref byte for byte, including
+    the way it finishes off the last row.
+*/
 int tga_write_rle( const char * file, int width, int height, unsigned char * dat, unsigned int format ) {
 
     FILE * tga;
 
+    tga_rle_group groups[RLE_MAX_THREADS];
+    int threads, rows_per_group, row, count, i;
+    size_t row_bytes;
+
+    char id[] = "written with libtarga";
+    ubyte idlen = 21;
+    ubyte zeroes[5] = { 0, 0, 0, 0, 0 };
+    ubyte cmap_type = 0;
+    ubyte img_type  = 10;  // 2 - uncompressed truecolor  10 - RLE truecolor
+    uint16 xorigin  = 0;
+    uint16 yorigin  = 0;
+    uint16 shortwidth = (uint16)width;
+    uint16 shortheight = (uint16)height;
+    ubyte  pixdepth = format * 8;  // bpp
+    ubyte img_desc  = format == TGA_TRUECOLOR_32 ? 8 : 0;
+
+
+    switch( format ) {
+    case TGA_TRUECOLOR_24:
+    case TGA_TRUECOLOR_32:
+        break;
+
+    default:
+        TargaError = TGA_ERR_BAD_FORMAT;
+        return( 0 );
+    }
+
+    if( width <= 0 || height <= 0 ) {
+        width = 0;
+        height = 0;
+    }
+
+    if( format == TGA_TRUECOLOR_32 ) {
+        tga_rle_init_tables();
+    }
+
+    // a row never packs to more than a header byte per pixel plus the
+    // extra pixel the reference encoder writes at the very end.
+    row_bytes = (size_t)width * (format + 1) + 2 * format + 2;
+
+    rows_per_group = (int)(RLE_GROUP_BYTES / row_bytes);
+    if( rows_per_group < 1 ) {
+        rows_per_group = 1;
+    }
+
+    threads = tga_cpu_count();
+    if( threads > RLE_MAX_THREADS ) {
+        threads = RLE_MAX_THREADS;
+    }
+    if( threads > (height + rows_per_group - 1) / rows_per_group ) {
+        threads = (height + rows_per_group - 1) / rows_per_group;
+    }
+    if( threads < 1 ) {
+        threads = 1;
+    }
+    if( rows_per_group > height ) {
+        rows_per_group = height > 0 ? height : 1;
+    }
+
+    // one buffer per group, reused for every batch of rows.
+    memset( groups, 0, sizeof( groups ) );
+    for( i = 0; i < threads; i++ ) {
+        groups[i].dat = dat;
+        groups[i].width = width;
+        groups[i].height = height;
+        groups[i].format = format;
+        groups[i].px = (uint32 *)malloc( (width > 0 ? width : 1) * sizeof( uint32 ) );
+        groups[i].out = (ubyte *)malloc( rows_per_group * row_bytes );
+
+        if( groups[i].px == NULL || groups[i].out == NULL ) {
+            // not enough memory to buffer rows, do it a pixel at a time.
+            for( ; i >= 0; i-- ) {
+                free( groups[i].px );
+                free( groups[i].out );
+            }
+            return( tga_write_rle_ref( file, width, height, dat, format ) );
+        }
+    }
+
+
+    tga = fopen( file, "wb" );
+
+    if( tga == NULL ) {
+        for( i = 0; i < threads; i++ ) {
+            free( groups[i].px );
+            free( groups[i].out );
+        }
+        TargaError = TGA_ERR_OPEN_FAILS;
+        return( 0 );
+    }
+
+    // write id length
+    fwrite( &idlen, 1, 1, tga );
+
+    // write colormap type
+    fwrite( &cmap_type, 1, 1, tga );
+
+    // write image type
+    fwrite( &img_type, 1, 1, tga );
+
+    // write cmap spec.
+    fwrite( &zeroes, 5, 1, tga );
+
+    // write image spec.
+    fwrite( &xorigin, 2, 1, tga );
+    fwrite( &yorigin, 2, 1, tga );
+    fwrite( &shortwidth, 2, 1, tga );
+    fwrite( &shortheight, 2, 1, tga );
+    fwrite( &pixdepth, 1, 1, tga );
+    fwrite( &img_desc, 1, 1, tga );
+
+
+    // write image id.
+    fwrite( &id, idlen, 1, tga );
+
+    // packets never span rows, so groups of rows encode independently and
+    // are written back in order.
+    for( row = 0; row < height; ) {
+
+        for( count = 0; count < threads && row < height; count++ ) {
+            groups[count].first_row = row;
+            row = row + rows_per_group < height ? row + rows_per_group : height;
+            groups[count].end_row = row;
+        }
+
+        tga_run_groups( groups, count );
+
+        for( i = 0; i < count; i++ ) {
+            fwrite( groups[i].out, 1, groups[i].used, tga );
+        }
+    }
+
+
+    // close the file.
+    fclose( tga );
+
+    for( i = 0; i < threads; i++ ) {
+        free( groups[i].px );
+        free( groups[i].out );
+    }
+
+    return( 1 );
+
+}
+
+
+
+
+/*
+    The original run-length encoder, one pixel and one fwrite at a time.
+    Kept as the reference that tga_write_rle is checked against.
+*/
+int tga_write_rle_ref( const char * file, int width, int height, unsigned char * dat, unsigned int format ) {
+
+    FILE * tga;
+
     uint32 i, j;
     uint32 oc, nc;
 
@@ -1196,3 +1397,299 @@ static int32 htotl( int32 val ) {
 
 }
 
+
+
+/*************************************************************************************************/
+
+
+
+/* alpha un-premultiply tables, built from the same float math as tga_write_raw */
+static ubyte tga_rle_unmul[256][256];   /* [alpha][color] */
+static ubyte tga_rle_alpha[256];
+static int tga_rle_tables_ready = 0;
+
+
+static void tga_rle_init_tables( void ) {
+
+    int a, c;
+    float color, alpha;
+
+    if( tga_rle_tables_ready ) {
+        return;
+    }
+
+    for( a = 0; a < 256; a++ ) {
+
+        alpha = a / 255.0f;
+
+        for( c = 0; c < 256; c++ ) {
+
+            color = c / 255.0f;
+
+            if( alpha > 0.0001 ) {
+                color /= alpha;
+            }
+
+            color = color > 1.0f ? 255.0f : color * 255.0f;
+            tga_rle_unmul[a][c] = (ubyte)color;
+        }
+
+        alpha = alpha > 1.0f ? 255.0f : alpha * 255.0f;
+        tga_rle_alpha[a] = (ubyte)alpha;
+    }
+
+    tga_rle_tables_ready = 1;
+
+}
+
+
+/* convert one RGB(A) pixel to the BGR(A) value written to the file */
+static uint32 tga_rle_pixel( const ubyte * src, unsigned int format ) {
+
+    const ubyte * unmul;
+
+    if( format == TGA_TRUECOLOR_24 ) {
+        return( src[2] | (src[1] << 8) | (src[0] << 16) );
+    }
+
+    unmul = tga_rle_unmul[src[3]];
+    return( unmul[src[2]] | (unmul[src[1]] << 8) | (unmul[src[0]] << 16) | 
+            ((uint32)tga_rle_alpha[src[3]] << 24) );
+
+}
+
+
+static ubyte * tga_rle_put( ubyte * out, uint32 pixel, unsigned int format ) {
+
+    out[0] = (ubyte)pixel;
+    out[1] = (ubyte)(pixel >> 8);
+    out[2] = (ubyte)(pixel >> 16);
+    if( format == TGA_TRUECOLOR_32 ) {
+        out[3] = (ubyte)(pixel >> 24);
+    }
+
+    return( out + format );
+
+}
+
+
+/* encode rows [first_row, end_row) of a group into its buffer */
+static void tga_rle_encode_group( tga_rle_group * group ) {
+
+    int row, col;
+    int width = group->width;
+    unsigned int format = group->format;
+    const ubyte * src;
+    uint32 before;
+    ubyte * out = group->out;
+
+    for( row = group->first_row; row < group->end_row; row++ ) {
+
+        src = group->dat + (size_t)row * width * format;
+
+        if( format == TGA_TRUECOLOR_24 ) {
+            for( col = 0; col < width; col++ ) {
+                group->px[col] = tga_rle_pixel( src + col * 3, TGA_TRUECOLOR_24 );
+            }
+        } else {
+            for( col = 0; col < width; col++ ) {
+                group->px[col] = tga_rle_pixel( src + col * 4, TGA_TRUECOLOR_32 );
+            }
+        }
+
+        // the last pixel of the previous row; the reference encoder starts
+        // from zero before the first one.
+        before = row > 0 ? tga_rle_pixel( src - format, format ) : 0;
+
+        out = tga_rle_encode_row( group->px, width, row == group->height - 1, before, format, out );
+    }
+
+    group->used = out - group->out;
+
+}
+
+
+/*
+    Pack one row.  Raw and run packets hold at most 128 pixels and a run
+    needs at least two equal pixels.  A lone pixel at the end of a row is a
+    one pixel raw packet.  On the last row of the image the reference
+    encoder's cleanup is reproduced: a lone last pixel is written together
+    with the one before it, and a raw packet reaching the end repeats its
+    second to last pixel and is cut to three bytes per pixel.
+*/
+static ubyte * tga_rle_encode_row( const uint32 * px, int width, int last, uint32 before, 
+                                   unsigned int format, ubyte * out ) {
+
+    int start = 0;
+    int end, limit, count, i;
+
+    while( start < width ) {
+
+        if( start == width - 1 ) {
+            if( last ) {
+                *out++ = 1;
+                out = tga_rle_put( out, width > 1 ? px[width - 2] : before, format );
+            } else {
+                *out++ = 0;
+            }
+            out = tga_rle_put( out, px[width - 1], format );
+            break;
+        }
+
+        if( px[start + 1] == px[start] ) {
+
+            // run packet
+            end = tga_rle_run_end( px, start + 2, width, px[start] );
+            if( end - start > 128 ) {
+                end = start + 128;
+            }
+
+            *out++ = (ubyte)(0x80 | (end - start - 1));
+            out = tga_rle_put( out, px[start], format );
+            start = end;
+
+        } else {
+
+            // raw packet, up to the pixel that begins the next run
+            limit = start + 128 < width ? start + 128 : width;
+            end = tga_rle_raw_end( px, start + 2, limit );
+
+            if( end < limit ) {
+                end--;
+            } else if( last && limit == width ) {
+                count = width - start;
+                *out++ = (ubyte)(count - 1);
+                for( i = start; i < width - 1; i++ ) {
+                    out = tga_rle_put( out, px[i], format );
+                }
+                out = tga_rle_put( out, px[width - 2], format );
+                out -= count * (format - 3);
+                break;
+            }
+
+            *out++ = (ubyte)(end - start - 1);
+            for( i = start; i < end; i++ ) {
+                out = tga_rle_put( out, px[i], format );
+            }
+            start = end;
+        }
+    }
+
+    return( out );
+
+}
+
+
+/* first index in [from, end) whose pixel is not val, comparing two pixels at a time */
+static int tga_rle_run_end( const uint32 * px, int from, int end, uint32 val ) {
+
+    unsigned long long pair = ((unsigned long long)val << 32) | val;
+    unsigned long long word;
+
+    while( from + 2 <= end ) {
+        memcpy( &word, px + from, sizeof( word ) );
+        if( word != pair ) {
+            break;
+        }
+        from += 2;
+    }
+
+    while( from < end && px[from] == val ) {
+        from++;
+    }
+
+    return( from );
+
+}
+
+
+/* first index in [from, end) whose pixel equals the one before it, two pixels at a time */
+static int tga_rle_raw_end( const uint32 * px, int from, int end ) {
+
+    unsigned long long prev, next, diff;
+
+    while( from + 2 <= end ) {
+        memcpy( &prev, px + from - 1, sizeof( prev ) );
+        memcpy( &next, px + from, sizeof( next ) );
+        diff = prev ^ next;
+        if( (diff & 0xFFFFFFFFu) == 0 || (diff >> 32) == 0 ) {
+            break;
+        }
+        from += 2;
+    }
+
+    while( from < end && px[from] != px[from - 1] ) {
+        from++;
+    }
+
+    return( from );
+
+}
+
+
+#ifdef _WIN32
+
+static DWORD WINAPI tga_rle_thread( LPVOID arg ) {
+    tga_rle_encode_group( (tga_rle_group *)arg );
+    return( 0 );
+}
+
+static int tga_cpu_count( void ) {
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    return( (int)info.dwNumberOfProcessors );
+}
+
+#else
+
+static void * tga_rle_thread( void * arg ) {
+    tga_rle_encode_group( (tga_rle_group *)arg );
+    return( NULL );
+}
+
+static int tga_cpu_count( void ) {
+    return( (int)sysconf( _SC_NPROCESSORS_ONLN ) );
+}
+
+#endif
+
+
+/* encode a batch of groups, one per thread; the caller takes the first */
+static void tga_run_groups( tga_rle_group * groups, int count ) {
+
+#ifdef _WIN32
+    HANDLE threads[RLE_MAX_THREADS];
+#else
+    pthread_t threads[RLE_MAX_THREADS];
+#endif
+    int started[RLE_MAX_THREADS];
+    int i;
+
+    for( i = 1; i < count; i++ ) {
+#ifdef _WIN32
+        threads[i] = CreateThread( NULL, 0, tga_rle_thread, &groups[i], 0, NULL );
+        started[i] = threads[i] != NULL;
+#else
+        started[i] = pthread_create( &threads[i], NULL, tga_rle_thread, &groups[i] ) == 0;
+#endif
+        if( !started[i] ) {
+            tga_rle_encode_group( &groups[i] );
+        }
+    }
+
+    if( count > 0 ) {
+        tga_rle_encode_group( &groups[0] );
+    }
+
+    for( i = 1; i < count; i++ ) {
+        if( started[i] ) {
+#ifdef _WIN32
+            WaitForSingleObject( threads[i], INFINITE );
+            CloseHandle( threads[i] );
+#else
+            pthread_join( threads[i], NULL );
+#endif
+        }
+    }
+
+}
@@ -85,6 +85,9 @@ void * tga_load( const char * file, int * width, int * height, unsigned int form
 int tga_write_raw( const char * file, int width, int height, unsigned char * dat, unsigned int format );
 int tga_write_rle( const char * file, int width, int height, unsigned char * dat, unsigned int format );
 
+/* the original single threaded RLE writer -- same output as tga_write_rle, kept for checking it */
+int tga_write_rle_ref( const char * file, int width, int height, unsigned char * dat, unsigned int format );
+
 
 #ifdef __cplusplus
 }
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <time.h>
 #include "Maze.h"
 #include <Fl/Fl.h>
 #include <Fl/fl_ask.h>
@@ -64,7 +65,7 @@ static void Build_Callback(Fl_Widget *widget, void *data)
 
 	if ( maze )
 		delete maze;
-	maze = new Maze(nx, ny, sx, sy);
+	maze = new Maze(nx, ny, sx, sy, (uint32_t)time(NULL));
 
 	try {
 		maze->Set_View_Posn((float)vx_counter->value(),
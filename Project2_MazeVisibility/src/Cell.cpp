@@ -16,35 +16,13 @@
 *************************************************************************/
 
 #include <stdio.h>
-#include "Maze.h"
-#include "LineSeg.h"
-#include <Fl/gl.h>
-#include <Fl/math.h>
+#include "Cell.h"
 
 const char  Cell::PLUS_X	= 0;
 const char  Cell::PLUS_Y	= 1;
 const char  Cell::MINUS_X	= 2;
 const char  Cell::MINUS_Y	= 3;
 
-//***********************************************************************
-//
-// * Constructor.
-//=======================================================================
-Cell::
-Cell(int i, Edge *px, Edge *py, Edge *mx, Edge *my)
-//=======================================================================
-{
-	index = i;
-
-	edges[PLUS_X] = px;
-	edges[PLUS_Y] = py;
-	edges[MINUS_X] = mx;
-	edges[MINUS_Y] = my;
-
-	counter = 0;
-	footprint = false;
-}
-
 
 //***********************************************************************
 //
@@ -53,24 +31,31 @@ Cell(int i, Edge *px, Edge *py, Edge *mx, Edge *my)
 //=======================================================================
 bool Cell::
 Point_In_Cell(const float x, const float y, const float z,
-              Cell* &neighbor)
+              Cell &neighbor) const
 //=======================================================================
 {
 	int i;
 
 	if ( z <= -1.0 || z >= 1.0 ) {
-		neighbor = 0;
+		neighbor = Cell(tables);
 		return false;
 	}
 
 	// Check the point against each edge in turn.
 	for ( i = 0 ; i < 4 ; i++ ) {
+		uint32_t	e = tables->cell_edge[i][index];
+		if ( e == MazeTables::NO_INDEX )
+			continue;
+
 		// Test whether the cell and the point lie on the same side of the
-		// edge. If not, the point is outside.
-		if ( edges[i]->Cell_Side(this) != edges[i]->Point_Side(x, y) ) {
+		// edge. If not, the point is outside. A point on the edge is outside
+		// both of its cells.
+		bool	cell_left = tables->edge_cell[Edge::LEFT][e] == index;
+		float	side = tables->Edge_Line(e, x, y);
+		if ( cell_left ? !( side > 0.0f ) : !( side < 0.0f ) ) {
 			// Found an edge that we are on the wrong side of.
 			// Return the neighboring cell, so we know where to look next.
-			neighbor = edges[i]->Neighbor(this);
+			neighbor = Cell(tables, tables->edge_cell[cell_left ? Edge::RIGHT : Edge::LEFT][e]);
 			return false;
 		}
 	}
@@ -85,44 +70,53 @@ Point_In_Cell(const float x, const float y, const float z,
 //   crosses an opaque edge, clip it to that edge and set (xe,ye) to be
 //   the intersection point. If it crosses a transparent edge, clip
 //   it and set (xs,ys) to be the intersection point. If the segment lies
-//   inside the cell or was clipped to an opaque edge, then 0 is
-//   returned, otherwise the cell on the other side of the transparent
+//   inside the cell or was clipped to an opaque edge, then an invalid cell
+//   is returned, otherwise the cell on the other side of the transparent
 //   clip edge is returned (the cell the segment is entering).
 //   This is used in tracking the viewer, but much of it is also useful
 //   for clipping edges, so you should try to understand how it works.
 //=======================================================================
-Cell* Cell::
+Cell Cell::
 Clip_To_Cell(float &xs, float &ys,
-             float &xe, float &ye, const float buffer)
+             float &xe, float &ye, const float buffer) const
 //=======================================================================
 {
-	LineSeg in_seg(xs, ys, xe, ye);
 	float   min_crossing = 1.0f;
-	int	  min_cross_edge;
+	uint32_t	min_cross_edge = MazeTables::NO_INDEX;
 	int     i;
 
 
-	// Check each edge for a valid crossing.
+	// Check each edge for a valid crossing. The segment crosses the edge's
+	// line where the line equation, which is linear along the segment,
+	// passes through zero.
 	for ( i = 0 ; i < 4 ; i++ ) {
-		LineSeg e(edges[i]);
-		float	cross = in_seg.Cross_Param(e);
+		uint32_t	e = tables->cell_edge[i][index];
+		if ( e == MazeTables::NO_INDEX )
+			continue;
+
+		float	start_side = tables->Edge_Line(e, xs, ys);
+		float	denom = start_side - tables->Edge_Line(e, xe, ye);
+		if ( denom == 0.0f )
+			continue;	// Parallel segments.
+
+		float	cross = start_side / denom;
 
 		if ( cross > 0.0 && cross < min_crossing ) {
 			min_crossing = cross;
 			// Keep track of which edge the segment crosses first.
-			min_cross_edge = i;
+			min_cross_edge = e;
 		}
 	}
 
 	// If the nearest crossing is within the segment...
 	if ( min_crossing < 1.0 ) {
-		if ( edges[min_cross_edge]->opaque )	{
+		if ( tables->edge_opaque[min_cross_edge] )	{
 			min_crossing -= 1.0e-3f; // Make sure we stay inside.
 			if ( min_crossing < 0.0 )	
 				min_crossing = 0.0f;
 			xe = xs + min_crossing * ( xe - xs );
 			ye = ys + min_crossing * ( ye - ys );
-			return NULL;
+			return Cell(tables);
 		}
 		else
 		{
@@ -133,11 +127,10 @@ Clip_To_Cell(float &xs, float &ys,
 			ys = ys + min_crossing * ( ye - ys );
 
 			// Return the cell the segment is entering
-			return edges[min_cross_edge]->Neighbor(this);
+			return Edge(tables, min_cross_edge).Neighbor(*this);
 		}
 	}
 
-	return NULL;
+	return Cell(tables);
 }
 
-
@@ -20,29 +20,48 @@
 
 #include "Edge.h"
 
+// A cell is a handle to one entry of the maze's cell tables. Handles are
+// cheap to copy and compare. The handle of a missing cell, such as the
+// neighbor across a boundary edge, is not Valid().
 class Cell {
 	public:
-		// Constructor takes the index and the four edges
-		Cell(int, Edge*, Edge*, Edge*, Edge*);
+		// Constructor takes the tables and the cell's index in them.
+		Cell(MazeTables *t = NULL, uint32_t i = MazeTables::NO_INDEX) : tables(t), index(i) {};
 
 	public:
+		// The index of this cell (just an identifier).
+		int		Index(void) const { return (int)index; };
+
+		// False for the handle of a missing cell.
+		bool	Valid(void) const { return index != MazeTables::NO_INDEX; };
+
+		// The edge of the cell in the given direction, one of the constants
+		// below.
+		Edge	Get_Edge(const char which_one) const {
+			return Edge(tables, tables->cell_edge[which_one][index]);
+		};
+
 		// Returns true if the given point (x,y) is inside the cell, otherwise
 		// returns false and sets the new_cell to be the neighboring cell across
 		// the edge for which the inside test failed. Used in tracking the viewer.
 		bool    Point_In_Cell(const float x, const float y, const float z,
-									 Cell *&new_cell);
+									 Cell &new_cell) const;
 
 		// Clip the segment (xs,ys)->(xe,ye) to the cell. If the segment
 		// crosses an opaque edge, clip it to that edge and set (xe,ye) to be
 		// the intersection point. If it crosses a transparent edge, clip
 		// it and set (xs,ys) to be the intersection point. If the segment lies
-		// inside the cell or was clipped to an opaque edge, then 0 is
-		// returned, otherwise the cell on the other side of the transparent
-		// clip edge is returned (the cell the segment is entering).
+		// inside the cell or was clipped to an opaque edge, then an invalid
+		// cell is returned, otherwise the cell on the other side of the
+		// transparent clip edge is returned (the cell the segment is entering).
 		// This is used in tracking the viewer, but much of it is also useful
 		// for clipping edges, so you should try to understand how it works.
-		Cell*   Clip_To_Cell(float &xs, float &ys,
-									float &xe, float &ye, const float buffer);
+		Cell    Clip_To_Cell(float &xs, float &ys,
+									float &xe, float &ye, const float buffer) const;
+
+		bool	operator==(const Cell &other) const { return index == other.index; };
+		bool	operator!=(const Cell &other) const { return index != other.index; };
+
   public:
     // Constants for accessing edges.
     static const char	PLUS_X;         // The edge in the positive x direction
@@ -50,16 +69,9 @@ class Cell {
     static const char	MINUS_X;        // The edge in the negative x direction
     static const char	MINUS_Y;        // The edge in the negative y direction
 
-    int		index;		// The index of this cell (just an identifier).
-    Edge		*edges[4];  // Pointers to the edges of the cell.
-
-    unsigned int    counter;	// Used in building a maze. It is reset to
-										// 0 after construction, and you should
-										// set it equal to the frame number each time
-										// you draw a cell. You then use it to prvent
-										// drawing cells twice when you recurse.
-
-	bool footprint;
+	private:
+		MazeTables	*tables;	// The tables holding the cell
+		uint32_t	index;		// The index of this cell
 };
 
 #endif
@@ -31,23 +31,29 @@ const char  Edge::END		= 1;
 
 //***********************************************************************
 //
-// * Constructor to set up the start and end and the color of the edge
+// * Add a cell to the neighbors of this edge. Valid values for
+//   which_one are Edge::LEFT or Edge::RIGHT.
 //=======================================================================
-Edge::
-Edge(int i, Vertex *start, Vertex *end, float r, float g, float b)
+void Edge::
+Add_Cell(const Cell &cell, const char which_one)
 //=======================================================================
 {
-	index = i;
-	endpoints[START] = start;
-	endpoints[END] = end;
+	tables->edge_cell[which_one][index] = (uint32_t)cell.Index();
+}
 
-	neighbors[0] = neighbors[1] = NULL;
 
-	opaque = true;
+//***********************************************************************
+//
+// * Given a cell, return the neighboring cell across this edge.
+//=======================================================================
+Cell Edge::
+Neighbor(const Cell &cell) const
+//=======================================================================
+{
+	uint32_t	left = tables->edge_cell[LEFT][index];
 
-	color[0] = r;
-	color[1] = g;
-	color[2] = b;
+	return Cell(tables, (uint32_t)cell.Index() == left ?
+						tables->edge_cell[RIGHT][index] : left);
 }
 
 //***********************************************************************
@@ -59,12 +65,14 @@ Edge(int i, Vertex *start, Vertex *end, float r, float g, float b)
 //   with your head in the z direction.
 //=======================================================================
 char Edge::
-Cell_Side(Cell *cell)
+Cell_Side(const Cell &cell) const
 //=======================================================================
 {
-	if ( cell == neighbors[LEFT] )
+	uint32_t	c = (uint32_t)cell.Index();
+
+	if ( c == tables->edge_cell[LEFT][index] )
 		return LEFT;
-	else if ( cell == neighbors[RIGHT] )
+	else if ( c == tables->edge_cell[RIGHT][index] )
 		return RIGHT;
 
 	return NEITHER;
@@ -78,23 +86,12 @@ Cell_Side(Cell *cell)
 //   for a discussion of which side is left and which is right.
 //=======================================================================
 char Edge::
-Point_Side(float x, float y)
+Point_Side(float x, float y) const
 //=======================================================================
 {
-	// Compute the determinant: | xs ys 1 |
-	//                          | xe ye 1 |
-	//                          | x  y  1 |
-	// Use its sign to get the answer.
-
-	float   det;
-
-	det = endpoints[START]->posn[Vertex::X] * 
-			( endpoints[END]->posn[Vertex::Y] - y ) - 
-			endpoints[START]->posn[Vertex::Y] * 
-			( endpoints[END]->posn[Vertex::X] - x ) +
-			endpoints[END]->posn[Vertex::X] * y	- 
-			endpoints[END]->posn[Vertex::Y] * x;
-    
+	// The sign of the precomputed line equation gives the answer.
+	float   det = tables->Edge_Line(index, x, y);
+
 	if ( det == 0.0 )
 		return ON;
 	else if ( det > 0.0 )
@@ -102,5 +99,3 @@ Point_Side(float x, float y)
 	else
 		return RIGHT;
 }
-
-
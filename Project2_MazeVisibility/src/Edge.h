@@ -17,39 +17,61 @@
 #ifndef _EDGE_H_
 #define _EDGE_H_
 
+#include "MazeTables.h"
 #include "Vertex.h"
 
+class Cell;
+
+// An edge is a handle to one entry of the maze's edge tables. Handles are
+// cheap to copy and compare. The handle of a missing edge is not Valid().
 class Edge {
 
 	public:
-		// Constructor takes the index, pointers to the start and end
-		// vertices, and r, g and b for the color.
-		Edge(int, Vertex*, Vertex*, float, float, float);
+		// Constructor takes the tables and the edge's index in them.
+		Edge(MazeTables *t, uint32_t i) : tables(t), index(i) {};
 
 	public:
+		// The identifier of the edge.
+		int		Index(void) const { return (int)index; };
+
+		// False for the handle of a missing edge.
+		bool	Valid(void) const { return index != MazeTables::NO_INDEX; };
+
+		// The vertex at one end. Valid values for which_one are Edge::START
+		// or Edge::END.
+		Vertex	Endpoint(const char which_one) const {
+			return Vertex(tables, tables->edge_vertex[which_one][index]);
+		};
+
 		// Add a cell to the neighbors of this edge. Valid values for
 		// which_one are Edge::LEFT or Edge::RIGHT.
-		void	Add_Cell(class Cell *cell, const char which_one){ 
-			neighbors[which_one] = cell; 
-		};
+		void	Add_Cell(const Cell &cell, const char which_one);
 
 		// Given a cell, return the neighboring cell across this edge.
 		// This is very useful.
-		class Cell*	Neighbor(class Cell *cell) { 
-			return cell == neighbors[LEFT] ? neighbors[RIGHT] : neighbors[LEFT]; 
-		};
+		Cell	Neighbor(const Cell &cell) const;
 
 		// Returns which side of the edge a cell lies. Valid return values are
 		// LEFT, RIGHT or NEITHER if the cell is not a neighbor of the edge.
 		// The left side of the edge is the side that would be on the left
 		// if you were standing at the START of the edge and looking along it,
 		// with your head in the z direction.
-		char	Cell_Side(class Cell*);
+		char	Cell_Side(const Cell &cell) const;
 
 		// Returns which side of the edge the line (x,y) is on. The return value
 		// is one of the constants defined above (LEFT, RIGHT, ON). See above
 		// for a discussion of which side is left and which is right.
-		char	Point_Side(float x, float y);
+		char	Point_Side(float x, float y) const;
+
+		// True is this edge cannot be seen or walked through, false otherwise.
+		bool	Opaque(void) const { return tables->edge_opaque[index] != 0; };
+		void	Set_Opaque(const bool o) { tables->edge_opaque[index] = o ? 1 : 0; };
+
+		// The color for this edge / wall, as r, g and b.
+		const float*	Color(void) const { return tables->edge_color + 3 * (size_t)index; };
+
+		bool	operator==(const Edge &other) const { return index == other.index; };
+		bool	operator!=(const Edge &other) const { return index != other.index; };
 
   public:
 		// Constants.
@@ -62,21 +84,9 @@ class Edge {
 		static const char	START;
 		static const char	END;
 
-		int			index;				// An identifier
-
-		Vertex		*endpoints[2]; 	// The vertices at each end, indexed by
-    											// Edge::START and Edge::END
-
-		class Cell		*neighbors[2];	// The cells that this edge lies
-    											// between, indexed by Edge::LEFT and
-												// Edge::RIGHT. One or the other may
-												// be 0 if the edge is on the
-												// boundary of the maze
-
-    bool		opaque;	// True is this edge cannot be seen or
-    						// walked through, false otherwise.
-
-    float	color[3]; // The color for this edge / wall.
+	private:
+		MazeTables	*tables;	// The tables holding the edge
+		uint32_t	index;		// An identifier
 
 };
 
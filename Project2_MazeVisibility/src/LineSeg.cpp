@@ -22,14 +22,14 @@
 // * Constructor from an edge
 //======================================================================
 LineSeg::
-LineSeg(Edge *e)
+LineSeg(const Edge &e)
 //======================================================================
 {
-	start[0] = e->endpoints[Edge::START]->posn[Vertex::X];
-	start[1] = e->endpoints[Edge::START]->posn[Vertex::Y];
+	start[0] = e.Endpoint(Edge::START).Posn(Vertex::X);
+	start[1] = e.Endpoint(Edge::START).Posn(Vertex::Y);
 
-	end[0] = e->endpoints[Edge::END]->posn[Vertex::X];
-	end[1] = e->endpoints[Edge::END]->posn[Vertex::Y];
+	end[0] = e.Endpoint(Edge::END).Posn(Vertex::X);
+	end[1] = e.Endpoint(Edge::END).Posn(Vertex::Y);
 }
 
 //**********************************************************************
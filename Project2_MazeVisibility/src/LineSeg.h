@@ -28,7 +28,7 @@ class LineSeg {
 
 		// Second constructor takes an edge. The LineSeg created has the same
 		// start and end points as the edge.
-		LineSeg(Edge*);
+		LineSeg(const Edge&);
 
 	public:
 		// Return the parameter value at which this segment crosses the given
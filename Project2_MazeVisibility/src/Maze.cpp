@@ -21,9 +21,11 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
-#include <time.h>
+#include <algorithm>
+#include <string>
 #include <FL/Fl.h>
 #include <FL/fl_draw.h>
+#include "Parallel.h"
 
 const char Maze::X = 0;
 const char Maze::Y = 1;
@@ -32,6 +34,225 @@ const char Maze::W = 3;
 
 const float Maze::BUFFER = 0.1f;
 
+// Binary maze files start with this, then the rest of a Binary_Header,
+// then the tables laid out as MazeTables lays out its block.
+static const char		BINARY_MAGIC[4] = { 'M', 'A', 'Z', 'B' };
+static const uint32_t	BINARY_VERSION = 1;
+static const uint32_t	BINARY_BYTE_ORDER = 0x01020304;
+
+//**********************************************************************
+//
+// * The header of a binary maze file. It is 64 bytes, so the tables after
+//   it stay aligned.
+//======================================================================
+struct Binary_Header {
+	char		magic[4];			// BINARY_MAGIC
+	uint32_t	version;			// BINARY_VERSION
+	uint32_t	byte_order;			// BINARY_BYTE_ORDER, as the writer stored it
+	uint32_t	num_vertices;
+	uint32_t	num_edges;
+	uint32_t	num_cells;
+	uint64_t	block_size;			// The size of the tables in bytes
+	float		viewer_posn[3];
+	float		viewer_dir;
+	float		viewer_fov;
+	uint32_t	maze_hash[2];		// MazePVS::Hash of the tables, low word first.
+										// 0 in files written before it was kept.
+	uint32_t	unused;
+};
+
+
+//**********************************************************************
+//
+// * Reads numbers from the text of a maze file, which must end in a 0.
+//   Numbers are separated by white space. Floats in the usual %g forms are
+//   converted by hand; anything longer or stranger goes to strtod.
+//======================================================================
+class Text_Reader {
+	public:
+		Text_Reader(const char *text) { p = text; };
+
+		// Read the next number. Return false if there isn't one.
+		bool	Int(int &value);
+		bool	Float(float &value);
+
+	private:
+		void	Skip_Space(void) {
+			while ( *p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' )
+				p++;
+		};
+
+	private:
+		const char	*p;		// The next character to read
+};
+
+
+//**********************************************************************
+//
+// * Read an integer
+//======================================================================
+bool Text_Reader::
+Int(int &value)
+//======================================================================
+{
+	bool		negative = false;
+	long long	v = 0;
+
+	Skip_Space();
+	if ( *p == '-' || *p == '+' )
+		negative = *p++ == '-';
+	if ( *p < '0' || *p > '9' )
+		return false;
+
+	for ( ; *p >= '0' && *p <= '9' ; p++ ) {
+		v = v * 10 + ( *p - '0' );
+		if ( v > 0x80000000LL )
+			return false;
+	}
+	if ( negative )
+		v = -v;
+	if ( v > 0x7FFFFFFFLL )
+		return false;
+
+	value = (int)v;
+	return true;
+}
+
+
+//**********************************************************************
+//
+// * Read a float. Up to 19 digits with a power of ten within 22 of them
+//   are exact in double, so one multiply or divide rounds correctly.
+//======================================================================
+bool Text_Reader::
+Float(float &value)
+//======================================================================
+{
+	static const double	powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const char			*start;
+	bool				negative = false;
+	unsigned long long	mantissa = 0;
+	int					digits = 0;
+	int					exponent = 0;
+	int					e = 0;
+	bool				e_negative = false;
+
+	Skip_Space();
+	start = p;
+
+	if ( *p == '-' || *p == '+' )
+		negative = *p++ == '-';
+	for ( ; *p >= '0' && *p <= '9' ; p++, digits++ )
+		mantissa = mantissa * 10 + ( *p - '0' );
+	if ( *p == '.' )
+		for ( p++ ; *p >= '0' && *p <= '9' ; p++, digits++, exponent-- )
+			mantissa = mantissa * 10 + ( *p - '0' );
+
+	if ( digits > 0 && ( *p == 'e' || *p == 'E' ) ) {
+		const char	*exp_start = p++;
+		if ( *p == '-' || *p == '+' )
+			e_negative = *p++ == '-';
+		if ( *p < '0' || *p > '9' )
+			p = exp_start;
+		else
+			for ( ; *p >= '0' && *p <= '9' && e < 10000 ; p++ )
+				e = e * 10 + ( *p - '0' );
+	}
+	exponent += e_negative ? -e : e;
+
+	if ( digits > 0 && digits <= 19 && exponent >= -22 && exponent <= 22 &&
+		  mantissa < ( 1ULL << 53 ) ) {
+		double	v = (double)mantissa;
+		v = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+		value = (float)( negative ? -v : v );
+		return true;
+	}
+
+	// Let the library handle everything else, such as inf and nan.
+	char	*end;
+	double	v = strtod(start, &end);
+
+	if ( end == start )
+		return false;
+
+	p = end;
+	value = (float)v;
+	return true;
+}
+
+
+
+//**********************************************************************
+//
+// * A small, fast random number generator (splitmix64) for building
+//   mazes. Each stream of a seed gives its own sequence, so separate
+//   parts of a maze can be built in any order, on any thread, and still
+//   come out the same for the same seed.
+//======================================================================
+class Maze_Random {
+	public:
+		Maze_Random(const uint64_t seed, const uint64_t stream) {
+			state = seed;
+			state = Next() ^ stream;
+			Next();
+		};
+
+		// The next 64 random bits.
+		uint64_t	Next(void) {
+			uint64_t	z = ( state += 0x9E3779B97F4A7C15ull );
+
+			z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+			z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+			return z ^ ( z >> 31 );
+		};
+
+		// A random integer from 0 up to but not including n.
+		uint32_t	Below(const uint32_t n) {
+			return (uint32_t)( ( ( Next() >> 32 ) * n ) >> 32 );
+		};
+
+	private:
+		uint64_t	state;
+};
+
+// Streams of the maze seed used for each part of building a maze. Edge
+// colors use the edge index as the stream.
+static const uint64_t	TILE_STREAM = 1ull << 40;
+static const uint64_t	STITCH_STREAM = 1ull << 41;
+
+// Random mazes are grown in square tiles of this many cells on a side, one
+// tile per thread at a time, and then the tiles are joined up.
+static const uint32_t	TILE_SIZE = 256;
+
+
+//**********************************************************************
+//
+// * The backend Draw_View uses unless it is given another. It draws all
+//   the walls of a view as quads with one call, straight from the vertex
+//   array.
+//======================================================================
+class GL_Backend : public View_Backend {
+	public:
+		void	Draw_Walls(const View_Vertex *vertices, const size_t num_vertices) {
+			glDisable(GL_DEPTH_TEST);
+			if ( ! num_vertices )
+				return;
+
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_COLOR_ARRAY);
+			glVertexPointer(2, GL_FLOAT, sizeof(View_Vertex), &vertices[0].x);
+			glColorPointer(3, GL_FLOAT, sizeof(View_Vertex), &vertices[0].r);
+			glDrawArrays(GL_QUADS, 0, (GLsizei)num_vertices);
+			glDisableClientState(GL_COLOR_ARRAY);
+			glDisableClientState(GL_VERTEX_ARRAY);
+		};
+};
+
+static GL_Backend	gl_backend;
+
 
 //**********************************************************************
 //
@@ -48,17 +269,19 @@ MazeException(const char *m)
 
 //**********************************************************************
 //
-// * Constructor to create the default maze
+// * Constructor to create the default maze. The same seed always gives
+//   the same maze.
 //======================================================================
 Maze::
-Maze(const int nx, const int ny, const float sx, const float sy)
+Maze(const int nx, const int ny, const float sx, const float sy,
+	  const uint32_t seed)
 //======================================================================
 {
 	// Build the connectivity structure.
-	Build_Connectivity(nx, ny, sx, sy);
+	Build_Connectivity(nx, ny, sx, sy, seed);
 
 	// Make edges transparent to create a maze.
-	Build_Maze();
+	Build_Maze(nx, ny, seed);
 
 	// Set the extents of the maze
 	Set_Extents();
@@ -68,294 +291,481 @@ Maze(const int nx, const int ny, const float sx, const float sy)
 	viewer_dir = 0.0;
 	viewer_fov = 45.0;
 
-	// Always start on the 0th frame.
+	// Always start on the 0th frame, drawing with OpenGL.
 	frame_num = 0;
+	backend = NULL;
+	memset(&view_stats, 0, sizeof(view_stats));
+	tables_hash = 0;
+
+	// A new maze has no file to keep its visible sets in, and building them
+	// for a big maze takes far longer than building the maze. They are
+	// built when the maze is next loaded from a file.
 }
 
 
 //**********************************************************************
 //
-// * Construtor to read in precreated maze
+// * Construtor to read in precreated maze, in either the text or the
+//   binary format
 //======================================================================
 Maze::
 Maze(const char *filename)
 //======================================================================
+{
+	FILE    *f;
+	char	magic[4];
+	bool	binary;
+
+	// Open the file and look for the binary format's magic number.
+	if ( ! ( f = fopen(filename, "rb") ) )
+		throw new MazeException("Maze: Couldn't open file");
+
+	binary = fread(magic, 1, 4, f) == 4 && memcmp(magic, BINARY_MAGIC, 4) == 0;
+	fclose(f);
+
+	tables_hash = 0;
+	if ( binary )
+		Read_Binary(filename);
+	else
+		Read_Text(filename);
+
+	cell_frame.assign(tables.num_cells, 0);
+
+	Set_Extents();
+
+	// Figure out which cell the viewer is in.
+	Find_View_Cell();
+
+	frame_num = 0;
+	backend = NULL;
+	memset(&view_stats, 0, sizeof(view_stats));
+
+	// Use the visible sets saved next to the maze, unless they are missing
+	// or were built for a different maze. Then build them and save them for
+	// next time.
+	std::string	pvs_file = PVS_File_Name(filename);
+
+	if ( ! pvs.Load(pvs_file.c_str(), tables, Tables_Hash()) ) {
+		pvs.Build(tables);
+		pvs.Save(pvs_file.c_str());
+	}
+}
+
+
+//**********************************************************************
+//
+// * Read a maze in the text format. The whole file is read into memory
+//   and parsed by hand.
+//======================================================================
+void Maze::
+Read_Text(const char *filename)
+//======================================================================
 {
 	char    err_string[128];
 	FILE    *f;
-	int	    i;
+	long	size;
+	int	    i, j;
+	int		num_vertices, num_edges, num_cells;
+
+	// The counts come one after another in the file, so the vertices and
+	// edges are held here until the tables can be allocated.
+	std::vector<char>	text;
+	std::vector<float>	vertex_posn;
+	std::vector<int>	edge_ints;		// start, end, left, right, opaque
+	std::vector<float>	edge_colors;
 
-	// Open the file
-	if ( ! ( f = fopen(filename, "r") ) )
+	// Read the whole file, with a 0 after it to stop the parser.
+	if ( ! ( f = fopen(filename, "rb") ) )
 		throw new MazeException("Maze: Couldn't open file");
+	if ( fseek(f, 0, SEEK_END) != 0 || ( size = ftell(f) ) < 0 ||
+		  fseek(f, 0, SEEK_SET) != 0 ) {
+		fclose(f);
+		throw new MazeException("Maze: Couldn't read file");
+	}
+	text.resize(size + 1);
+	if ( fread(&text[0], 1, size, f) != (size_t)size ) {
+		fclose(f);
+		throw new MazeException("Maze: Couldn't read file");
+	}
+	text[size] = '\0';
+	fclose(f);
+
+	Text_Reader	in(&text[0]);
 
 	// Get the total number of vertices
-	if ( fscanf(f, "%d", &num_vertices) != 1 )
+	if ( ! in.Int(num_vertices) || num_vertices < 1 )
 		throw new MazeException("Maze: Couldn't read number of vertices");
 
 	// Read in each vertices
-	vertices = new Vertex*[num_vertices];
+	vertex_posn.resize(2 * num_vertices);
 	for ( i = 0 ; i < num_vertices ; i++ ) {
-		float x, y;
-		if ( fscanf(f, "%g %g", &x, &y) != 2 )	{
+		if ( ! in.Float(vertex_posn[2 * i]) || ! in.Float(vertex_posn[2 * i + 1]) ) {
 			sprintf(err_string, "Maze: Couldn't read vertex number %d", i);
 			throw new MazeException(err_string);
 		}
-		vertices[i] = new Vertex(i, x, y);
 	}
 
 	// Get the number of edges
-	if ( fscanf(f, "%d", &num_edges) != 1 )
+	if ( ! in.Int(num_edges) || num_edges < 0 )
 		throw new MazeException("Maze: Couldn't read number of edges");
 
 	// read in all edges
-	edges = new Edge*[num_edges];
+	edge_ints.resize(5 * num_edges);
+	edge_colors.resize(3 * num_edges);
 	for ( i = 0 ; i < num_edges ; i++ ){
-		int     vs, ve, cl, cr, o;
-		float	r, g, b;
-		if ( fscanf(f, "%d %d %d %d %d %g %g %g",
-						&vs, &ve, &cl, &cr, &o, &r, &g, &b) != 8) {
+		int		*ints = &edge_ints[5 * i];
+		float	*color = &edge_colors[3 * i];
+		if ( ! in.Int(ints[0]) || ! in.Int(ints[1]) || ! in.Int(ints[2]) ||
+			  ! in.Int(ints[3]) || ! in.Int(ints[4]) ||
+			  ! in.Float(color[0]) || ! in.Float(color[1]) || ! in.Float(color[2]) ) {
 			sprintf(err_string, "Maze: Couldn't read edge number %d", i);
 			throw new MazeException(err_string);
 		}
-		edges[i] = new Edge(i, vertices[vs], vertices[ve], r, g, b);
-		edges[i]->Add_Cell((Cell*)cl, Edge::LEFT);
-		edges[i]->Add_Cell((Cell*)cr, Edge::RIGHT);
-		edges[i]->opaque = o ? true : false;
 	}
 
 	// Read in the number of cells
-	if ( fscanf(f, "%d", &num_cells) != 1 )
+	if ( ! in.Int(num_cells) || num_cells < 1 )
 		throw new MazeException("Maze: Couldn't read number of cells");
 
+	tables.Allocate(num_vertices, num_edges, num_cells);
+
+	for ( i = 0 ; i < num_vertices ; i++ ) {
+		tables.vertex_posn[Vertex::X][i] = vertex_posn[2 * i];
+		tables.vertex_posn[Vertex::Y][i] = vertex_posn[2 * i + 1];
+	}
+
+	// Some edges have no neighbor on one side. They were saved as -1. Any
+	// other negative index is caught by Check_Tables.
+	for ( i = 0 ; i < num_edges ; i++ ) {
+		int	*ints = &edge_ints[5 * i];
+		tables.edge_vertex[Edge::START][i] = (uint32_t)ints[0];
+		tables.edge_vertex[Edge::END][i] = (uint32_t)ints[1];
+		tables.edge_cell[Edge::LEFT][i] = (uint32_t)ints[2];
+		tables.edge_cell[Edge::RIGHT][i] = (uint32_t)ints[3];
+		tables.edge_opaque[i] = ints[4] ? 1 : 0;
+		memcpy(tables.edge_color + 3 * i, &edge_colors[3 * i], 3 * sizeof(float));
+	}
 
 	// Read in all cells
-	cells = new Cell*[num_cells];
 	for ( i = 0 ; i < num_cells ; i++ )	{
-		int epx, epy, emx, emy;
-		if ( fscanf(f, "%d %d %d %d", &epx, &epy, &emx, &emy) != 4 ){
+		int e[4];
+		if ( ! in.Int(e[0]) || ! in.Int(e[1]) || ! in.Int(e[2]) || ! in.Int(e[3]) ){
 			sprintf(err_string, "Maze: Couldn't read cell number %d", i);
 			throw new MazeException(err_string);
 		}
-		cells[i] = new Cell(i, epx >= 0 ? edges[epx] : NULL,
-									epy >= 0 ? edges[epy] : NULL,
-									emx >= 0 ? edges[emx] : NULL,
-									emy >= 0 ? edges[emy] : NULL);
-		if ( cells[i]->edges[0] ) {
-			if ( cells[i]->edges[0]->neighbors[0] == (Cell*)i )
-				cells[i]->edges[0]->neighbors[0] = cells[i];
-			else if ( cells[i]->edges[0]->neighbors[1] == (Cell*)i )
-				cells[i]->edges[0]->neighbors[1] = cells[i];
-			else	{
-				sprintf(err_string,
-						  "Maze: Cell %d not one of edge %d's neighbors",
-							i, cells[i]->edges[0]->index);
-				throw new MazeException(err_string);
-			}
-		}
 
-		if ( cells[i]->edges[1] )	{
-			if ( cells[i]->edges[1]->neighbors[0] == (Cell*)i )
-				cells[i]->edges[1]->neighbors[0] = cells[i];
-			else if ( cells[i]->edges[1]->neighbors[1] == (Cell*)i )
-				cells[i]->edges[1]->neighbors[1] = cells[i];
-			else {
-				sprintf(err_string,
-							"Maze: Cell %d not one of edge %d's neighbors",
-							i, cells[i]->edges[1]->index);
-				throw new MazeException(err_string);
-			}
-		}
-		if ( cells[i]->edges[2] ) {
-			if ( cells[i]->edges[2]->neighbors[0] == (Cell*)i )
-				cells[i]->edges[2]->neighbors[0] = cells[i];
-			else if ( cells[i]->edges[2]->neighbors[1] == (Cell*)i )
-				cells[i]->edges[2]->neighbors[1] = cells[i];
-			else	{
-				sprintf(err_string,
-							"Maze: Cell %d not one of edge %d's neighbors",
-							i, cells[i]->edges[2]->index);
-				throw new MazeException(err_string);
-			}
-		}
-		if ( cells[i]->edges[3] ) {
-			if ( cells[i]->edges[3]->neighbors[0] == (Cell*)i )
-				cells[i]->edges[3]->neighbors[0] = cells[i];
-			else if ( cells[i]->edges[3]->neighbors[1] == (Cell*)i )
-				cells[i]->edges[3]->neighbors[1] = cells[i];
-			else	{
-				sprintf(err_string,
-							"Maze: Cell %d not one of edge %d's neighbors",
-							i, cells[i]->edges[3]->index);
-				throw new MazeException(err_string);
-			}
-		}
+		for ( j = 0 ; j < 4 ; j++ )
+			if ( e[j] >= 0 )
+				tables.cell_edge[j][i] = e[j];
 	}
 
-	if ( fscanf(f, "%g %g %g %g %g",
-					 &(viewer_posn[X]), &(viewer_posn[Y]), &(viewer_posn[Z]),
-					 &(viewer_dir), &(viewer_fov)) != 5 )
+	if ( ! in.Float(viewer_posn[X]) || ! in.Float(viewer_posn[Y]) ||
+		  ! in.Float(viewer_posn[Z]) || ! in.Float(viewer_dir) ||
+		  ! in.Float(viewer_fov) )
 		throw new MazeException("Maze: Error reading view information.");
 
-	// Some edges have no neighbor on one side, so be sure to set their
-	// pointers to NULL. (They were set at -1 by the save/load process.)
-	for ( i = 0 ; i < num_edges ; i++ )	{
-		if ( edges[i]->neighbors[0] == (Cell*)-1 )
-			edges[i]->neighbors[0] = NULL;
-		if ( edges[i]->neighbors[1] == (Cell*)-1 )
-			edges[i]->neighbors[1] = NULL;
-	}
+	Check_Tables();
 
-	fclose(f);
+	for ( i = 0 ; i < num_edges ; i++ )
+		tables.Set_Edge_Line(i);
+}
 
-	Set_Extents();
 
-	// Figure out which cell the viewer is in, starting off by guessing the
-	// 0th cell.
-	Find_View_Cell(cells[0]);
+//**********************************************************************
+//
+// * Read a maze in the binary format. The tables are mapped from the file
+//   and used in place, edge lines included.
+//======================================================================
+void Maze::
+Read_Binary(const char *filename)
+//======================================================================
+{
+	Binary_Header	header;
+	FILE			*f;
 
-	frame_num = 0;
+	if ( ! ( f = fopen(filename, "rb") ) )
+		throw new MazeException("Maze: Couldn't open file");
+	if ( fread(&header, sizeof(header), 1, f) != 1 ) {
+		fclose(f);
+		throw new MazeException("Maze: Couldn't read binary header");
+	}
+	fclose(f);
+
+	if ( header.version != BINARY_VERSION )
+		throw new MazeException("Maze: Unknown binary maze version");
+	if ( header.byte_order != BINARY_BYTE_ORDER )
+		throw new MazeException("Maze: Binary maze has the wrong byte order");
+	if ( header.num_vertices < 1 || header.num_cells < 1 ||
+		  header.block_size != MazeTables::Block_Size(header.num_vertices,
+																	 header.num_edges,
+																	 header.num_cells) )
+		throw new MazeException("Maze: Bad binary maze header");
+
+	if ( ! tables.Map(filename, sizeof(header), header.num_vertices,
+							header.num_edges, header.num_cells) )
+		throw new MazeException("Maze: Couldn't map binary maze");
+
+	viewer_posn[X] = header.viewer_posn[X];
+	viewer_posn[Y] = header.viewer_posn[Y];
+	viewer_posn[Z] = header.viewer_posn[Z];
+	viewer_dir = header.viewer_dir;
+	viewer_fov = header.viewer_fov;
+
+	// Kept so the mapped tables needn't all be read to check the visible sets.
+	tables_hash = header.maze_hash[0] | (uint64_t)header.maze_hash[1] << 32;
+
+	Check_Tables();
 }
 
 
 //**********************************************************************
 //
-// * Destructor must free all the memory allocated.
+// * Check that every index in the tables refers to something that exists,
+//   and that every cell is a neighbor of each of its edges. Throws a
+//   MazeException if not.
 //======================================================================
-Maze::
-~Maze(void)
+void Maze::
+Check_Tables(void)
 //======================================================================
 {
-	int i;
+	char		err_string[128];
+	uint32_t	i;
+	int			j;
+
+	for ( i = 0 ; i < tables.num_edges ; i++ ) {
+		if ( tables.edge_vertex[Edge::START][i] >= tables.num_vertices ||
+			  tables.edge_vertex[Edge::END][i] >= tables.num_vertices ) {
+			sprintf(err_string, "Maze: Edge %u has a bad vertex", i);
+			throw new MazeException(err_string);
+		}
+		for ( j = 0 ; j < 2 ; j++ ) {
+			uint32_t	c = tables.edge_cell[j][i];
+			if ( c != MazeTables::NO_INDEX && c >= tables.num_cells ) {
+				sprintf(err_string, "Maze: Edge %u has a bad cell", i);
+				throw new MazeException(err_string);
+			}
+		}
+	}
 
-	for ( i = 0 ; i < num_vertices ; i++ )
-		delete vertices[i];
-	delete[] vertices;
+	for ( i = 0 ; i < tables.num_cells ; i++ ) {
+		for ( j = 0 ; j < 4 ; j++ ) {
+			uint32_t	e = tables.cell_edge[j][i];
+			if ( e == MazeTables::NO_INDEX )
+				continue;
 
-	for ( i = 0 ; i < num_edges ; i++ )
-		delete edges[i];
-	delete[] edges;
+			if ( e >= tables.num_edges ||
+				  ( tables.edge_cell[Edge::LEFT][e] != i &&
+					 tables.edge_cell[Edge::RIGHT][e] != i ) ) {
+				sprintf(err_string,
+						  "Maze: Cell %u not one of edge %d's neighbors",
+							i, (int)e);
+				throw new MazeException(err_string);
+			}
+		}
+	}
+}
 
-	for ( i = 0 ; i < num_cells ; i++ )
-		delete cells[i];
-	delete[] cells;
+
+//**********************************************************************
+//
+// * Destructor. The tables free their own memory.
+//======================================================================
+Maze::
+~Maze(void)
+//======================================================================
+{
 }
 
 
 //**********************************************************************
 //
-// * Randomly generate the edge's opaque and transparency for an empty maze
+// * Build the vertices, edges and cells of an empty num_x by num_y grid,
+//   with every edge opaque and randomly colored. The rows of the grid are
+//   spread across all the hardware threads.
 //======================================================================
 void Maze::
 Build_Connectivity(const int num_x, const int num_y,
-                   const float sx, const float sy)
+                   const float sx, const float sy, const uint32_t seed)
 //======================================================================
 {
-	int	i, j, k;
-	int edge_i;
+	if ( num_x < 1 || num_y < 1 )
+		throw new MazeException("Maze: Bad maze size");
 
-	// Ugly code to allocate all the memory for a new maze and to associate
-	// edges with vertices and faces with edges.
+	// Every index, and every count, must fit below NO_INDEX.
+	if ( ( (uint64_t)num_x + 1 ) * ( (uint64_t)num_y + 1 ) >= MazeTables::NO_INDEX ||
+		  ( (uint64_t)num_x + 1 ) * num_y + ( (uint64_t)num_y + 1 ) * num_x
+			>= MazeTables::NO_INDEX )
+		throw new MazeException("Maze: Too many cells");
 
-	// Allocate and position the vertices.
-	num_vertices = ( num_x + 1 ) * ( num_y + 1 );
-	vertices = new Vertex*[num_vertices];
-	k = 0;
-	for ( i = 0 ; i < num_y + 1 ; i++ ) {
-		for ( j = 0 ; j < num_x + 1 ; j++ )	{
-			vertices[k] = new Vertex(k, j * sx, i * sy);
-			k++;
-		}
-	}
+	const uint32_t	nx = num_x;
+	const uint32_t	ny = num_y;
 
-	// Allocate the edges, and associate them with their vertices.
-	// Edges in the x direction get the first num_x * ( num_y + 1 ) indices,
-	// edges in the y direction get the rest.
-	num_edges = (num_x+1)*num_y + (num_y+1)*num_x;
-	edges = new Edge*[num_edges];
-	k = 0;
-	for ( i = 0 ; i < num_y + 1 ; i++ ) {
-		int row = i * ( num_x + 1 );
-		for ( j = 0 ; j < num_x ; j++ ) {
-			int vs = row + j;
-			int ve = row + j + 1;
-			edges[k] = new Edge(k, vertices[vs], vertices[ve],
-			rand() / (float)RAND_MAX * 0.5f + 0.25f,
-			rand() / (float)RAND_MAX * 0.5f + 0.25f,
-			rand() / (float)RAND_MAX * 0.5f + 0.25f);
-			k++;
-		}
-	}
+	// Edges in the x direction get the first nx * ( ny + 1 ) indices,
+	// edges in the y direction get the rest, starting at edge_i.
+	const uint32_t	edge_i = nx * ( ny + 1 );
+
+	tables.Allocate(( nx + 1 ) * ( ny + 1 ), edge_i + ( nx + 1 ) * ny, nx * ny);
+
+	// Each thread takes chunks of rows. A row is the vertices and x edges
+	// along one y value, and the y edges and cells above it.
+	Work_Chunks	rows(ny + 1, 64);
+
+	Run_On_All_Threads([&]() {
+		uint64_t	first, last;
+
+		while ( rows.Next(first, last) ) {
+			for ( uint32_t i = (uint32_t)first ; i < last ; i++ ) {
+				uint32_t	row_v = i * ( nx + 1 );
+				uint32_t	row_c = i * nx;
+				uint32_t	j;
+
+				// Position the vertices and join them with x edges.
+				for ( j = 0 ; j < nx + 1 ; j++ ) {
+					tables.vertex_posn[Vertex::X][row_v + j] = j * sx;
+					tables.vertex_posn[Vertex::Y][row_v + j] = i * sy;
+				}
+				for ( j = 0 ; j < nx ; j++ ) {
+					tables.edge_vertex[Edge::START][row_c + j] = row_v + j;
+					tables.edge_vertex[Edge::END][row_c + j] = row_v + j + 1;
+				}
 
-	edge_i = k;
-	for ( i = 0 ; i < num_y ; i++ ) {
-		int row = i * ( num_x + 1 );
-		for ( j = 0 ; j < num_x + 1 ; j++ )	{
-			int vs = row + j;
-			int ve = row + j + num_x + 1;
-			edges[k] = new Edge(k, vertices[vs], vertices[ve],
-			rand() / (float)RAND_MAX * 0.5f + 0.25f,
-			rand() / (float)RAND_MAX * 0.5f + 0.25f,
-			rand() / (float)RAND_MAX * 0.5f + 0.25f);
-			k++;
+				if ( i == ny )
+					continue;
+
+				// Join the vertices to the row above with y edges.
+				for ( j = 0 ; j < nx + 1 ; j++ ) {
+					tables.edge_vertex[Edge::START][edge_i + row_v + j] = row_v + j;
+					tables.edge_vertex[Edge::END][edge_i + row_v + j] = row_v + j + nx + 1;
+				}
+
+				// Associate the cells with their edges.
+				for ( j = 0 ; j < nx ; j++ ) {
+					uint32_t	k = row_c + j;
+					uint32_t	px = edge_i + row_v + 1 + j;
+					uint32_t	py = row_c + j + nx;
+					uint32_t	mx = edge_i + row_v + j;
+					uint32_t	my = row_c + j;
+
+					tables.cell_edge[Cell::PLUS_X][k] = px;
+					tables.cell_edge[Cell::PLUS_Y][k] = py;
+					tables.cell_edge[Cell::MINUS_X][k] = mx;
+					tables.cell_edge[Cell::MINUS_Y][k] = my;
+					tables.edge_cell[Edge::LEFT][px] = k;
+					tables.edge_cell[Edge::RIGHT][py] = k;
+					tables.edge_cell[Edge::RIGHT][mx] = k;
+					tables.edge_cell[Edge::LEFT][my] = k;
+				}
+			}
 		}
-	}
+	});
+
+	// Now that every vertex is in place, give the edges their lines and
+	// colors. Each edge's color comes from its own stream of the seed.
+	Work_Chunks	edges(tables.num_edges, 65536);
+
+	Run_On_All_Threads([&]() {
+		uint64_t	first, last;
 
-	// Allocate the cells and associate them with their edges.
-	num_cells = num_x * num_y;
-	cells = new Cell*[num_cells];
-	k = 0;
-	for ( i = 0 ; i < num_y ; i++ ) {
-		int row_x = i * ( num_x + 1 );
-		int row_y = i * num_x;
-		for ( j = 0 ; j < num_x ; j++ )	{
-			int px = edge_i + row_x + 1 + j;
-			int py = row_y + j + num_x;
-			int mx = edge_i + row_x + j;
-			int my = row_y + j;
-			cells[k] = new Cell(k, edges[px], edges[py], edges[mx], edges[my]);
-			edges[px]->Add_Cell(cells[k], Edge::LEFT);
-			edges[py]->Add_Cell(cells[k], Edge::RIGHT);
-			edges[mx]->Add_Cell(cells[k], Edge::RIGHT);
-			edges[my]->Add_Cell(cells[k], Edge::LEFT);
-			k++;
+		while ( edges.Next(first, last) ) {
+			for ( uint32_t k = (uint32_t)first ; k < last ; k++ ) {
+				uint64_t	bits = Maze_Random(seed, k).Next();
+
+				for ( int i = 0 ; i < 3 ; i++ )
+					tables.edge_color[3 * k + i] =
+						( ( bits >> ( 21 * i ) ) & 0x1FFFFF ) / (float)0x1FFFFF * 0.5f + 0.25f;
+				tables.Set_Edge_Line(k);
+			}
 		}
-	}
+	});
+
+	cell_frame.assign(tables.num_cells, 0);
 }
 
 
 //**********************************************************************
 //
-// * Add edges from cell to the set that are available for removal to
-//   grow the maze.
+// * Offer the edge into a cell of a tile for removal, if the cell hasn't
+//   been reached yet. Offers hold the edge in the high 32 bits and the
+//   cell's index within the tile in the low 32 bits.
 //======================================================================
-static void
-Add_To_Available(Cell *cell, int *available, int &num_available)
+static inline void
+Offer_Edge(const uint32_t edge, const uint32_t local,
+			  const std::vector<uint64_t> &visited, std::vector<uint64_t> &available)
 //======================================================================
 {
-	int i, j;
-
-	// Add edges from cell to the set that are available for removal to
-	// grow the maze.
+	if ( ! ( visited[local >> 6] & ( 1ull << ( local & 63 ) ) ) )
+		available.push_back(( (uint64_t)edge << 32 ) | local);
+}
 
-	for ( i = 0 ; i < 4 ; i++ ){
-		Cell    *neighbor = cell->edges[i]->Neighbor(cell);
 
-		if ( neighbor && ! neighbor->counter )	{
-			int candidate = cell->edges[i]->index;
-			for ( j = 0 ; j < num_available ; j++ )
-				if ( candidate == available[j] ) {
-					printf("Breaking early\n");
-					break;
-			}
-			if ( j == num_available )  {
-				available[num_available] = candidate;
-				num_available++;
-			}
-		}
+//**********************************************************************
+//
+// * Grow a maze inside one tile of w by h cells, whose first cell is at
+//   (x0, y0). Starting from a random cell, keep removing a random offered
+//   edge that leads to a cell not yet reached, until every cell of the
+//   tile is reached. visited and available are scratch space.
+//======================================================================
+static void
+Grow_Tile(MazeTables &t, const uint32_t num_x,
+			 const uint32_t x0, const uint32_t y0, const uint32_t w, const uint32_t h,
+			 Maze_Random &random,
+			 std::vector<uint64_t> &visited, std::vector<uint64_t> &available)
+//======================================================================
+{
+	uint32_t	local = random.Below(w * h);
+	uint32_t	num_visited = 0;
+
+	std::fill(visited.begin(), visited.end(), 0);
+	available.clear();
+
+	while ( true ) {
+		uint32_t	x = local % w;
+		uint32_t	y = local / w;
+		uint32_t	cell = ( y0 + y ) * num_x + x0 + x;
+		uint64_t	offer;
+
+		visited[local >> 6] |= 1ull << ( local & 63 );
+		if ( ++num_visited == w * h )
+			break;
+
+		if ( x + 1 < w )
+			Offer_Edge(t.cell_edge[Cell::PLUS_X][cell], local + 1, visited, available);
+		if ( y + 1 < h )
+			Offer_Edge(t.cell_edge[Cell::PLUS_Y][cell], local + w, visited, available);
+		if ( x > 0 )
+			Offer_Edge(t.cell_edge[Cell::MINUS_X][cell], local - 1, visited, available);
+		if ( y > 0 )
+			Offer_Edge(t.cell_edge[Cell::MINUS_Y][cell], local - w, visited, available);
+
+		// Take random offers until one reaches a new cell. The tile is
+		// connected, so one always does before the offers run out.
+		do {
+			uint32_t	index = random.Below((uint32_t)available.size());
+
+			offer = available[index];
+			available[index] = available.back();
+			available.pop_back();
+			local = (uint32_t)offer;
+		} while ( visited[local >> 6] & ( 1ull << ( local & 63 ) ) );
+
+		t.edge_opaque[offer >> 32] = 0;
 	}
+}
 
-	cell->counter = 1;
+
+//**********************************************************************
+//
+// * Find the tile at the root of i's tree, halving the path on the way.
+//======================================================================
+static uint32_t
+Find_Root(std::vector<uint32_t> &parent, uint32_t i)
+//======================================================================
+{
+	while ( parent[i] != i ) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
 }
 
 
@@ -364,113 +774,140 @@ Add_To_Available(Cell *cell, int *available, int &num_available)
 // * Grow a maze by removing candidate edges until all the cells are
 //   connected. The edges are not actually removed, they are just made
 //   transparent.
+//
+//   The maze is grown separately in square tiles, spread across all the
+//   hardware threads. The tiles are then joined up along a random
+//   spanning tree of the tiles, by opening one random edge on the border
+//   of each pair of tiles in the tree. The result depends only on the
+//   seed, not on the number of threads.
 //======================================================================
 void Maze::
-Build_Maze()
+Build_Maze(const int num_x, const int num_y, const uint32_t seed)
 //======================================================================
 {
-	Cell    *to_expand;
-	int     index;
-	int     *available = new int[num_edges];
-	int     num_available = 0;
-	int	    num_visited;
-	int	    i;
-
-	srand(time(NULL));
-
-	// Choose a random starting cell.
-	index = (int)floor((rand() / (float)RAND_MAX) * num_cells);
-	to_expand = cells[index];
-	Add_To_Available(to_expand, available, num_available);
-	num_visited = 1;
-
-	// Join cells up by making edges opaque.
-	while ( num_visited < num_cells && num_available > 0 ) {
-		int ei;
-
-		index = (int)floor((rand() / (float)RAND_MAX) * num_available);
-		to_expand = NULL;
-
-		ei = available[index];
+	const uint32_t	nx = num_x;
+	const uint32_t	ny = num_y;
+	const uint32_t	tiles_x = ( nx + TILE_SIZE - 1 ) / TILE_SIZE;
+	const uint32_t	tiles_y = ( ny + TILE_SIZE - 1 ) / TILE_SIZE;
+	const uint32_t	num_tiles = tiles_x * tiles_y;
+	Work_Chunks		tiles(num_tiles, 1);
+
+	Run_On_All_Threads([&]() {
+		std::vector<uint64_t>	visited(( TILE_SIZE * TILE_SIZE + 63 ) / 64);
+		std::vector<uint64_t>	available;
+		uint64_t					first, last;
+
+		while ( tiles.Next(first, last) ) {
+			uint32_t		tile = (uint32_t)first;
+			uint32_t		x0 = tile % tiles_x * TILE_SIZE;
+			uint32_t		y0 = tile / tiles_x * TILE_SIZE;
+			Maze_Random	random(seed, TILE_STREAM + tile);
+
+			Grow_Tile(tables, nx, x0, y0, std::min(TILE_SIZE, nx - x0),
+						 std::min(TILE_SIZE, ny - y0), random, visited, available);
+		}
+	});
+
+	// Every pair of neighboring tiles, as the lower tile times 2, plus 1 if
+	// the other tile is in the +y direction.
+	std::vector<uint64_t>	joins;
+	std::vector<uint32_t>	parent(num_tiles);
+	Maze_Random				random(seed, STITCH_STREAM);
+	uint32_t					i;
+
+	for ( i = 0 ; i < num_tiles ; i++ ) {
+		parent[i] = i;
+		if ( i % tiles_x + 1 < tiles_x )
+			joins.push_back((uint64_t)i << 1);
+		if ( i / tiles_x + 1 < tiles_y )
+			joins.push_back(( (uint64_t)i << 1 ) | 1);
+	}
 
-		if ( edges[ei]->neighbors[0] && 
-			 !edges[ei]->neighbors[0]->counter )
-			to_expand = edges[ei]->neighbors[0];
-		else if ( edges[ei]->neighbors[1] && 
-			 !edges[ei]->neighbors[1]->counter )
-			to_expand = edges[ei]->neighbors[1];
+	// Shuffle the pairs, then keep each one that joins two groups of tiles
+	// that aren't joined yet.
+	for ( i = (uint32_t)joins.size() ; i > 1 ; i-- )
+		std::swap(joins[i - 1], joins[random.Below(i)]);
+
+	for ( i = 0 ; i < joins.size() ; i++ ) {
+		uint32_t	tile = (uint32_t)( joins[i] >> 1 );
+		bool		plus_y = ( joins[i] & 1 ) != 0;
+		uint32_t	a = Find_Root(parent, tile);
+		uint32_t	b = Find_Root(parent, plus_y ? tile + tiles_x : tile + 1);
+		uint32_t	x0 = tile % tiles_x * TILE_SIZE;
+		uint32_t	y0 = tile / tiles_x * TILE_SIZE;
+		uint32_t	cell;
+
+		if ( a == b )
+			continue;
+		parent[a] = b;
 
-		if ( to_expand ) {
-			edges[ei]->opaque = false;
-			Add_To_Available(to_expand, available, num_available);
-			num_visited++;
+		// Open a random edge on the border, from the lower tile's side.
+		if ( plus_y ) {
+			cell = ( y0 + TILE_SIZE - 1 ) * nx + x0 +
+					 random.Below(std::min(TILE_SIZE, nx - x0));
+			tables.edge_opaque[tables.cell_edge[Cell::PLUS_Y][cell]] = 0;
+		}
+		else {
+			cell = ( y0 + random.Below(std::min(TILE_SIZE, ny - y0)) ) * nx +
+					 x0 + TILE_SIZE - 1;
+			tables.edge_opaque[tables.cell_edge[Cell::PLUS_X][cell]] = 0;
 		}
-
-		available[index] = available[num_available-1];
-		num_available--;
 	}
-
-	for ( i = 0 ; i < num_cells ; i++ )
-		cells[i]->counter = 0;
 }
 
 
 //**********************************************************************
 //
 // * Go through all the vertices looking for the minimum and maximum
-//   extents of the maze.
+//   extents of the maze, then build the grid over them.
 //======================================================================
 void Maze::
 Set_Extents(void)
 //======================================================================
 {
-	int i;
-
-	min_xp = vertices[0]->posn[Vertex::X];
-	max_xp = vertices[0]->posn[Vertex::X];
-	min_yp = vertices[0]->posn[Vertex::Y];
-	max_yp = vertices[0]->posn[Vertex::Y];
-	for ( i = 1 ; i < num_vertices ; i++ ) {
-		if ( vertices[i]->posn[Vertex::X] > max_xp )
-			 max_xp = vertices[i]->posn[Vertex::X];
-		if ( vertices[i]->posn[Vertex::X] < min_xp )
-			 min_xp = vertices[i]->posn[Vertex::X];
-		if ( vertices[i]->posn[Vertex::Y] > max_yp )
-			 max_yp = vertices[i]->posn[Vertex::Y];
-		if ( vertices[i]->posn[Vertex::Y] < min_yp )
-			 min_yp = vertices[i]->posn[Vertex::Y];
+	const float	*xs = tables.vertex_posn[Vertex::X];
+	const float	*ys = tables.vertex_posn[Vertex::Y];
+	uint32_t	i;
+
+	min_xp = max_xp = xs[0];
+	min_yp = max_yp = ys[0];
+	for ( i = 1 ; i < tables.num_vertices ; i++ ) {
+		if ( xs[i] > max_xp )
+			 max_xp = xs[i];
+		if ( xs[i] < min_xp )
+			 min_xp = xs[i];
+		if ( ys[i] > max_yp )
+			 max_yp = ys[i];
+		if ( ys[i] < min_yp )
+			 min_yp = ys[i];
     }
+
+	// Bucket the cells over the extents, for finding the cell holding a
+	// point.
+	grid.Build(tables, min_xp, min_yp, max_xp, max_yp);
 }
 
 
 //**********************************************************************
 //
-// * Figure out which cell the view is in, using seed_cell as an
-//   initial guess. This procedure works by repeatedly checking
-//   whether the viewpoint is in the current cell. If it is, we're
-//   done. If not, Point_In_Cell returns in new_cell the next cell
-//   to test. The new cell is the one on the other side of an edge
-//   that the point is "outside" (meaning that it might be inside the
-//   new cell).
+// * Figure out which cell the view is in, by looking it up in the grid.
+//   This takes the same time wherever the viewer is.
 //======================================================================
 void Maze::
-Find_View_Cell(Cell *seed_cell)
+Find_View_Cell(void)
 //======================================================================
 {
-	Cell    *new_cell;
+	uint32_t	cell = MazeTables::NO_INDEX;
 
-	// 
-	while ( ! ( seed_cell->Point_In_Cell(viewer_posn[X], viewer_posn[Y],
-													 viewer_posn[Z], new_cell) ) ) {
-		if ( new_cell == 0 ) {
-			// The viewer is outside the top or bottom of the maze.
-			throw new MazeException("Maze: View not in maze\n");
-		}
+	if ( viewer_posn[Z] > -1.0f && viewer_posn[Z] < 1.0f )
+		cell = grid.Locate(tables, viewer_posn[X], viewer_posn[Y]);
 
-		seed_cell = new_cell;
-    }
-    
-    view_cell = seed_cell;
+	if ( cell == MazeTables::NO_INDEX ) {
+		// The viewer is outside the maze, or exactly on an edge.
+		throw new MazeException("Maze: View not in maze\n");
+	}
+
+	view_cell = Get_Cell(cell);
 }
 
 
@@ -484,7 +921,7 @@ void Maze::
 Move_View_Posn(const float dx, const float dy, const float dz)
 //======================================================================
 {
-	Cell    *new_cell;
+	Cell    new_cell;
 	float   xs, ys, zs, xe, ye, ze;
 
 	// Move the viewer by the given amount. This does collision testing to
@@ -510,9 +947,9 @@ Move_View_Posn(const float dx, const float dy, const float dz)
 	// a transparent edge (through which it can pass), then it clips
 	// the motion segment so that it _starts_ at the transparent edge,
 	// and it returns the cell the viewer is entering. We keep going
-	// until Clip_To_Cell returns NULL, meaning we've done as much of
-	// the motion as is possible without passing through walls.
-	while ( ( new_cell = view_cell->Clip_To_Cell(xs, ys, xe, ye, BUFFER) ) )
+	// until Clip_To_Cell returns an invalid cell, meaning we've done as much
+	// of the motion as is possible without passing through walls.
+	while ( ( new_cell = view_cell.Clip_To_Cell(xs, ys, xe, ye, BUFFER) ).Valid() )
 		view_cell = new_cell;
 
 	// The viewer is at the end of the motion segment, which may have
@@ -550,7 +987,7 @@ Set_View_Posn(float x, float y, float z)
 	viewer_posn[Z] = z;
 
 	// Figure out which cell we're in.
-	Find_View_Cell(cells[0]);
+	Find_View_Cell();
 }
 
 
@@ -577,39 +1014,54 @@ Set_View_FOV(const float f)
 	viewer_fov = f;
 }
 
+//**********************************************************************
+//
+// * Return the half-plane on the right of the line from (xs,zs) to (xe,ze)
+//   in view space.
+//======================================================================
+Maze::Half_Plane Maze::
+Right_Of(const float xs, const float zs, const float xe, const float ze)
+//======================================================================
+{
+	Half_Plane	h;
+
+	h.a = ze - zs;
+	h.b = xs - xe;
+	h.c = zs * xe - xs * ze;
+
+	return h;
+}
+
+
+//**********************************************************************
+//
+// * Clip a wall from (sx,sz) to (ex,ez) in view space to the inside of a
+//   half-plane. Returns false if no part of the wall is strictly inside.
+//======================================================================
 bool Maze::
-clipping(LineSeg frustum_edge, glm::vec4& start, glm::vec4& end) {
-
-	if (frustum_edge.Point_Side(start[0], start[2]) == Edge::RIGHT) {
-		if (frustum_edge.Point_Side(end[0], end[2]) == Edge::LEFT) {
-			// end point is outside the frustum
-			// need to get the new end point
-			LineSeg wall(start[0], start[2], end[0], end[2]);
-			float percent = wall.Cross_Param(frustum_edge);
-			float newX = start[0] + (end[0] - start[0]) * percent;
-			float newZ = start[2] + (end[2] - start[2]) * percent;
-
-			end[0] = newX;
-			end[2] = newZ;
+Clip_Wall(const Half_Plane& h, float& sx, float& sz, float& ex, float& ez)
+//======================================================================
+{
+	float	s = h.a * sx + h.b * sz + h.c;
+	float	e = h.a * ex + h.b * ez + h.c;
+	float	t;
+
+	if ( s > 0.0f ) {
+		if ( e < 0.0f ) {
+			// The end is outside, so move it to the crossing.
+			t = s / ( s - e );
+			ex = sx + ( ex - sx ) * t;
+			ez = sz + ( ez - sz ) * t;
 		}
 	}
-	else if (frustum_edge.Point_Side(end[0], end[2]) == Edge::RIGHT) {
-		// start point is outside the frustum
-		// need to get the new start point
-		LineSeg wall(start[0], start[2], end[0], end[2]);
-		float percent = wall.Cross_Param(frustum_edge);
-		float newX = start[0] + (end[0] - start[0]) * percent;
-		float newZ = start[2] + (end[2] - start[2]) * percent;
-
-		start[0] = newX;
-		start[2] = newZ;
-
+	else if ( e > 0.0f ) {
+		// The start is outside, so move it to the crossing.
+		t = s / ( s - e );
+		sx = sx + ( ex - sx ) * t;
+		sz = sz + ( ez - sz ) * t;
 	}
-	else {
-		// the wall is outside the frustum
-		// no need to draw the wall
+	else
 		return false;
-	}
 
 	return true;
 }
@@ -626,7 +1078,7 @@ Draw_Map(int min_x, int min_y, int max_x, int max_y)
 {
 	int	    height;
 	float   scale_x, scale_y, scale;
-	int	    i;
+	uint32_t	i;
 
 	// Figure out scaling factors and the effective height of the window.
 	scale_x = ( max_x - min_x - 10 ) / ( max_xp - min_xp );
@@ -638,18 +1090,19 @@ Draw_Map(int min_x, int min_y, int max_x, int max_y)
 	min_y += 5;
 
 	// Draw all the opaque edges.
-	for ( i = 0 ; i < num_edges ; i++ )
-		if ( edges[i]->opaque )	{
+	for ( i = 0 ; i < tables.num_edges ; i++ )
+		if ( tables.edge_opaque[i] )	{
 			float   x1, y1, x2, y2;
+			float	*color = tables.edge_color + 3 * (size_t)i;
 
-			x1 = edges[i]->endpoints[Edge::START]->posn[Vertex::X];
-			y1 = edges[i]->endpoints[Edge::START]->posn[Vertex::Y];
-			x2 = edges[i]->endpoints[Edge::END]->posn[Vertex::X];
-			y2 = edges[i]->endpoints[Edge::END]->posn[Vertex::Y];
+			x1 = tables.vertex_posn[Vertex::X][tables.edge_vertex[Edge::START][i]];
+			y1 = tables.vertex_posn[Vertex::Y][tables.edge_vertex[Edge::START][i]];
+			x2 = tables.vertex_posn[Vertex::X][tables.edge_vertex[Edge::END][i]];
+			y2 = tables.vertex_posn[Vertex::Y][tables.edge_vertex[Edge::END][i]];
 
-			fl_color((unsigned char)floor(edges[i]->color[0] * 255.0),
-					 (unsigned char)floor(edges[i]->color[1] * 255.0),
-					 (unsigned char)floor(edges[i]->color[2] * 255.0));
+			fl_color((unsigned char)floor(color[0] * 255.0),
+					 (unsigned char)floor(color[1] * 255.0),
+					 (unsigned char)floor(color[2] * 255.0));
 			fl_line_style(FL_SOLID);
 			fl_line(min_x + (int)floor((x1 - min_xp) * scale),
 					  min_y + height - (int)floor((y1 - min_yp) * scale),
@@ -658,112 +1111,243 @@ Draw_Map(int min_x, int min_y, int max_x, int max_y)
 		}
 }
 
+//**********************************************************************
+//
+// * Draws the first-person view of the maze. It is passed the focal distance.
+//   Cells are drawn by walking through transparent edges, with an explicit
+//   stack of cells, each holding the frustum it is seen through: a left
+//   and right half-plane through the eye and a front half-plane through
+//   the edge it was entered by. Opaque walls are clipped to all three and
+//   added to the view's vertex array. Transparent edges narrow the frustum
+//   to the edge and push the cell behind them, unless it has already been
+//   drawn this frame. The backend draws the whole array at the end.
+//   The visible sets aren't consulted: every cell the walk reaches is
+//   already in the view cell's set, and the walls carry no depth, so the
+//   set's cells can't be drawn in any order without the walk.
+//======================================================================
 void Maze::
-Draw_Cell(Cell* current_cell, LineSeg left_frustrum, LineSeg right_frustrum, glm::mat4x4 view, glm::mat4x4 perspective) {
-	current_cell->footprint = true;
-	LineSeg front(right_frustrum.end[0], right_frustrum.end[1], left_frustrum.start[0], left_frustrum.start[1]);
-
-	for (int i = 0; i < 4; i++) {
-		glm::vec4 start(
-			current_cell->edges[i]->endpoints[Edge::START]->posn[Y],
-			1.0,
-			current_cell->edges[i]->endpoints[Edge::START]->posn[X],
-			1.0
-		);
-
-		glm::vec4 end(
-			current_cell->edges[i]->endpoints[Edge::END]->posn[Y],
-			1.0,
-			current_cell->edges[i]->endpoints[Edge::END]->posn[X],
-			1.0
-		);
-
-		// translate to view space
-		start = view * start;
-		end = view * end;
-
-		// clip the wall
-		if (!clipping(left_frustrum, start, end) || !clipping(right_frustrum, start, end))
-			continue;
+Draw_View(const float focal_dist, glm::mat4x4 view, glm::mat4x4 perspective)
+//======================================================================
+{
+	// Cells are stamped with the frame they were last drawn in, so nothing
+	// needs clearing per frame unless the counter wraps around.
+	if ( ++frame_num == 0 ) {
+		cell_frame.assign(tables.num_cells, 0);
+		frame_num = 1;
+	}
 
-		if (current_cell->edges[i]->opaque) {
-			// opaque wall
+	View_Backend	*out = backend ? backend : &gl_backend;
 
-			if (!clipping(front, start, end))
-				continue;
-			
-			// translate to canonical view volume
-			start = perspective * start;
-			end = perspective * end;
-
-			if (start[Z] > this->n || end[Z] > this->n) {
-
-				// if in the front, draw wall
-				glBegin(GL_POLYGON);
-				glColor3fv(current_cell->edges[i]->color);
-				glVertex2f(start[X] / start[Z], start[Y] / start[Z]);
-				glVertex2f(end[X] / end[Z], end[Y] / end[Z]);
-				glVertex2f(end[X] / end[Z], -end[Y] / end[Z]);
-				glVertex2f(start[X] / start[Z], -start[Y] / start[Z]);
-				glEnd();
-			}
+	memset(&view_stats, 0, sizeof(view_stats));
+	view_vertices.clear();
+
+	if ( ! view_cell.Valid() ) {
+		out->Draw_Walls(NULL, 0);
+		return;
+	}
 
+	// The viewer only turns about the vertical, so the view transform of a
+	// wall end is a 2x2 rotation and a translation of its ground position,
+	// and the wall top is at a fixed height. Maze x goes in view z and maze
+	// y in view x, with the wall top at 1.
+	float	rot_xx = view[2][0], rot_xy = view[0][0];
+	float	rot_zx = view[2][2], rot_zy = view[0][2];
+	float	trans_x = view[1][0] + view[3][0];
+	float	trans_z = view[1][2] + view[3][2];
+	float	height = view[1][1] + view[3][1];
+
+	// The view frustum. Its sides go through the eye, at half the field of
+	// view either side of -z, and its front is the near plane.
+	float	tan_half = (float)tan(To_Radians(viewer_fov * 0.5f));
+	Portal_Frame	frame;
+
+	frame.cell = view_cell.Index();
+	frame.next_edge = 0;
+	frame.left = Right_Of(0.0f, 0.0f, tan_half, -1.0f);
+	frame.right = Right_Of(0.0f, 0.0f, tan_half, 1.0f);
+	frame.front = Right_Of(-n * tan_half, -n, n * tan_half, -n);
+
+	cell_frame[frame.cell] = frame_num;
+	portal_stack.clear();
+	portal_stack.push_back(frame);
+	view_stats.cells++;
+
+	while ( ! portal_stack.empty() ) {
+		Portal_Frame	&top = portal_stack.back();
+
+		// Done with every edge of this cell, so go back to the cell it was
+		// seen from.
+		if ( top.next_edge == 4 ) {
+			portal_stack.pop_back();
+			continue;
 		}
-		else {
-			// transparent wall
 
-			if (current_cell->edges[i]->Neighbor(current_cell) != NULL) {
-				// recursive when there is another cell behind
+		uint32_t	cell = top.cell;
+		uint32_t	e = tables.cell_edge[top.next_edge++][cell];
 
-				float Lx = 0.0, Ly = 0.0, Rx = 0.0, Ry = 0.0;
-				LineSeg center_frustum(0.0, 0.0, (start[X] + end[X]) / 2, (start[Z] + end[Z]) / 2);
+		if ( e == MazeTables::NO_INDEX )
+			continue;
 
-				// whole wall in the frustum, in 2 condition
-				if (center_frustum.Point_Side(start[X], start[Z]) == Edge::RIGHT && center_frustum.Point_Side(end[X], end[Z]) == Edge::LEFT) {
-					Lx = end[X];
-					Ly = end[Z];
-					Rx = start[X];
-					Ry = start[Z];
-				}
-				else if (center_frustum.Point_Side(start[X], start[Z]) == Edge::LEFT && center_frustum.Point_Side(end[X], end[Z]) == Edge::RIGHT) {
-					Lx = start[X];
-					Ly = start[Z];
-					Rx = end[X];
-					Ry = end[Z];
-				}
+		uint32_t	vs = tables.edge_vertex[Edge::START][e];
+		uint32_t	ve = tables.edge_vertex[Edge::END][e];
+		float		x = tables.vertex_posn[Vertex::X][vs];
+		float		y = tables.vertex_posn[Vertex::Y][vs];
+		float		sx = rot_xx * x + rot_xy * y + trans_x;
+		float		sz = rot_zx * x + rot_zy * y + trans_z;
 
-				// new frustum
-				LineSeg newL(Lx, Ly, Lx / Ly * -this->f, -this->f);
-				LineSeg newR(Rx / Ry * -this->f, -this->f, Rx, Ry);
+		x = tables.vertex_posn[Vertex::X][ve];
+		y = tables.vertex_posn[Vertex::Y][ve];
 
-				if (!current_cell->edges[i]->Neighbor(current_cell)->footprint) {
-					Draw_Cell(current_cell->edges[i]->Neighbor(current_cell), newL, newR, view, perspective);
-				}
+		float		ex = rot_xx * x + rot_xy * y + trans_x;
+		float		ez = rot_zx * x + rot_zy * y + trans_z;
+
+		// Clip the edge to the sides of the frustum.
+		view_stats.clips++;
+		if ( ! Clip_Wall(top.left, sx, sz, ex, ez) )
+			continue;
+		view_stats.clips++;
+		if ( ! Clip_Wall(top.right, sx, sz, ex, ez) )
+			continue;
+
+		if ( tables.edge_opaque[e] ) {
+			// An opaque wall is drawn if any of it is beyond the front.
+			view_stats.clips++;
+			if ( ! Clip_Wall(top.front, sx, sz, ex, ez) )
+				continue;
+
+			// Project to the canonical view volume.
+			glm::vec4	start = perspective * glm::vec4(sx, height, sz, 1.0f);
+			glm::vec4	end = perspective * glm::vec4(ex, height, ez, 1.0f);
+
+			if ( start[Z] > n || end[Z] > n ) {
+				const float	*color = tables.edge_color + 3 * (size_t)e;
+				float			top_sx = start[X] / start[Z];
+				float			top_sy = start[Y] / start[Z];
+				float			top_ex = end[X] / end[Z];
+				float			top_ey = end[Y] / end[Z];
+				View_Vertex	quad[4] = {
+					{ top_sx, top_sy, color[0], color[1], color[2] },
+					{ top_ex, top_ey, color[0], color[1], color[2] },
+					{ top_ex, -top_ey, color[0], color[1], color[2] },
+					{ top_sx, -top_sy, color[0], color[1], color[2] }
+				};
+
+				view_vertices.insert(view_vertices.end(), quad, quad + 4);
+				view_stats.walls++;
 			}
+			continue;
 		}
+
+		// A transparent edge. Look through it if there is an undrawn cell
+		// behind it.
+		uint32_t	neighbor = tables.edge_cell[Edge::LEFT][e] == cell ?
+									tables.edge_cell[Edge::RIGHT][e] :
+									tables.edge_cell[Edge::LEFT][e];
+
+		if ( neighbor == MazeTables::NO_INDEX || cell_frame[neighbor] == frame_num )
+			continue;
+
+		// Find which end is on the left of the line from the eye through the
+		// middle of the edge. An edge seen end on hides the cell behind it.
+		float		mx = ( sx + ex ) * 0.5f;
+		float		mz = ( sz + ez ) * 0.5f;
+		float		side_s = mx * sz - mz * sx;
+		float		side_e = mx * ez - mz * ex;
+		float		lx, lz, rx, rz;
+
+		if ( side_s < 0.0f && side_e > 0.0f ) {
+			lx = ex;  lz = ez;
+			rx = sx;  rz = sz;
+		}
+		else if ( side_s > 0.0f && side_e < 0.0f ) {
+			lx = sx;  lz = sz;
+			rx = ex;  rz = ez;
+		}
+		else
+			continue;
+
+		frame.cell = neighbor;
+		frame.next_edge = 0;
+		frame.left = Right_Of(0.0f, 0.0f, lx, lz);
+		frame.right = Right_Of(0.0f, 0.0f, -rx, -rz);
+		frame.front = Right_Of(rx, rz, lx, lz);
+
+		cell_frame[neighbor] = frame_num;
+		portal_stack.push_back(frame);
+		view_stats.cells++;
 	}
+
+	// Draw every wall at once.
+	out->Draw_Walls(view_vertices.empty() ? NULL : &view_vertices[0],
+						 view_vertices.size());
 }
 
+
 //**********************************************************************
 //
-// * Draws the first-person view of the maze. It is passed the focal distance.
-//   THIS IS THE FUINCTION YOU SHOULD MODIFY.
+// * Build the view and perspective matrices that Draw_View takes, for an
+//   image with the given width over height.
 //======================================================================
 void Maze::
-Draw_View(const float focal_dist, glm::mat4x4 view, glm::mat4x4 perspective)
+View_Matrices(const float aspect, glm::mat4x4 &view,
+				  glm::mat4x4 &perspective) const
 //======================================================================
 {
-	frame_num++;
-	glDisable(GL_DEPTH_TEST);
-
-	for (int i = 0; i < this->num_cells; i++) {
-		this->cells[i]->footprint = false;
-	}
-
-	LineSeg left_frustrum(this->n * tan(To_Radians(this->viewer_fov * 0.5f)), -this->n, this->f * tan(To_Radians(this->viewer_fov * 0.5f)), -this->f);
-	LineSeg right_frustrum(-this->f * tan(To_Radians(this->viewer_fov * 0.5f)), -this->f, -this->n * tan(To_Radians(this->viewer_fov * 0.5f)), -this->n);
-
-	Draw_Cell(this->view_cell, left_frustrum, right_frustrum, view, perspective);
+	// perspective projection		
+	float t = n * tan(To_Radians(viewer_fov) * 0.5);					//top
+	float r = n * tan(To_Radians(viewer_fov * aspect) * 0.5);		//right
+
+	float perspective_matrix[16] = {
+		n / r, 0.0, 0.0, 0.0,
+		0.0, n / t, 0.0, 0.0,
+		0.0, 0.0, (n + f) / (n - f), -1.0,
+		0.0, 0.0, 2 * n * f / (n - f), 0.0
+	};
+	
+	// model to view
+	float eye[3] = {
+	viewer_posn[Y],
+	0.0f,
+	viewer_posn[X]
+	};
+
+	float center[3] = {
+		eye[X] + sin(To_Radians(viewer_dir)),
+		eye[Y],
+		eye[Z] + cos(To_Radians(viewer_dir))
+	};
+
+	glm::vec3 up(0.0, 1.0, 0.0);
+
+	float length = sqrt(pow((eye[X] - center[X]), 2) + pow((eye[Y] - center[Y]), 2) + pow((eye[Z] - center[Z]), 2));
+
+	glm::vec3 w(
+		eye[X] - center[X] / length,
+		eye[Y] - center[Y] / length,
+		eye[Z] - center[Z] / length);
+
+	glm::vec3 u = glm::cross(up, w);
+	glm::vec3 v = glm::cross(w, u);
+
+	float rotation_matrix[16] = {
+		u[X], v[X], w[X], 0.0,
+		u[Y], v[Y], w[Y], 0.0,
+		u[Z], v[Z], w[Z], 0.0,
+		0.0, 0.0, 0.0, 1.0
+	};
+
+	float translation_matrix[16] = {
+		1.0, 0.0, 0.0, 0.0,
+		0.0, 1.0, 0.0, 0.0,
+		0.0, 0.0, 1.0, 0.0,
+		-eye[X], -eye[Y], -eye[Z], 1.0
+	};
+
+	// matrix to glm
+	glm::mat4x4 rotation = glm::make_mat4(rotation_matrix);
+	glm::mat4x4 translation = glm::make_mat4(translation_matrix);
+	view = rotation * translation;
+	perspective = glm::make_mat4(perspective_matrix);
 }
 
 
@@ -839,23 +1423,26 @@ Draw_Neighbors(int min_x, int min_y, int max_x, int max_y)
 	min_y += 5;
 
 	for ( i = 0 ; i < 4 ; i++ )   {
-		Cell	*neighbor = view_cell->edges[i]->Neighbor(view_cell);
+		if ( ! view_cell.Get_Edge(i).Valid() )
+			continue;
+
+		Cell	neighbor = view_cell.Get_Edge(i).Neighbor(view_cell);
 
-		if ( neighbor ){
+		if ( neighbor.Valid() ){
 			for ( j = 0 ; j < 4 ; j++ ){
-				Edge    *e = neighbor->edges[j];
+				Edge    e = neighbor.Get_Edge(j);
 
-				if ( e->opaque )	{
+				if ( e.Valid() && e.Opaque() )	{
 					float   x1, y1, x2, y2;
 
-					x1 = e->endpoints[Edge::START]->posn[Vertex::X];
-					y1 = e->endpoints[Edge::START]->posn[Vertex::Y];
-					x2 = e->endpoints[Edge::END]->posn[Vertex::X];
-					y2 = e->endpoints[Edge::END]->posn[Vertex::Y];
+					x1 = e.Endpoint(Edge::START).Posn(Vertex::X);
+					y1 = e.Endpoint(Edge::START).Posn(Vertex::Y);
+					x2 = e.Endpoint(Edge::END).Posn(Vertex::X);
+					y2 = e.Endpoint(Edge::END).Posn(Vertex::Y);
 
-					fl_color((unsigned char)floor(e->color[0] * 255.0),
-							  (unsigned char)floor(e->color[1] * 255.0),
-							  (unsigned char)floor(e->color[2] * 255.0));
+					fl_color((unsigned char)floor(e.Color()[0] * 255.0),
+							  (unsigned char)floor(e.Color()[1] * 255.0),
+							  (unsigned char)floor(e.Color()[2] * 255.0));
 					fl_line_style(FL_SOLID);
 					fl_line( min_x + (int)floor((x1 - min_xp) * scale),
 							 min_y + height - (int)floor((y1 - min_yp) * scale),
@@ -865,19 +1452,19 @@ Draw_Neighbors(int min_x, int min_y, int max_x, int max_y)
 			}
 		}
 		else {
-			Edge    *e = view_cell->edges[i];
+			Edge    e = view_cell.Get_Edge(i);
 
-			if ( e->opaque ){
+			if ( e.Opaque() ){
 				float   x1, y1, x2, y2;
 
-				x1 = e->endpoints[Edge::START]->posn[Vertex::X];
-				y1 = e->endpoints[Edge::START]->posn[Vertex::Y];
-				x2 = e->endpoints[Edge::END]->posn[Vertex::X];
-				y2 = e->endpoints[Edge::END]->posn[Vertex::Y];
+				x1 = e.Endpoint(Edge::START).Posn(Vertex::X);
+				y1 = e.Endpoint(Edge::START).Posn(Vertex::Y);
+				x2 = e.Endpoint(Edge::END).Posn(Vertex::X);
+				y2 = e.Endpoint(Edge::END).Posn(Vertex::Y);
 
-				fl_color((unsigned char)floor(e->color[0] * 255.0),
-							 (unsigned char)floor(e->color[1] * 255.0),
-							 (unsigned char)floor(e->color[2] * 255.0));
+				fl_color((unsigned char)floor(e.Color()[0] * 255.0),
+							 (unsigned char)floor(e.Color()[1] * 255.0),
+							 (unsigned char)floor(e.Color()[2] * 255.0));
 				fl_line_style(FL_SOLID);
 				fl_line(min_x + (int)floor((x1 - min_xp) * scale),
 							min_y + height - (int)floor((y1 - min_yp) * scale),
@@ -894,49 +1481,137 @@ Draw_Neighbors(int min_x, int min_y, int max_x, int max_y)
 // * Save the maze to a file of the given name.
 //======================================================================
 bool Maze::
-Save(const char *filename)
+Save(const char *filename, const bool binary)
 //======================================================================
 {
-	FILE    *f = fopen(filename, "w");
-	int	    i;
+	if ( binary )
+		return Save_Binary(filename) && Save_PVS(filename);
+
+	FILE    *f;
+	uint32_t	i;
+
+	// The tables may be mapped from this very file, which is about to be
+	// truncated.
+	tables.Unmap();
+	f = fopen(filename, "w");
 
 	// Dump everything to a file of the given name. Returns false if it
-	// couldn't open the file. True otherwise.
+	// couldn't open the file. True otherwise. Missing cells and edges are
+	// written as -1.
 
 	if ( ! f )  {
 		return false;
    }
 
-	fprintf(f, "%d\n", num_vertices);
-	for ( i = 0 ; i < num_vertices ; i++ )
-		fprintf(f, "%g %g\n", vertices[i]->posn[Vertex::X],
-			      vertices[i]->posn[Vertex::Y]);
-
-		fprintf(f, "%d\n", num_edges);
-	for ( i = 0 ; i < num_edges ; i++ )
-	fprintf(f, "%d %d %d %d %d %g %g %g\n",
-				edges[i]->endpoints[Edge::START]->index,
-				edges[i]->endpoints[Edge::END]->index,
-				edges[i]->neighbors[Edge::LEFT] ?
-				edges[i]->neighbors[Edge::LEFT]->index : -1,
-				edges[i]->neighbors[Edge::RIGHT] ?
-				edges[i]->neighbors[Edge::RIGHT]->index : -1,
-				edges[i]->opaque ? 1 : 0,
-				edges[i]->color[0], edges[i]->color[1], edges[i]->color[2]);
-
-	fprintf(f, "%d\n", num_cells);
-	for ( i = 0 ; i < num_cells ; i++ )
+	fprintf(f, "%u\n", tables.num_vertices);
+	for ( i = 0 ; i < tables.num_vertices ; i++ )
+		fprintf(f, "%g %g\n", tables.vertex_posn[Vertex::X][i],
+			      tables.vertex_posn[Vertex::Y][i]);
+
+	fprintf(f, "%u\n", tables.num_edges);
+	for ( i = 0 ; i < tables.num_edges ; i++ )
+		fprintf(f, "%d %d %d %d %d %g %g %g\n",
+				(int)tables.edge_vertex[Edge::START][i],
+				(int)tables.edge_vertex[Edge::END][i],
+				(int)tables.edge_cell[Edge::LEFT][i],
+				(int)tables.edge_cell[Edge::RIGHT][i],
+				tables.edge_opaque[i] ? 1 : 0,
+				tables.edge_color[3 * i], tables.edge_color[3 * i + 1],
+				tables.edge_color[3 * i + 2]);
+
+	fprintf(f, "%u\n", tables.num_cells);
+	for ( i = 0 ; i < tables.num_cells ; i++ )
 		fprintf(f, "%d %d %d %d\n",
-					cells[i]->edges[0] ? cells[i]->edges[0]->index : -1,
-					cells[i]->edges[1] ? cells[i]->edges[1]->index : -1,
-					cells[i]->edges[2] ? cells[i]->edges[2]->index : -1,
-					cells[i]->edges[3] ? cells[i]->edges[3]->index : -1);
+					(int)tables.cell_edge[0][i], (int)tables.cell_edge[1][i],
+					(int)tables.cell_edge[2][i], (int)tables.cell_edge[3][i]);
 
-	   fprintf(f, "%g %g %g %g %g\n",
-					viewer_posn[X], viewer_posn[Y], viewer_posn[Z],
-					viewer_dir, viewer_fov);
+	fprintf(f, "%g %g %g %g %g\n",
+				viewer_posn[X], viewer_posn[Y], viewer_posn[Z],
+				viewer_dir, viewer_fov);
 
 	fclose(f);
 
-	return true;
+	return Save_PVS(filename);
+}
+
+
+//**********************************************************************
+//
+// * Save the maze to a file of the given name in the binary format.
+//======================================================================
+bool Maze::
+Save_Binary(const char *filename)
+//======================================================================
+{
+	Binary_Header	header;
+	FILE			*f;
+	bool			ok;
+
+	// The tables may be mapped from this very file, which is about to be
+	// truncated.
+	tables.Unmap();
+	if ( ! ( f = fopen(filename, "wb") ) )
+		return false;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_MAGIC, 4);
+	header.version = BINARY_VERSION;
+	header.byte_order = BINARY_BYTE_ORDER;
+	header.num_vertices = tables.num_vertices;
+	header.num_edges = tables.num_edges;
+	header.num_cells = tables.num_cells;
+	header.block_size = tables.Block_Size();
+	header.viewer_posn[X] = viewer_posn[X];
+	header.viewer_posn[Y] = viewer_posn[Y];
+	header.viewer_posn[Z] = viewer_posn[Z];
+	header.viewer_dir = viewer_dir;
+	header.viewer_fov = viewer_fov;
+	header.maze_hash[0] = (uint32_t)Tables_Hash();
+	header.maze_hash[1] = (uint32_t)( Tables_Hash() >> 32 );
+
+	ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+		  fwrite(tables.Block(), 1, tables.Block_Size(), f) == tables.Block_Size();
+
+	return fclose(f) == 0 && ok;
+}
+
+
+//**********************************************************************
+//
+// * Return MazePVS::Hash of the tables, working it out the first time.
+//======================================================================
+uint64_t Maze::
+Tables_Hash(void)
+//======================================================================
+{
+	if ( ! tables_hash )
+		tables_hash = MazePVS::Hash(tables);
+
+	return tables_hash;
+}
+
+
+//**********************************************************************
+//
+// * Keep the visible sets next to the maze saved in the given file.
+//   Returns true if there are none to save.
+//======================================================================
+bool Maze::
+Save_PVS(const char *filename)
+//======================================================================
+{
+	return ! pvs.Valid() || pvs.Save(PVS_File_Name(filename).c_str());
+}
+
+
+//**********************************************************************
+//
+// * Return the name of the file holding the visible sets of the maze in
+//   the given file.
+//======================================================================
+std::string Maze::
+PVS_File_Name(const char *filename)
+//======================================================================
+{
+	return std::string(filename) + ".pvs";
 }
@@ -24,8 +24,13 @@
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <string>
+#include <vector>
 #include "Cell.h"
 #include "LineSeg.h"
+#include "MazeGrid.h"
+#include "MazePVS.h"
+#include "MazeTables.h"
 
 //************************************************************************
 //
@@ -46,6 +51,38 @@ class MazeException {
 };
 
 
+//************************************************************************
+//
+// * One corner of a wall in the view, projected to the canonical view
+//   volume, with the wall's color.
+//
+//************************************************************************
+struct View_Vertex {
+	float	x, y;
+	float	r, g, b;
+};
+
+
+//************************************************************************
+//
+// * Receives the walls found by Maze::Draw_View. The default backend draws
+//   them with OpenGL. Others can record them instead, so the view can be
+//   worked out and timed without a window.
+//
+//************************************************************************
+class View_Backend {
+	public:
+		virtual ~View_Backend(void) {};
+
+		// Draw the walls of one view, four vertices per wall in the order
+		// they were found: the tops of the wall's start and end, then the
+		// bottoms of its end and start. Called once per view, even when there
+		// are no walls.
+		virtual void	Draw_Walls(const View_Vertex *vertices,
+										  const size_t num_vertices) = 0;
+};
+
+
 //************************************************************************
 //
 // * The maze consists of cells, separated by edges. NOTE: The maze is defined
@@ -61,9 +98,11 @@ class Maze {
 	public:
 		// The first constructor takes the number of cells in the x and y 
 		// directions, and the cell size in each dimension. This constructor
-		// creates a random maze, and returns it.
+		// creates a random maze, and returns it. The same seed always gives the
+		// same maze.
 		Maze(	const int num_x, const int num_y,
-				const float size_x, const float size_y);
+				const float size_x, const float size_y,
+				const uint32_t seed = 0);
 
 		// The second constructor takes a maze file name to load. It may throw
 		// exceptions of the MazeException class if there is an error.
@@ -87,8 +126,6 @@ class Maze {
 		// the viewer from passing through walls.
 		void	Move_View_Posn(const float dx, const float dy, const float dz);
 
-		bool	clipping(LineSeg frustum_edge, glm::vec4& start, glm::vec4& end);
-
 		// Draws the map view of the maze. It is passed the minimum and maximum
 		// corners of the window in which to draw.
 		void	Draw_Map(int, int, int, int);
@@ -102,14 +139,48 @@ class Maze {
 		// minimum and maximum corners of the window in which to draw.
 		void	Draw_Frustum(int, int, int, int);
 
-		void	Draw_Cell(Cell* current_cell, LineSeg left_frustrum, LineSeg right_frustrum, glm::mat4x4 view, glm::mat4x4 perspective);
-
 		// Draws the first-person view of the maze. It is passed the focal distance.
 		// THIS IS THE FUINCTION YOU SHOULD MODIFY.
 		void	Draw_View(const float focal_dist, glm::mat4x4 view, glm::mat4x4 perspective);
 
-		// Save the maze to a file of the given name.
-		bool	Save(const char*);
+		// Build the view and perspective matrices that Draw_View takes, for an
+		// image with the given width over height.
+		void	View_Matrices(const float aspect, glm::mat4x4 &view,
+								  glm::mat4x4 &perspective) const;
+
+		// Send the walls found by Draw_View to the given backend instead of
+		// drawing them with OpenGL. NULL goes back to OpenGL.
+		void	Set_View_Backend(View_Backend *b) { backend = b; };
+
+		// What the last Draw_View did.
+		struct View_Stats {
+			uint32_t	cells;	// The cells it walked into
+			uint32_t	walls;	// The walls it sent to the backend
+			uint32_t	clips;	// The edges it clipped to a frustum plane
+		};
+		const View_Stats&	Last_View_Stats(void) const { return view_stats; };
+
+		// The walls of the last Draw_View, as given to the backend.
+		const std::vector<View_Vertex>&	View_Vertices(void) const {
+			return view_vertices;
+		};
+
+		// Save the maze to a file of the given name, and its potentially
+		// visible sets to the file named by PVS_File_Name. The binary format
+		// is much faster to load, since its tables are mapped and used in
+		// place, but it is only read on machines with the same byte order.
+		// Mapped tables are copied into memory first, so a maze can be saved
+		// over the file it was loaded from.
+		bool	Save(const char*, const bool binary = false);
+
+		// Return the name of the file holding the potentially visible sets of
+		// the maze in the given file. It is next to the maze file.
+		static std::string	PVS_File_Name(const char*);
+
+		// Handles to the vertices, edges and cells of the maze, by index.
+		Vertex	Get_Vertex(const int i) { return Vertex(&tables, (uint32_t)i); };
+		Edge	Get_Edge(const int i) { return Edge(&tables, (uint32_t)i); };
+		Cell	Get_Cell(const int i) { return Cell(&tables, (uint32_t)i); };
 
 		// Functions to convert between degrees and radians.
 		static double   To_Radians(double deg) { return deg / 180.0 * M_PI; };
@@ -117,17 +188,56 @@ class Maze {
 	private:
 		// Functions used when creating or loading a maze.
 
-		// Randomly generate the edge's opaque and transparency for an empty maze
-		void    Build_Connectivity(const int, const int, const float, const float);
+		// Build an empty grid of cells, with every edge opaque and randomly
+		// colored.
+		void    Build_Connectivity(const int, const int, const float, const float,
+										 const uint32_t);
 		// Grow a maze by removing candidate edges until all the cells are
 		// connected. The edges are not actually removed, they are just made
 		// transparent.
-		void    Build_Maze(void);
+		void    Build_Maze(const int, const int, const uint32_t);
 		void    Set_Extents(void);
-		void    Find_View_Cell(Cell*);
+		void    Find_View_Cell(void);
+
+		// Read the tables and viewer from a file in each format.
+		void	Read_Text(const char*);
+		void	Read_Binary(const char*);
+
+		// Check that the indices in the tables are in range and agree with
+		// each other. Throws a MazeException if they don't.
+		void	Check_Tables(void);
+
+		// Functions used when saving a maze.
+		bool	Save_Binary(const char*);
+		bool	Save_PVS(const char*);
+
+		// Return MazePVS::Hash of the tables, working it out the first time.
+		uint64_t	Tables_Hash(void);
+
+	private:
+		// Types and functions used when drawing the view.
+
+		// The half-plane a x + b z + c > 0 in view space.
+		struct Half_Plane {
+			float	a, b, c;
+		};
+
+		// A cell waiting to be drawn, with the frustum it is seen through.
+		struct Portal_Frame {
+			uint32_t	cell;			// The cell's index
+			int			next_edge;	// The next of its edges to draw
+			Half_Plane	left;			// The sides of the frustum, through the eye
+			Half_Plane	right;
+			Half_Plane	front;		// Through the edge the cell is seen through
+		};
+
+		static Half_Plane	Right_Of(const float xs, const float zs,
+										const float xe, const float ze);
+		static bool	Clip_Wall(const Half_Plane&, float& sx, float& sz,
+									float& ex, float& ez);
 
 	private:
-		Cell				*view_cell;// The cell that currently contains the view
+		Cell				view_cell;// The cell that currently contains the view
 										  // point. You will need to use this.
 		unsigned int    frame_num;	// The frame number we are currently drawing.
 											// It isn't necessary, but you might find it
@@ -142,20 +252,30 @@ class Maze {
 		float	max_xp;	// The maximum x location of any vertex in the maze.
 		float	max_yp;	// The maximum y location of any vertex in the maze.
 
+		std::vector<unsigned int>	cell_frame;		// Per cell. The frame_num the cell
+															// was last drawn in.
+		std::vector<Portal_Frame>	portal_stack;	// Cells still to be drawn this
+															// frame. Kept to reuse its memory.
+		View_Backend	*backend;		// Where Draw_View sends walls, or NULL
+											// for OpenGL
+		View_Stats		view_stats;		// What the last Draw_View did
+		uint64_t		tables_hash;	// MazePVS::Hash of the tables, or 0 until
+											// it is read or worked out
+		std::vector<View_Vertex>	view_vertices;	// The walls of the last view.
+															// Kept to reuse its memory.
+
 	public:
 		static const char	X; // Used to index into the viewer's position
 		static const char	Y;
 		static const char	Z;
 		static const char	W;
 
-		int		num_vertices;	// The number of vertices in the maze
-		Vertex	**vertices;		// An array of pointers to the vertices.
-
-		int		num_edges;		// The number of edges in the maze.
-		Edge		**edges;			// An array of pointers to the edges.
-
-		int		num_cells;     // The number of cells in the maze
-		Cell		**cells;       // An array of pointers to the cells.
+		MazeTables	tables;		// The vertices, edges and cells of the maze,
+										// with their counts.
+		MazePVS		pvs;			// The cells that can be seen from each cell,
+										// for asking what a cell can see. Draw_View
+										// doesn't need them.
+		MazeGrid		grid;			// Finds the cell holding a point.
 
 		float		viewer_posn[3];	// The x,y location of the viewer.
 		float		viewer_dir;			// The direction in which the viewer is
@@ -0,0 +1,537 @@
+/************************************************************************
+     File:        MazeBench.cpp
+
+     Comment:
+						Headless benchmark of the maze view. Loads or generates a
+						maze, then moves the viewer along a path and works out the
+						view at each step without opening a window. The walls go to
+						a backend that records them instead of drawing them, and the
+						cells, walls, clips and time of each view are reported.
+
+						Usage:
+							MazeBench <maze file> [options]
+							MazeBench -gen <nx> <ny> [options]
+
+						Options:
+							-size <sx> <sy>	Cell size of a generated maze (1 1)
+							-seed <n>			Seed for the maze and the path (1)
+							-frames <n>			Frames in the scripted path (1000)
+							-path <file>		Replay a recorded path
+							-record <file>		Write the path that was run
+							-walls <file>		Write the walls of every frame
+							-csv <file>			Write the numbers of every frame
+							-fov <degrees>		Horizontal field of view
+							-aspect <w/h>		Image width over height (1)
+
+						A path file holds the start on its first line as
+						"x y z dir", then one line per frame as "dx dy dz dir".
+						Each frame moves the viewer by (dx,dy,dz) with
+						Move_View_Posn, then turns it to dir with Set_View_Dir.
+
+
+     Platform:    Visio Studio.Net 2003 (converted to 2005)
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "Maze.h"
+#include "Edge.h"
+#include "Vertex.h"
+
+// One frame of a path: the move, then the direction to look in.
+struct Path_Step {
+	float	dx, dy, dz;
+	float	dir;
+};
+
+// The numbers reported for one frame.
+struct Frame_Result {
+	uint32_t	cells;
+	uint32_t	walls;
+	uint32_t	clips;
+	double		micro_seconds;
+};
+
+
+//*****************************************************************************
+//
+// * A backend that notes the walls of each view instead of drawing them.
+//   The vertices stay in the maze's array, so nothing is copied.
+//=============================================================================
+class Recording_Backend : public View_Backend {
+	public:
+		Recording_Backend(void) : vertices(NULL), num_vertices(0) {};
+
+		void	Draw_Walls(const View_Vertex *v, const size_t num) {
+			vertices = v;
+			num_vertices = num;
+		};
+
+	public:
+		const View_Vertex	*vertices;		// The walls of the last view, four
+		size_t				num_vertices;	// vertices per wall
+};
+
+
+//*****************************************************************************
+//
+// * The side of a square with the area of an average cell.
+//=============================================================================
+static float
+Cell_Size(const Maze *maze)
+//=============================================================================
+{
+	const MazeTables	&t = maze->tables;
+	float				min_x, min_y, max_x, max_y;
+	uint32_t			i;
+
+	min_x = max_x = t.vertex_posn[Vertex::X][0];
+	min_y = max_y = t.vertex_posn[Vertex::Y][0];
+	for ( i = 1 ; i < t.num_vertices ; i++ ) {
+		min_x = std::min(min_x, t.vertex_posn[Vertex::X][i]);
+		max_x = std::max(max_x, t.vertex_posn[Vertex::X][i]);
+		min_y = std::min(min_y, t.vertex_posn[Vertex::Y][i]);
+		max_y = std::max(max_y, t.vertex_posn[Vertex::Y][i]);
+	}
+
+	return sqrtf(( max_x - min_x ) * ( max_y - min_y ) / t.num_cells);
+}
+
+
+//*****************************************************************************
+//
+// * Turns a line of points into frames a fixed distance apart. Frames
+//   carry on from one line to the next, so they seldom land exactly on a
+//   point of the line, where the walk may cross an edge.
+//=============================================================================
+class Path_Walker {
+	public:
+		Path_Walker(const float x, const float y, const float step,
+						const int num_frames, std::vector<Path_Step> &path)
+			: x(x), y(y), last_x(x), last_y(y), step(step), left(step),
+			  num_frames(num_frames), path(path) {};
+
+		// Walk on to (to_x,to_y), adding a frame each time a step is done.
+		// The frames look the way they go.
+		void	Walk_To(const float to_x, const float to_y) {
+			float	dx = to_x - x;
+			float	dy = to_y - y;
+			float	length = sqrtf(dx * dx + dy * dy);
+			float	along = left;
+
+			for ( ; along <= length && (int)path.size() < num_frames ;
+					along += step ) {
+				Path_Step	s;
+				float			px = x + dx * along / length;
+				float			py = y + dy * along / length;
+
+				s.dx = px - last_x;
+				s.dy = py - last_y;
+				s.dz = 0.0f;
+				s.dir = (float)Maze::To_Degrees(atan2(s.dy, s.dx));
+				path.push_back(s);
+
+				last_x = px;
+				last_y = py;
+			}
+
+			left = along - length;
+			x = to_x;
+			y = to_y;
+		};
+
+	private:
+		float						x, y;				// The end of the line so far
+		float						last_x, last_y;// Where the last frame left off
+		float						step;				// The distance between frames
+		float						left;				// How far along the next line the
+													// next frame is
+		int							num_frames;		// Stop when the path is this long
+		std::vector<Path_Step>	&path;
+};
+
+
+//*****************************************************************************
+//
+// * Make up a path: a random walk along the corridors of the maze. From
+//   the viewer's cell it goes through a random transparent edge, at a
+//   random point near its middle, to the middle of the cell behind it, and
+//   on from there, only turning back at dead ends. A viewer with nowhere
+//   to go turns on the spot.
+//=============================================================================
+static void
+Script_Path(const Maze *maze, const int num_frames, const float step,
+				std::vector<Path_Step> &path)
+//=============================================================================
+{
+	const MazeTables	&t = maze->tables;
+	float				x = maze->viewer_posn[Maze::X];
+	float				y = maze->viewer_posn[Maze::Y];
+	uint32_t			cell = maze->grid.Locate(t, x, y);
+	uint32_t			from = MazeTables::NO_INDEX;
+	Path_Walker			walker(x, y, step, num_frames, path);
+
+	path.clear();
+	while ( (int)path.size() < num_frames ) {
+		uint32_t	ways[4];
+		uint32_t	back = MazeTables::NO_INDEX;
+		int			num_ways = 0;
+		int			i, j;
+
+		// Find the edges that lead on, and the one that leads back.
+		for ( i = 0 ; cell != MazeTables::NO_INDEX && i < 4 ; i++ ) {
+			uint32_t	e = t.cell_edge[i][cell];
+
+			if ( e == MazeTables::NO_INDEX || t.edge_opaque[e] ||
+				  t.edge_cell[Edge::LEFT][e] == MazeTables::NO_INDEX ||
+				  t.edge_cell[Edge::RIGHT][e] == MazeTables::NO_INDEX )
+				continue;
+
+			if ( t.edge_cell[Edge::LEFT][e] == from ||
+				  t.edge_cell[Edge::RIGHT][e] == from )
+				back = e;
+			else
+				ways[num_ways++] = e;
+		}
+		if ( num_ways == 0 && back != MazeTables::NO_INDEX )
+			ways[num_ways++] = back;
+
+		if ( num_ways == 0 ) {
+			Path_Step	s = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+			s.dir = (float)fmod(maze->viewer_dir + 5.0f * ( path.size() + 1 ),
+									  360.0);
+			path.push_back(s);
+			continue;
+		}
+
+		// Cross the edge somewhere in its middle half, then head for the
+		// middle of the cell behind it, found from the ends of its edges.
+		uint32_t	e = ways[rand() % num_ways];
+		uint32_t	next = t.edge_cell[Edge::LEFT][e] == cell ?
+								t.edge_cell[Edge::RIGHT][e] : t.edge_cell[Edge::LEFT][e];
+		float		u = 0.25f + 0.5f * rand() / (float)RAND_MAX;
+		float		mid_x = 0.0f, mid_y = 0.0f;
+		int			num_ends = 0;
+
+		walker.Walk_To(
+			( 1.0f - u ) * t.vertex_posn[Vertex::X][t.edge_vertex[Edge::START][e]] +
+			u * t.vertex_posn[Vertex::X][t.edge_vertex[Edge::END][e]],
+			( 1.0f - u ) * t.vertex_posn[Vertex::Y][t.edge_vertex[Edge::START][e]] +
+			u * t.vertex_posn[Vertex::Y][t.edge_vertex[Edge::END][e]]);
+
+		for ( i = 0 ; i < 4 ; i++ ) {
+			uint32_t	ce = t.cell_edge[i][next];
+
+			if ( ce == MazeTables::NO_INDEX )
+				continue;
+			for ( j = 0 ; j < 2 ; j++ ) {
+				mid_x += t.vertex_posn[Vertex::X][t.edge_vertex[j][ce]];
+				mid_y += t.vertex_posn[Vertex::Y][t.edge_vertex[j][ce]];
+				num_ends++;
+			}
+		}
+		walker.Walk_To(mid_x / num_ends, mid_y / num_ends);
+
+		from = cell;
+		cell = next;
+	}
+}
+
+
+//*****************************************************************************
+//
+// * Read a path file. Sets the viewer to the path's start.
+//=============================================================================
+static bool
+Read_Path(const char *filename, Maze *maze, std::vector<Path_Step> &path)
+//=============================================================================
+{
+	FILE		*f = fopen(filename, "r");
+	float		x, y, z, dir;
+	Path_Step	s;
+
+	if ( ! f )
+		return false;
+
+	if ( fscanf(f, "%g %g %g %g", &x, &y, &z, &dir) != 4 ) {
+		fclose(f);
+		return false;
+	}
+	maze->Set_View_Posn(x, y, z);
+	maze->Set_View_Dir(dir);
+
+	path.clear();
+	while ( fscanf(f, "%g %g %g %g", &s.dx, &s.dy, &s.dz, &s.dir) == 4 )
+		path.push_back(s);
+
+	fclose(f);
+	return true;
+}
+
+
+//*****************************************************************************
+//
+// * Write a path file, starting from where the viewer is now.
+//=============================================================================
+static bool
+Write_Path(const char *filename, const Maze *maze,
+			  const std::vector<Path_Step> &path)
+//=============================================================================
+{
+	FILE	*f = fopen(filename, "w");
+	size_t	i;
+
+	if ( ! f )
+		return false;
+
+	fprintf(f, "%.9g %.9g %.9g %.9g\n", maze->viewer_posn[Maze::X],
+			  maze->viewer_posn[Maze::Y], maze->viewer_posn[Maze::Z],
+			  maze->viewer_dir);
+	for ( i = 0 ; i < path.size() ; i++ )
+		fprintf(f, "%.9g %.9g %.9g %.9g\n", path[i].dx, path[i].dy, path[i].dz,
+				  path[i].dir);
+
+	fclose(f);
+	return true;
+}
+
+
+//*****************************************************************************
+//
+// * Print the mean, percentiles and maximum of one number over all frames.
+//=============================================================================
+static void
+Report(const char *name, std::vector<double> values)
+//=============================================================================
+{
+	static const double	percents[] = { 50.0, 90.0, 99.0 };
+	double					sum = 0.0;
+	size_t					i;
+
+	if ( values.empty() )
+		return;
+
+	std::sort(values.begin(), values.end());
+	for ( i = 0 ; i < values.size() ; i++ )
+		sum += values[i];
+
+	printf("%-14s mean %10.2f", name, sum / values.size());
+	for ( i = 0 ; i < sizeof(percents) / sizeof(percents[0]) ; i++ ) {
+		size_t	k = (size_t)ceil(percents[i] / 100.0 * values.size());
+
+		printf("   p%02.0f %10.2f", percents[i], values[k > 0 ? k - 1 : 0]);
+	}
+	printf("   max %10.2f\n", values.back());
+}
+
+
+//*****************************************************************************
+//
+// * Print the usage message and quit.
+//=============================================================================
+static void
+Usage(void)
+//=============================================================================
+{
+	fprintf(stderr,
+			  "usage: MazeBench <maze file> [options]\n"
+			  "       MazeBench -gen <nx> <ny> [options]\n"
+			  "options: -size <sx> <sy>  -seed <n>  -frames <n>  -path <file>\n"
+			  "         -record <file>  -walls <file>  -csv <file>\n"
+			  "         -fov <degrees>  -aspect <w/h>\n");
+	exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+	const char	*maze_file = NULL;
+	const char	*path_file = NULL;
+	const char	*record_file = NULL;
+	const char	*walls_file = NULL;
+	const char	*csv_file = NULL;
+	int			gen_x = 0, gen_y = 0;
+	float		size_x = 1.0f, size_y = 1.0f;
+	uint32_t	seed = 1;
+	int			num_frames = 1000;
+	float		fov = 0.0f;
+	float		aspect = 1.0f;
+	Maze		*maze;
+	int			i;
+
+	for ( i = 1 ; i < argc ; i++ ) {
+		bool	more = i + 1 < argc;
+
+		if ( ! strcmp(argv[i], "-gen") && i + 2 < argc ) {
+			gen_x = atoi(argv[++i]);
+			gen_y = atoi(argv[++i]);
+		}
+		else if ( ! strcmp(argv[i], "-size") && i + 2 < argc ) {
+			size_x = (float)atof(argv[++i]);
+			size_y = (float)atof(argv[++i]);
+		}
+		else if ( ! strcmp(argv[i], "-seed") && more )
+			seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if ( ! strcmp(argv[i], "-frames") && more )
+			num_frames = atoi(argv[++i]);
+		else if ( ! strcmp(argv[i], "-path") && more )
+			path_file = argv[++i];
+		else if ( ! strcmp(argv[i], "-record") && more )
+			record_file = argv[++i];
+		else if ( ! strcmp(argv[i], "-walls") && more )
+			walls_file = argv[++i];
+		else if ( ! strcmp(argv[i], "-csv") && more )
+			csv_file = argv[++i];
+		else if ( ! strcmp(argv[i], "-fov") && more )
+			fov = (float)atof(argv[++i]);
+		else if ( ! strcmp(argv[i], "-aspect") && more )
+			aspect = (float)atof(argv[++i]);
+		else if ( argv[i][0] != '-' && ! maze_file )
+			maze_file = argv[i];
+		else
+			Usage();
+	}
+	if ( ! maze_file && gen_x <= 0 )
+		Usage();
+
+	// Load or generate the maze. A generated maze starts in its middle cell.
+	try {
+		std::chrono::steady_clock::time_point	t0 = std::chrono::steady_clock::now();
+
+		if ( maze_file )
+			maze = new Maze(maze_file);
+		else {
+			maze = new Maze(gen_x, gen_y, size_x, size_y, seed);
+			maze->Set_View_Posn(( gen_x / 2 + 0.5f ) * size_x,
+									  ( gen_y / 2 + 0.5f ) * size_y, 0.0f);
+		}
+
+		printf("%s: %u cells, %u edges, loaded in %.3fs\n",
+				 maze_file ? maze_file : "generated", maze->tables.num_cells,
+				 maze->tables.num_edges,
+				 std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+
+		if ( fov > 0.0f )
+			maze->Set_View_FOV(fov);
+	}
+	catch ( MazeException *e ) {
+		fprintf(stderr, "%s\n", e->Message());
+		return 1;
+	}
+
+	// Get the path, either from a file or by walking around the maze.
+	std::vector<Path_Step>	path;
+
+	try {
+		if ( path_file ) {
+			if ( ! Read_Path(path_file, maze, path) ) {
+				fprintf(stderr, "Couldn't read path %s\n", path_file);
+				return 1;
+			}
+		}
+		else {
+			srand(seed);
+			Script_Path(maze, num_frames, 0.1f * Cell_Size(maze), path);
+		}
+	}
+	catch ( MazeException *e ) {
+		fprintf(stderr, "%s\n", e->Message());
+		return 1;
+	}
+
+	if ( record_file && ! Write_Path(record_file, maze, path) ) {
+		fprintf(stderr, "Couldn't write path %s\n", record_file);
+		return 1;
+	}
+
+	// Replay the path, timing each view.
+	Recording_Backend			recorder;
+	std::vector<Frame_Result>	results;
+	FILE							*walls_out = NULL;
+	glm::mat4x4					view, perspective;
+
+	if ( walls_file && ! ( walls_out = fopen(walls_file, "w") ) ) {
+		fprintf(stderr, "Couldn't write walls %s\n", walls_file);
+		return 1;
+	}
+
+	maze->Set_View_Backend(&recorder);
+	results.reserve(path.size());
+
+	for ( size_t f = 0 ; f < path.size() ; f++ ) {
+		Frame_Result	r;
+
+		maze->Move_View_Posn(path[f].dx, path[f].dy, path[f].dz);
+		maze->Set_View_Dir(path[f].dir);
+		maze->View_Matrices(aspect, view, perspective);
+
+		std::chrono::steady_clock::time_point	t0 = std::chrono::steady_clock::now();
+		maze->Draw_View(0.0f, view, perspective);
+		std::chrono::steady_clock::time_point	t1 = std::chrono::steady_clock::now();
+
+		r.cells = maze->Last_View_Stats().cells;
+		r.walls = maze->Last_View_Stats().walls;
+		r.clips = maze->Last_View_Stats().clips;
+		r.micro_seconds = std::chrono::duration<double, std::micro>(t1 - t0).count();
+		results.push_back(r);
+
+		if ( walls_out ) {
+			fprintf(walls_out, "frame %u %.9g %.9g %.9g\n", (unsigned)f,
+					  maze->viewer_posn[Maze::X], maze->viewer_posn[Maze::Y],
+					  maze->viewer_dir);
+			for ( size_t w = 0 ; w < recorder.num_vertices ; w += 4 ) {
+				const View_Vertex	*v = recorder.vertices + w;
+
+				fprintf(walls_out, "%.6g %.6g %.6g %.9g %.9g %.9g %.9g\n",
+						  v[0].r, v[0].g, v[0].b, v[0].x, v[0].y, v[1].x, v[1].y);
+			}
+		}
+	}
+	maze->Set_View_Backend(NULL);
+
+	if ( walls_out )
+		fclose(walls_out);
+
+	// Report.
+	std::vector<double>	cells, walls, clips, times;
+	double					total = 0.0;
+
+	for ( size_t f = 0 ; f < results.size() ; f++ ) {
+		cells.push_back(results[f].cells);
+		walls.push_back(results[f].walls);
+		clips.push_back(results[f].clips);
+		times.push_back(results[f].micro_seconds);
+		total += results[f].micro_seconds;
+	}
+
+	printf("%u frames, %.3f ms of views\n", (unsigned)results.size(),
+			 total / 1000.0);
+	Report("cells", cells);
+	Report("walls", walls);
+	Report("clips", clips);
+	Report("microseconds", times);
+
+	if ( csv_file ) {
+		FILE	*f = fopen(csv_file, "w");
+
+		if ( ! f ) {
+			fprintf(stderr, "Couldn't write %s\n", csv_file);
+			return 1;
+		}
+		fprintf(f, "frame,cells,walls,clips,microseconds\n");
+		for ( size_t k = 0 ; k < results.size() ; k++ )
+			fprintf(f, "%u,%u,%u,%u,%.3f\n", (unsigned)k, results[k].cells,
+					  results[k].walls, results[k].clips, results[k].micro_seconds);
+		fclose(f);
+	}
+
+	delete maze;
+	return 0;
+}
@@ -0,0 +1,394 @@
+/************************************************************************
+     File:        MazeGrid.cpp
+
+     Comment:
+						Class file for MazeGrid class. Cells are bucketed by their
+						bounding boxes, so a cell lands in every bucket its box
+						overlaps and a point only needs the cells of one bucket.
+						Cells are spread across the hardware threads while bucketing.
+
+
+     Platform:    Visio Studio.Net 2003 (converted to 2005)
+
+*************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include "MazeGrid.h"
+#include "Edge.h"
+#include "Parallel.h"
+#include "Vertex.h"
+
+// The cells or buckets handed to a thread at a time while building.
+static const uint64_t	GRID_CHUNK = 16384;
+
+// Bucket sides are rounded up to whole buckets, unless they are within this
+// fraction of the length below. Then a maze of square cells gets one bucket
+// per cell despite rounding in the bucket size.
+static const double		BUCKET_SLACK = 1.0e-6;
+
+
+//**********************************************************************
+//
+// * Find the bounding box of a cell from the ends of its edges.
+//======================================================================
+static void
+Cell_Box(const MazeTables &t, const uint32_t cell,
+			float &min_x, float &min_y, float &max_x, float &max_y)
+//======================================================================
+{
+	bool	first = true;
+	int		i, j;
+
+	min_x = min_y = max_x = max_y = 0.0f;
+	for ( i = 0 ; i < 4 ; i++ ) {
+		uint32_t	e = t.cell_edge[i][cell];
+
+		if ( e == MazeTables::NO_INDEX )
+			continue;
+
+		for ( j = 0 ; j < 2 ; j++ ) {
+			float	x = t.vertex_posn[Vertex::X][t.edge_vertex[j][e]];
+			float	y = t.vertex_posn[Vertex::Y][t.edge_vertex[j][e]];
+
+			if ( first || x < min_x )
+				min_x = x;
+			if ( first || x > max_x )
+				max_x = x;
+			if ( first || y < min_y )
+				min_y = y;
+			if ( first || y > max_y )
+				max_y = y;
+			first = false;
+		}
+	}
+}
+
+
+//**********************************************************************
+//
+// * The largest float less than x, for finite x. The same as nextafterf
+//   toward minus infinity, without the call.
+//======================================================================
+static inline float
+Float_Below(const float x)
+//======================================================================
+{
+	uint32_t	bits;
+	float		below;
+
+	// Below either zero is the smallest negative float.
+	memcpy(&bits, &x, sizeof(bits));
+	if ( x == 0.0f )
+		bits = 0x80000001u;
+	else if ( x > 0.0f )
+		bits--;
+	else
+		bits++;
+	memcpy(&below, &bits, sizeof(below));
+	return below;
+}
+
+
+//**********************************************************************
+//
+// * Returns true if (x,y) is strictly inside the cell. This is the test
+//   Cell::Point_In_Cell makes, without looking for a neighbor.
+//======================================================================
+static bool
+Inside(const MazeTables &t, const uint32_t cell, const float x, const float y)
+//======================================================================
+{
+	int	i;
+
+	for ( i = 0 ; i < 4 ; i++ ) {
+		uint32_t	e = t.cell_edge[i][cell];
+
+		if ( e == MazeTables::NO_INDEX )
+			continue;
+
+		bool	cell_left = t.edge_cell[Edge::LEFT][e] == cell;
+		float	side = t.Edge_Line(e, x, y);
+
+		if ( cell_left ? !( side > 0.0f ) : !( side < 0.0f ) )
+			return false;
+	}
+
+	return true;
+}
+
+
+//**********************************************************************
+//
+// * The number of buckets along one side of the grid, for a side of the
+//   given length split into buckets of the given size.
+//======================================================================
+static uint32_t
+Buckets_Along(const double length, const double size, const uint32_t most)
+//======================================================================
+{
+	double	n;
+
+	if ( ! ( length > 0.0 ) || ! ( size > 0.0 ) )
+		return 1;
+
+	n = ceil(length / size * ( 1.0 - BUCKET_SLACK ));
+	if ( n < 1.0 )
+		return 1;
+	return n < most ? (uint32_t)n : most;
+}
+
+
+//**********************************************************************
+//
+// * Forget the buckets
+//======================================================================
+void MazeGrid::
+Clear(void)
+//======================================================================
+{
+	origin_x = origin_y = 0.0f;
+	scale_x = scale_y = 0.0f;
+	num_x = num_y = 0;
+	starts.clear();
+	wide_starts.clear();
+	cells.clear();
+}
+
+
+//**********************************************************************
+//
+// * Bucket every cell of the maze. The buckets are square, sized so that
+//   an average cell fills about one, and each cell is listed in every
+//   bucket its bounding box overlaps. The cells are counted into the
+//   buckets and then placed, both spread across the threads, so the
+//   buckets are sorted afterwards to keep their order the same every time.
+//======================================================================
+void MazeGrid::
+Build(const MazeTables &t, const float min_x, const float min_y,
+		const float max_x, const float max_y)
+//======================================================================
+{
+	double		width = (double)max_x - min_x;
+	double		height = (double)max_y - min_y;
+	double		size;
+	uint32_t	most = t.num_cells > 0 ? t.num_cells : 1;
+	size_t		num_buckets, b;
+	uint64_t	total;
+
+	Clear();
+
+	if ( width > 0.0 && height > 0.0 )
+		size = sqrt(width * height / most);
+	else
+		size = ( width > height ? width : height ) / most;
+
+	origin_x = min_x;
+	origin_y = min_y;
+	num_x = Buckets_Along(width, size, most);
+	num_y = Buckets_Along(height, size, most);
+	scale_x = width > 0.0 ? (float)( num_x / width ) : 0.0f;
+	scale_y = height > 0.0 ? (float)( num_y / height ) : 0.0f;
+	num_buckets = (size_t)num_x * num_y;
+
+	// Count the cells in each bucket. No bucket can hold more cells than
+	// there are.
+	std::vector< std::atomic<uint32_t> >	counts(num_buckets);
+	Work_Chunks								count_chunks(t.num_cells, GRID_CHUNK);
+
+	Run_On_All_Threads([&]() {
+		uint64_t	first, last;
+		uint32_t	c0, r0, c1, r1, c, r;
+
+		while ( count_chunks.Next(first, last) ) {
+			for ( uint32_t i = (uint32_t)first ; i < last ; i++ ) {
+				Cell_Span(t, i, c0, r0, c1, r1);
+				for ( r = r0 ; r <= r1 ; r++ )
+					for ( c = c0 ; c <= c1 ; c++ )
+						counts[(size_t)r * num_x + c].fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	});
+
+	// The running total of the counts gives each bucket's first entry. The
+	// counts go back to 0 to count the cells placed in each bucket.
+	total = 0;
+	for ( b = 0 ; b < num_buckets ; b++ )
+		total += counts[b].load(std::memory_order_relaxed);
+
+	bool	wide = total > UINT32_MAX;
+
+	if ( wide )
+		wide_starts.resize(num_buckets + 1);
+	else
+		starts.resize(num_buckets + 1);
+
+	total = 0;
+	for ( b = 0 ; b < num_buckets ; b++ ) {
+		if ( wide )
+			wide_starts[b] = total;
+		else
+			starts[b] = (uint32_t)total;
+		total += counts[b].load(std::memory_order_relaxed);
+		counts[b].store(0, std::memory_order_relaxed);
+	}
+	if ( wide )
+		wide_starts[num_buckets] = total;
+	else
+		starts[num_buckets] = (uint32_t)total;
+
+	// Place the cells.
+	Work_Chunks	fill_chunks(t.num_cells, GRID_CHUNK);
+
+	cells.resize(total);
+	Run_On_All_Threads([&]() {
+		uint64_t	first, last;
+		uint32_t	c0, r0, c1, r1, c, r;
+
+		while ( fill_chunks.Next(first, last) ) {
+			for ( uint32_t i = (uint32_t)first ; i < last ; i++ ) {
+				Cell_Span(t, i, c0, r0, c1, r1);
+				for ( r = r0 ; r <= r1 ; r++ )
+					for ( c = c0 ; c <= c1 ; c++ ) {
+						size_t	bucket = (size_t)r * num_x + c;
+						uint64_t	start = wide ? wide_starts[bucket] : starts[bucket];
+
+						cells[start + counts[bucket].fetch_add(1, std::memory_order_relaxed)] = i;
+					}
+			}
+		}
+	});
+
+	// Threads placed each bucket's cells in any order.
+	Work_Chunks	sort_chunks(num_buckets, GRID_CHUNK);
+
+	Run_On_All_Threads([&]() {
+		uint64_t	first, last;
+
+		while ( sort_chunks.Next(first, last) ) {
+			for ( uint64_t k = first ; k < last ; k++ ) {
+				uint64_t	start = wide ? wide_starts[k] : starts[k];
+				uint64_t	end = wide ? wide_starts[k + 1] : starts[k + 1];
+
+				if ( end - start > 1 )
+					std::sort(cells.begin() + start, cells.begin() + end);
+			}
+		}
+	});
+}
+
+
+//**********************************************************************
+//
+// * The first and last bucket columns and rows holding points strictly
+//   inside a cell. The last are the buckets of the nearest floats below
+//   the top of the cell's bounding box, so a cell whose box only reaches
+//   the bottom of a bucket isn't listed in it.
+//======================================================================
+void MazeGrid::
+Cell_Span(const MazeTables &t, const uint32_t cell,
+			 uint32_t &c0, uint32_t &r0, uint32_t &c1, uint32_t &r1) const
+//======================================================================
+{
+	float	x0, y0, x1, y1;
+
+	Cell_Box(t, cell, x0, y0, x1, y1);
+	c0 = Column(x0);
+	c1 = Column(Float_Below(x1));
+	r0 = Row(y0);
+	r1 = Row(Float_Below(y1));
+}
+
+
+//**********************************************************************
+//
+// * The bucket column holding x, clamped to the grid.
+//======================================================================
+uint32_t MazeGrid::
+Column(const float x) const
+//======================================================================
+{
+	float	f = ( x - origin_x ) * scale_x;
+
+	if ( ! ( f > 0.0f ) )
+		return 0;
+	if ( f >= (float)num_x )
+		return num_x - 1;
+	return (uint32_t)f;
+}
+
+
+//**********************************************************************
+//
+// * The bucket row holding y, clamped to the grid.
+//======================================================================
+uint32_t MazeGrid::
+Row(const float y) const
+//======================================================================
+{
+	float	f = ( y - origin_y ) * scale_y;
+
+	if ( ! ( f > 0.0f ) )
+		return 0;
+	if ( f >= (float)num_y )
+		return num_y - 1;
+	return (uint32_t)f;
+}
+
+
+//**********************************************************************
+//
+// * Returns the index of the cell holding (x,y), or NO_INDEX if no cell
+//   does. Only the cells in the point's bucket are tested.
+//======================================================================
+uint32_t MazeGrid::
+Locate(const MazeTables &t, const float x, const float y) const
+//======================================================================
+{
+	size_t	b;
+
+	if ( starts.empty() && wide_starts.empty() )
+		return MazeTables::NO_INDEX;
+
+	b = (size_t)Row(y) * num_x + Column(x);
+	if ( ! wide_starts.empty() )
+		return Search(t, wide_starts[b], wide_starts[b + 1], x, y);
+	return Search(t, starts[b], starts[b + 1], x, y);
+}
+
+
+//**********************************************************************
+//
+// * Returns the first of cells[first..last) holding (x,y), or NO_INDEX.
+//======================================================================
+uint32_t MazeGrid::
+Search(const MazeTables &t, const uint64_t first, const uint64_t last,
+		 const float x, const float y) const
+//======================================================================
+{
+	uint64_t	i;
+
+	for ( i = first ; i < last ; i++ )
+		if ( Inside(t, cells[i], x, y) )
+			return cells[i];
+
+	return MazeTables::NO_INDEX;
+}
+
+
+//**********************************************************************
+//
+// * Locate num points at once, writing each point's cell to found.
+//======================================================================
+void MazeGrid::
+Locate(const MazeTables &t, const size_t num,
+		 const float *xs, const float *ys, uint32_t *found) const
+//======================================================================
+{
+	size_t	i;
+
+	for ( i = 0 ; i < num ; i++ )
+		found[i] = Locate(t, xs[i], ys[i]);
+}
@@ -0,0 +1,73 @@
+/************************************************************************
+     File:        MazeGrid.h
+
+     Comment:
+						Class header file for MazeGrid class. A uniform grid of
+						buckets laid over the maze, each listing the cells whose
+						bounding boxes overlap it, so that the cell holding a point
+						is found by testing only the few cells in its bucket.
+
+
+     Platform:    Visio Studio.Net 2003 (converted to 2005)
+
+*************************************************************************/
+
+#ifndef _MAZEGRID_H_
+#define _MAZEGRID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "MazeTables.h"
+
+class MazeGrid {
+	public:
+		MazeGrid(void) { Clear(); };
+
+	public:
+		// Bucket every cell of the maze. The extents are the smallest and
+		// largest vertex coordinates. There are about as many buckets as cells.
+		void	Build(const MazeTables&, const float min_x, const float min_y,
+						const float max_x, const float max_y);
+
+		// Forget the buckets.
+		void	Clear(void);
+
+		// Returns the index of the cell holding (x,y), or NO_INDEX if no cell
+		// does. A point on an edge is outside both of the edge's cells.
+		uint32_t	Locate(const MazeTables&, const float x, const float y) const;
+
+		// Locate num points at once, writing each point's cell to found.
+		void	Locate(const MazeTables&, const size_t num,
+						 const float *xs, const float *ys, uint32_t *found) const;
+
+	private:
+		// The bucket column or row holding a coordinate, clamped to the grid.
+		uint32_t	Column(const float x) const;
+		uint32_t	Row(const float y) const;
+
+		// The first and last bucket columns and rows holding points strictly
+		// inside a cell.
+		void	Cell_Span(const MazeTables&, const uint32_t cell,
+							 uint32_t &c0, uint32_t &r0, uint32_t &c1, uint32_t &r1) const;
+
+		// Returns the first of cells[first..last) holding (x,y), or NO_INDEX.
+		uint32_t	Search(const MazeTables&, const uint64_t first, const uint64_t last,
+							 const float x, const float y) const;
+
+	private:
+		float		origin_x;		// The lowest corner of the grid
+		float		origin_y;
+		float		scale_x;			// Buckets per unit in each direction
+		float		scale_y;
+		uint32_t	num_x;			// The number of buckets in each direction
+		uint32_t	num_y;
+
+		std::vector<uint32_t>	starts;	// Per bucket, then one more. The number
+													// of entries before the bucket's first.
+		std::vector<uint64_t>	wide_starts;	// Used instead of starts when there
+															// are too many entries for 32 bits
+		std::vector<uint32_t>	cells;	// The cells in each bucket, in order
+};
+
+#endif
@@ -0,0 +1,534 @@
+/************************************************************************
+     File:        MazePVS.cpp
+
+     Comment:
+						Class file for MazePVS class. The set of a cell is found by
+						walking out through the transparent edges, leaving the cell
+						by each edge in turn. Beyond the leaving edge and the edge
+						most recently walked through, only the wedge between the
+						two lines that cross from one edge's end to the other edge's
+						other end can be seen, so each further edge is clipped to
+						that wedge and the walk stops when nothing is left. This
+						keeps more than an exact set would, never less.
+
+
+     Platform:    Visio Studio.Net 2003 (converted to 2005)
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <unordered_map>
+#include "MazePVS.h"
+#include "Edge.h"
+#include "Parallel.h"
+#include "Vertex.h"
+
+// Written at the start of each file, followed by the version.
+static const char		FILE_MAGIC[4] = { 'M', 'P', 'V', 'S' };
+static const uint32_t	FILE_VERSION = 1;
+
+// The cells handed to a thread at a time while building.
+static const uint32_t	CELL_CHUNK = 64;
+
+// Part of an edge must be at least this far inside a wedge to be seen
+// through it.
+static const double		MIN_INSIDE = 1.0e-6;
+
+// A wedge side shorter than this is treated as not being there.
+static const double		MIN_SIDE = 1.0e-9;
+
+
+//**********************************************************************
+//
+// * An edge being looked through while walking out from a cell. Its ends
+//   are ordered so that the cell being walked into is on the left.
+//======================================================================
+struct PVS_Step {
+	uint32_t	cell;			// The cell the edge leads into
+	uint32_t	entered;		// The edge
+	int			next_edge;	// The next edge of cell to try
+	double		a[2];			// The part of the edge that can be seen
+	double		b[2];
+};
+
+
+//**********************************************************************
+//
+// * The part of an edge already walked through from the current source,
+//   as parameters along the edge from its start to its end.
+//======================================================================
+struct PVS_Window {
+	double	low, high;
+};
+
+
+//**********************************************************************
+//
+// * Working space for one building thread.
+//======================================================================
+struct PVS_Scratch {
+	PVS_Scratch(const uint32_t num_cells)
+		: seen(num_cells, 0), on_path(num_cells, 0) {};
+
+	std::vector<uint32_t>	seen;		// Per cell. The source cell + 1 the cell
+												// was last found visible from.
+	std::vector<uint8_t>		on_path;	// Per cell. Non-zero while the walk is
+												// inside the cell.
+	std::vector<PVS_Step>	stack;	// The edges being looked through
+	std::vector<uint32_t>	cells;	// The cells visible from the source
+	std::unordered_map<uint64_t, PVS_Window>
+									windows;	// By edge and direction, the part of the
+												// edge walked through from the source
+};
+
+
+//**********************************************************************
+//
+// * Get the ends of an edge, ordered so that the cell on the far side
+//   from the given cell is on the left.
+//======================================================================
+static void
+Edge_Ends(const MazeTables &t, const uint32_t e, const uint32_t from,
+			 double a[2], double b[2])
+//======================================================================
+{
+	uint32_t	first = t.edge_vertex[Edge::START][e];
+	uint32_t	second = t.edge_vertex[Edge::END][e];
+
+	if ( t.edge_cell[Edge::RIGHT][e] != from )
+		std::swap(first, second);
+
+	a[0] = t.vertex_posn[Vertex::X][first];
+	a[1] = t.vertex_posn[Vertex::Y][first];
+	b[0] = t.vertex_posn[Vertex::X][second];
+	b[1] = t.vertex_posn[Vertex::Y][second];
+}
+
+
+//**********************************************************************
+//
+// * Clip the segment from a to b to the left of the line from p to q.
+//   Returns false if no part of it is far enough inside.
+//======================================================================
+static bool
+Clip_Left_Of(const double p[2], const double q[2], double a[2], double b[2])
+//======================================================================
+{
+	double	dx = q[0] - p[0];
+	double	dy = q[1] - p[1];
+	double	length = sqrt(dx * dx + dy * dy);
+
+	if ( length < MIN_SIDE )
+		return true;
+
+	// Signed distances of the ends from the line.
+	double	sa = ( dx * ( a[1] - p[1] ) - dy * ( a[0] - p[0] ) ) / length;
+	double	sb = ( dx * ( b[1] - p[1] ) - dy * ( b[0] - p[0] ) ) / length;
+	double	t;
+
+	if ( sa <= MIN_INSIDE && sb <= MIN_INSIDE )
+		return false;
+
+	if ( sa < 0.0 ) {
+		t = sa / ( sa - sb );
+		a[0] += ( b[0] - a[0] ) * t;
+		a[1] += ( b[1] - a[1] ) * t;
+	}
+	else if ( sb < 0.0 ) {
+		t = sb / ( sb - sa );
+		b[0] += ( a[0] - b[0] ) * t;
+		b[1] += ( a[1] - b[1] ) * t;
+	}
+
+	return true;
+}
+
+
+//**********************************************************************
+//
+// * Return true if the window from a to b on the edge from start to end
+//   is inside one already walked through. Otherwise record it, merged
+//   with the old one if they overlap, and return false.
+//======================================================================
+static bool
+Window_Walked(PVS_Window &walked, const bool first_time,
+				  const double start[2], const double end[2],
+				  const double a[2], const double b[2])
+//======================================================================
+{
+	double	dx = end[0] - start[0];
+	double	dy = end[1] - start[1];
+	double	length2 = dx * dx + dy * dy;
+	double	ta = ( ( a[0] - start[0] ) * dx + ( a[1] - start[1] ) * dy ) / length2;
+	double	tb = ( ( b[0] - start[0] ) * dx + ( b[1] - start[1] ) * dy ) / length2;
+	double	low = std::min(ta, tb);
+	double	high = std::max(ta, tb);
+
+	if ( ! first_time ) {
+		if ( low >= walked.low && high <= walked.high )
+			return true;
+		if ( low <= walked.high && high >= walked.low ) {
+			low = std::min(low, walked.low);
+			high = std::max(high, walked.high);
+		}
+	}
+
+	walked.low = low;
+	walked.high = high;
+	return false;
+}
+
+
+//**********************************************************************
+//
+// * Find every cell visible from the source, including the source, in
+//   scratch.cells in no particular order.
+//======================================================================
+static void
+Visible_From(const MazeTables &t, const uint32_t source, PVS_Scratch &scratch)
+//======================================================================
+{
+	uint32_t	stamp = source + 1;
+	int			i;
+
+	scratch.cells.clear();
+	scratch.windows.clear();
+	scratch.cells.push_back(source);
+	scratch.seen[source] = stamp;
+	scratch.on_path[source] = 1;
+
+	// Leave the source by each transparent edge in turn.
+	for ( i = 0 ; i < 4 ; i++ ) {
+		uint32_t	leave = t.cell_edge[i][source];
+
+		if ( leave == MazeTables::NO_INDEX || t.edge_opaque[leave] )
+			continue;
+
+		uint32_t	first = t.edge_cell[Edge::LEFT][leave] == source ?
+								t.edge_cell[Edge::RIGHT][leave] :
+								t.edge_cell[Edge::LEFT][leave];
+
+		if ( first == MazeTables::NO_INDEX )
+			continue;
+
+		PVS_Step	step;
+		double		sa[2], sb[2];
+
+		Edge_Ends(t, leave, source, sa, sb);
+
+		step.cell = first;
+		step.entered = leave;
+		step.next_edge = 0;
+		step.a[0] = sa[0];  step.a[1] = sa[1];
+		step.b[0] = sb[0];  step.b[1] = sb[1];
+
+		scratch.stack.clear();
+		scratch.stack.push_back(step);
+		scratch.on_path[first] = 1;
+		if ( scratch.seen[first] != stamp ) {
+			scratch.seen[first] = stamp;
+			scratch.cells.push_back(first);
+		}
+
+		while ( ! scratch.stack.empty() ) {
+			PVS_Step	&top = scratch.stack.back();
+
+			if ( top.next_edge == 4 ) {
+				scratch.on_path[top.cell] = 0;
+				scratch.stack.pop_back();
+				continue;
+			}
+
+			uint32_t	e = t.cell_edge[top.next_edge++][top.cell];
+
+			if ( e == MazeTables::NO_INDEX || e == top.entered || t.edge_opaque[e] )
+				continue;
+
+			uint32_t	next = t.edge_cell[Edge::LEFT][e] == top.cell ?
+								  t.edge_cell[Edge::RIGHT][e] :
+								  t.edge_cell[Edge::LEFT][e];
+
+			if ( next == MazeTables::NO_INDEX || scratch.on_path[next] )
+				continue;
+
+			// Clip the edge to the part beyond the last edge looked through,
+			// between the lines crossing from the leaving edge to it.
+			double	ea[2], eb[2];
+
+			Edge_Ends(t, e, top.cell, ea, eb);
+			step.a[0] = ea[0];  step.a[1] = ea[1];
+			step.b[0] = eb[0];  step.b[1] = eb[1];
+			if ( ! Clip_Left_Of(top.a, top.b, step.a, step.b) ||
+				  ! Clip_Left_Of(sa, top.b, step.a, step.b) ||
+				  ! Clip_Left_Of(top.a, sb, step.a, step.b) )
+				continue;
+
+			// What can be seen beyond an edge only grows with the part of it
+			// looked through, so a part inside one already walked through
+			// from this leaving edge adds nothing. This stops the walk from
+			// following every path around loops in the maze.
+			uint64_t	key = ( (uint64_t)i << 33 ) | ( (uint64_t)e << 1 ) |
+								  ( t.edge_cell[Edge::LEFT][e] == next ? 1 : 0 );
+			size_t	count = scratch.windows.size();
+			PVS_Window	&walked = scratch.windows[key];
+
+			if ( Window_Walked(walked, scratch.windows.size() != count,
+									 ea, eb, step.a, step.b) )
+				continue;
+
+			step.cell = next;
+			step.entered = e;
+			step.next_edge = 0;
+
+			scratch.on_path[next] = 1;
+			if ( scratch.seen[next] != stamp ) {
+				scratch.seen[next] = stamp;
+				scratch.cells.push_back(next);
+			}
+			scratch.stack.push_back(step);
+		}
+	}
+
+	scratch.on_path[source] = 0;
+}
+
+
+//**********************************************************************
+//
+// * Compute the sets for every cell of the maze
+//======================================================================
+void MazePVS::
+Build(const MazeTables &t)
+//======================================================================
+{
+	std::vector< std::vector<uint32_t> >	cell_runs(t.num_cells);
+	Work_Chunks										chunks(t.num_cells, CELL_CHUNK);
+	uint32_t											i;
+
+	// Each thread takes chunks of cells and turns each cell's visible cells
+	// into sorted runs.
+	Run_On_All_Threads([&]() {
+		PVS_Scratch	scratch(t.num_cells);
+		uint64_t	first, last;
+
+		while ( chunks.Next(first, last) ) {
+			for ( uint32_t c = (uint32_t)first ; c < last ; c++ ) {
+				std::vector<uint32_t>	&cells = scratch.cells;
+				std::vector<uint32_t>	&r = cell_runs[c];
+				size_t						j;
+
+				Visible_From(t, c, scratch);
+				std::sort(cells.begin(), cells.end());
+
+				for ( j = 0 ; j < cells.size() ; j++ ) {
+					if ( ! r.empty() && r[r.size() - 2] + r.back() == cells[j] )
+						r.back()++;
+					else {
+						r.push_back(cells[j]);
+						r.push_back(1);
+					}
+				}
+			}
+		}
+	});
+
+	// Pack the runs one cell after another.
+	offsets.assign(t.num_cells + 1, 0);
+	for ( i = 0 ; i < t.num_cells ; i++ )
+		offsets[i + 1] = offsets[i] + cell_runs[i].size() / 2;
+
+	runs.resize(2 * offsets[t.num_cells]);
+	for ( i = 0 ; i < t.num_cells ; i++ )
+		if ( ! cell_runs[i].empty() )
+			memcpy(&runs[2 * offsets[i]], &cell_runs[i][0],
+					 cell_runs[i].size() * sizeof(uint32_t));
+
+	maze_hash = Hash(t);
+}
+
+
+//**********************************************************************
+//
+// * Read the sets from a file written by Save. The file holds, in the
+//   machine's byte order:
+//     FILE_MAGIC, FILE_VERSION, num_cells, 0        4 x 4 bytes
+//     maze hash, number of runs                    2 x 8 bytes
+//     offsets, num_cells + 1 of them               8 bytes each
+//     runs, first cell and length of each          2 x 4 bytes each
+//======================================================================
+bool MazePVS::
+Load(const char *filename, const MazeTables &t, const uint64_t hash)
+//======================================================================
+{
+	FILE		*f = fopen(filename, "rb");
+	char		magic[4];
+	uint32_t	header[3];
+	uint64_t	sizes[2];
+	uint64_t	i;
+	bool		ok;
+
+	Clear();
+	if ( ! f )
+		return false;
+
+	ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, FILE_MAGIC, 4) == 0 &&
+		  fread(header, sizeof(uint32_t), 3, f) == 3 &&
+		  header[0] == FILE_VERSION && header[1] == t.num_cells &&
+		  fread(sizes, sizeof(uint64_t), 2, f) == 2 && sizes[0] == hash;
+
+	if ( ok ) {
+		offsets.resize(t.num_cells + 1);
+		ok = fread(&offsets[0], sizeof(uint64_t), offsets.size(), f) == offsets.size() &&
+			  offsets[0] == 0 && offsets[t.num_cells] == sizes[1];
+		for ( i = 0 ; ok && i < t.num_cells ; i++ )
+			ok = offsets[i] <= offsets[i + 1];
+	}
+
+	if ( ok ) {
+		runs.resize(2 * sizes[1]);
+		ok = runs.empty() ||
+			  fread(&runs[0], sizeof(uint32_t), runs.size(), f) == runs.size();
+		for ( i = 0 ; ok && i < runs.size() ; i += 2 )
+			ok = runs[i] < t.num_cells && runs[i + 1] <= t.num_cells - runs[i];
+	}
+
+	fclose(f);
+
+	if ( ! ok ) {
+		Clear();
+		return false;
+	}
+
+	maze_hash = sizes[0];
+	return true;
+}
+
+
+//**********************************************************************
+//
+// * Write the sets to a file, in the layout described at Load
+//======================================================================
+bool MazePVS::
+Save(const char *filename) const
+//======================================================================
+{
+	if ( ! Valid() )
+		return false;
+
+	FILE		*f = fopen(filename, "wb");
+	uint32_t	header[3] = { FILE_VERSION, (uint32_t)( offsets.size() - 1 ), 0 };
+	uint64_t	sizes[2] = { maze_hash, runs.size() / 2 };
+	bool		ok;
+
+	if ( ! f )
+		return false;
+
+	ok = fwrite(FILE_MAGIC, 1, 4, f) == 4 &&
+		  fwrite(header, sizeof(uint32_t), 3, f) == 3 &&
+		  fwrite(sizes, sizeof(uint64_t), 2, f) == 2 &&
+		  fwrite(&offsets[0], sizeof(uint64_t), offsets.size(), f) == offsets.size() &&
+		  ( runs.empty() ||
+			 fwrite(&runs[0], sizeof(uint32_t), runs.size(), f) == runs.size() );
+
+	return fclose(f) == 0 && ok;
+}
+
+
+//**********************************************************************
+//
+// * Forget the sets
+//======================================================================
+void MazePVS::
+Clear(void)
+//======================================================================
+{
+	maze_hash = 0;
+	offsets.clear();
+	runs.clear();
+}
+
+
+//**********************************************************************
+//
+// * True if cell to is in the set of cell from. The runs are sorted, so
+//   find the last one starting at or before to.
+//======================================================================
+bool MazePVS::
+Contains(const uint32_t from, const uint32_t to) const
+//======================================================================
+{
+	uint64_t	low = offsets[from];
+	uint64_t	high = offsets[from + 1];
+
+	while ( low < high ) {
+		uint64_t	mid = low + ( high - low ) / 2;
+
+		if ( runs[2 * mid] <= to )
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low > offsets[from] &&
+			 to - runs[2 * ( low - 1 )] < runs[2 * ( low - 1 ) + 1];
+}
+
+
+//**********************************************************************
+//
+// * The number of cells in the set of the given cell
+//======================================================================
+uint32_t MazePVS::
+Count(const uint32_t cell) const
+//======================================================================
+{
+	uint32_t	count = 0;
+	uint64_t	i;
+
+	for ( i = offsets[cell] ; i < offsets[cell + 1] ; i++ )
+		count += runs[2 * i + 1];
+
+	return count;
+}
+
+
+//**********************************************************************
+//
+// * Hash the maze's vertex positions, edges and cells with 64-bit FNV-1a.
+//   Colors are left out since they don't change what can be seen.
+//======================================================================
+uint64_t MazePVS::
+Hash(const MazeTables &t)
+//======================================================================
+{
+	const void	*tables[] = {
+		t.vertex_posn[0], t.vertex_posn[1],
+		t.edge_vertex[0], t.edge_vertex[1], t.edge_cell[0], t.edge_cell[1],
+		t.edge_opaque,
+		t.cell_edge[0], t.cell_edge[1], t.cell_edge[2], t.cell_edge[3]
+	};
+	size_t		sizes[] = {
+		t.num_vertices * sizeof(float), t.num_vertices * sizeof(float),
+		t.num_edges * sizeof(uint32_t), t.num_edges * sizeof(uint32_t),
+		t.num_edges * sizeof(uint32_t), t.num_edges * sizeof(uint32_t),
+		t.num_edges * sizeof(uint8_t),
+		t.num_cells * sizeof(uint32_t), t.num_cells * sizeof(uint32_t),
+		t.num_cells * sizeof(uint32_t), t.num_cells * sizeof(uint32_t)
+	};
+	uint64_t		hash = 14695981039346656037ull;
+	size_t		i, j;
+
+	for ( i = 0 ; i < sizeof(sizes) / sizeof(sizes[0]) ; i++ ) {
+		const uint8_t	*bytes = (const uint8_t*)tables[i];
+
+		for ( j = 0 ; j < sizes[i] ; j++ ) {
+			hash ^= bytes[j];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	return hash;
+}
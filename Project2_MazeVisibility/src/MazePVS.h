@@ -0,0 +1,64 @@
+/************************************************************************
+     File:        MazePVS.h
+
+     Comment:
+						Class header file for MazePVS class. Holds the potentially
+						visible set of every cell of a maze: the cells that can be
+						seen from some point inside it, looking in any direction.
+						Each set is kept as sorted runs of cell indices.
+
+
+     Platform:    Visio Studio.Net 2003 (converted to 2005)
+
+*************************************************************************/
+
+#ifndef _MAZEPVS_H_
+#define _MAZEPVS_H_
+
+#include <stdint.h>
+#include <vector>
+#include "MazeTables.h"
+
+class MazePVS {
+	public:
+		MazePVS(void) { maze_hash = 0; };
+
+	public:
+		// Compute the sets for every cell of the maze, spreading the cells
+		// across all the hardware threads. The sets are conservative: they may
+		// hold cells that turn out to be hidden, but never miss a visible one.
+		void	Build(const MazeTables&);
+
+		// Read the sets from a file written by Save. The tables' Hash is passed
+		// in, since the caller may have it without reading every table.
+		// Returns false, leaving the sets empty, if the file can't be read or
+		// was built for another maze.
+		bool	Load(const char *filename, const MazeTables&, const uint64_t hash);
+
+		// Write the sets to a file. Returns false if it couldn't be written.
+		bool	Save(const char *filename) const;
+
+		// Forget the sets.
+		void	Clear(void);
+
+		// True once the sets have been built or loaded.
+		bool	Valid(void) const { return ! offsets.empty(); };
+
+		// True if cell to is in the set of cell from.
+		bool	Contains(const uint32_t from, const uint32_t to) const;
+
+		// The number of cells in the set of the given cell.
+		uint32_t	Count(const uint32_t cell) const;
+
+		// Returns a hash of the maze's geometry and connectivity, used to tell
+		// whether a saved set still matches its maze.
+		static uint64_t	Hash(const MazeTables&);
+
+	private:
+		uint64_t					maze_hash;	// Hash of the maze the sets were built for
+		std::vector<uint64_t>	offsets;		// Per cell, then one more. The number
+													// of runs before the cell's first run.
+		std::vector<uint32_t>	runs;			// Pairs of first cell and run length
+};
+
+#endif
@@ -0,0 +1,307 @@
+/************************************************************************
+     File:        MazeTables.cpp
+
+     Comment:
+						Class file for MazeTables class. Holds every vertex, edge and
+						cell of a maze as contiguous struct-of-arrays tables.
+
+
+     Platform:    Visio Studio.Net 2003 (converted to 2005)
+
+*************************************************************************/
+
+#include <string.h>
+#include "MazeTables.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const uint32_t MazeTables::NO_INDEX = 0xFFFFFFFFu;
+
+// Each table starts on a multiple of this many bytes.
+static const size_t TABLE_ALIGN = 16;
+
+
+//**********************************************************************
+//
+// * Round a table size up to the table alignment.
+//======================================================================
+static size_t
+Align(const size_t bytes)
+//======================================================================
+{
+	return ( bytes + TABLE_ALIGN - 1 ) & ~( TABLE_ALIGN - 1 );
+}
+
+
+//**********************************************************************
+//
+// * Constructor. The tables start out empty.
+//======================================================================
+MazeTables::
+MazeTables(void)
+//======================================================================
+{
+	memory = NULL;
+	mapping = NULL;
+	mapping_size = 0;
+	Free();
+}
+
+
+//**********************************************************************
+//
+// * Destructor
+//======================================================================
+MazeTables::
+~MazeTables(void)
+//======================================================================
+{
+	Free();
+}
+
+
+//**********************************************************************
+//
+// * The size in bytes of the block for the given counts
+//======================================================================
+size_t MazeTables::
+Block_Size(const uint32_t nv, const uint32_t ne, const uint32_t nc)
+//======================================================================
+{
+	return 2 * Align((size_t)nv * sizeof(float)) +
+			 4 * Align((size_t)ne * sizeof(uint32_t)) +
+			 3 * Align((size_t)ne * sizeof(float)) +
+			 Align((size_t)ne * 3 * sizeof(float)) +
+			 Align((size_t)ne * sizeof(uint8_t)) +
+			 4 * Align((size_t)nc * sizeof(uint32_t));
+}
+
+
+//**********************************************************************
+//
+// * Set the counts and point every table into the block, in the order
+//   their sizes are added up in Block_Size.
+//======================================================================
+void MazeTables::
+Point_Into(char *block, const uint32_t nv, const uint32_t ne, const uint32_t nc)
+//======================================================================
+{
+	size_t	vertex_floats = Align((size_t)nv * sizeof(float));
+	size_t	edge_indices = Align((size_t)ne * sizeof(uint32_t));
+	size_t	edge_floats = Align((size_t)ne * sizeof(float));
+	size_t	edge_colors = Align((size_t)ne * 3 * sizeof(float));
+	size_t	edge_bytes = Align((size_t)ne * sizeof(uint8_t));
+	size_t	cell_indices = Align((size_t)nc * sizeof(uint32_t));
+	char	*p = block;
+	int		i;
+
+	memory = block;
+	num_vertices = nv;
+	num_edges = ne;
+	num_cells = nc;
+
+	for ( i = 0 ; i < 2 ; i++, p += vertex_floats )
+		vertex_posn[i] = (float*)p;
+	for ( i = 0 ; i < 2 ; i++, p += edge_indices )
+		edge_vertex[i] = (uint32_t*)p;
+	for ( i = 0 ; i < 2 ; i++, p += edge_indices )
+		edge_cell[i] = (uint32_t*)p;
+	for ( i = 0 ; i < 3 ; i++, p += edge_floats )
+		edge_line[i] = (float*)p;
+
+	edge_color = (float*)p;
+	p += edge_colors;
+
+	edge_opaque = (uint8_t*)p;
+	p += edge_bytes;
+
+	for ( i = 0 ; i < 4 ; i++, p += cell_indices )
+		cell_edge[i] = (uint32_t*)p;
+}
+
+
+//**********************************************************************
+//
+// * Allocate the tables for the given counts in a single block
+//======================================================================
+void MazeTables::
+Allocate(const uint32_t nv, const uint32_t ne, const uint32_t nc)
+//======================================================================
+{
+	int		i;
+
+	Free();
+	Point_Into(new char[Block_Size(nv, ne, nc)], nv, ne, nc);
+
+	for ( i = 0 ; i < 2 ; i++ )
+		memset(vertex_posn[i], 0, (size_t)nv * sizeof(float));
+	for ( i = 0 ; i < 2 ; i++ ) {
+		memset(edge_vertex[i], 0xFF, (size_t)ne * sizeof(uint32_t));
+		memset(edge_cell[i], 0xFF, (size_t)ne * sizeof(uint32_t));
+	}
+	for ( i = 0 ; i < 3 ; i++ )
+		memset(edge_line[i], 0, (size_t)ne * sizeof(float));
+	memset(edge_color, 0, (size_t)ne * 3 * sizeof(float));
+	memset(edge_opaque, 1, (size_t)ne * sizeof(uint8_t));
+	for ( i = 0 ; i < 4 ; i++ )
+		memset(cell_edge[i], 0xFF, (size_t)nc * sizeof(uint32_t));
+}
+
+
+//**********************************************************************
+//
+// * Map the tables from a file, copy-on-write. Changes to the tables stay
+//   in memory and never reach the file.
+//======================================================================
+bool MazeTables::
+Map(const char *filename, const size_t offset,
+	 const uint32_t nv, const uint32_t ne, const uint32_t nc)
+//======================================================================
+{
+	void	*view = NULL;
+	size_t	size = 0;
+
+	Free();
+
+	if ( offset % TABLE_ALIGN )
+		return false;
+
+#ifdef _WIN32
+	HANDLE			file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ,
+												NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+												NULL);
+	LARGE_INTEGER	file_size;
+
+	if ( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	if ( GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 ) {
+		HANDLE	map = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+
+		if ( map ) {
+			size = (size_t)file_size.QuadPart;
+			view = MapViewOfFile(map, FILE_MAP_COPY, 0, 0, 0);
+			CloseHandle(map);
+		}
+	}
+	CloseHandle(file);
+#else
+	int			file = open(filename, O_RDONLY);
+	struct stat	file_stat;
+
+	if ( file < 0 )
+		return false;
+
+	if ( fstat(file, &file_stat) == 0 && file_stat.st_size > 0 ) {
+		size = (size_t)file_stat.st_size;
+		view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		if ( view == MAP_FAILED )
+			view = NULL;
+	}
+	close(file);
+#endif
+
+	if ( ! view )
+		return false;
+
+	mapping = view;
+	mapping_size = size;
+
+	if ( offset > size || size - offset < Block_Size(nv, ne, nc) ) {
+		Free();
+		return false;
+	}
+
+	Point_Into((char*)view + offset, nv, ne, nc);
+	return true;
+}
+
+
+//**********************************************************************
+//
+// * Copy mapped tables into a block of their own and unmap the file
+//======================================================================
+void MazeTables::
+Unmap(void)
+//======================================================================
+{
+	uint32_t	nv = num_vertices;
+	uint32_t	ne = num_edges;
+	uint32_t	nc = num_cells;
+	char		*block;
+
+	if ( ! mapping )
+		return;
+
+	block = new char[Block_Size(nv, ne, nc)];
+	memcpy(block, memory, Block_Size(nv, ne, nc));
+	Free();
+	Point_Into(block, nv, ne, nc);
+}
+
+
+//**********************************************************************
+//
+// * Free the tables
+//======================================================================
+void MazeTables::
+Free(void)
+//======================================================================
+{
+	if ( mapping ) {
+#ifdef _WIN32
+		UnmapViewOfFile(mapping);
+#else
+		munmap(mapping, mapping_size);
+#endif
+	}
+	else
+		delete[] memory;
+
+	memory = NULL;
+	mapping = NULL;
+	mapping_size = 0;
+
+	num_vertices = num_edges = num_cells = 0;
+	vertex_posn[0] = vertex_posn[1] = NULL;
+	edge_vertex[0] = edge_vertex[1] = NULL;
+	edge_cell[0] = edge_cell[1] = NULL;
+	edge_line[0] = edge_line[1] = edge_line[2] = NULL;
+	edge_color = NULL;
+	edge_opaque = NULL;
+	cell_edge[0] = cell_edge[1] = cell_edge[2] = cell_edge[3] = NULL;
+}
+
+
+//**********************************************************************
+//
+// * Set an edge's precomputed line equation from its endpoints. This is
+//   the determinant | xs ys 1 |
+//                   | xe ye 1 |
+//                   | x  y  1 |
+//   expanded in x and y, so it is positive on the left of the edge. The
+//   constant is formed in double precision so that it stays accurate far
+//   from the origin.
+//======================================================================
+void MazeTables::
+Set_Edge_Line(const uint32_t edge)
+//======================================================================
+{
+	float	xs = vertex_posn[0][edge_vertex[0][edge]];
+	float	ys = vertex_posn[1][edge_vertex[0][edge]];
+	float	xe = vertex_posn[0][edge_vertex[1][edge]];
+	float	ye = vertex_posn[1][edge_vertex[1][edge]];
+
+	edge_line[0][edge] = ys - ye;
+	edge_line[1][edge] = xe - xs;
+	edge_line[2][edge] = (float)( (double)xs * ye - (double)ys * xe );
+}
@@ -0,0 +1,111 @@
+/************************************************************************
+     File:        MazeTables.h
+
+     Comment:
+						Class header file for MazeTables class. Holds every vertex,
+						edge and cell of a maze as contiguous struct-of-arrays tables
+						addressed by 32-bit indices. The Vertex, Edge and Cell classes
+						are small handles into these tables.
+
+
+     Platform:    Visio Studio.Net 2003 (converted to 2005)
+
+*************************************************************************/
+
+#ifndef _MAZETABLES_H_
+#define _MAZETABLES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+class MazeTables {
+	public:
+		MazeTables(void);
+		~MazeTables(void);
+
+	public:
+		// Allocate the tables for the given counts in a single block, freeing
+		// any tables already held. Every index is set to NO_INDEX, every edge
+		// to opaque and every coordinate to 0.
+		void	Allocate(const uint32_t num_vertices, const uint32_t num_edges,
+							const uint32_t num_cells);
+
+		// Map the tables from a file, copy-on-write, so that they are used in
+		// place. The block starts at the given offset, which must be a
+		// multiple of 16, and is laid out as Allocate lays it out. Returns
+		// false, leaving the tables empty, if the file can't be mapped or is
+		// too short.
+		bool	Map(const char *filename, const size_t offset,
+					 const uint32_t num_vertices, const uint32_t num_edges,
+					 const uint32_t num_cells);
+
+		// Copy mapped tables into a block of their own and unmap the file, so
+		// that the file can be rewritten. Does nothing if they weren't mapped.
+		void	Unmap(void);
+
+		// Free the tables, or unmap them if they were mapped.
+		void	Free(void);
+
+		// The block holding every table, and its size in bytes.
+		const char*	Block(void) const { return memory; };
+		size_t		Block_Size(void) const {
+			return Block_Size(num_vertices, num_edges, num_cells);
+		};
+
+		// The size in bytes of the block for the given counts. The layout of
+		// the block is written to binary maze files, so changing it means
+		// changing the file version in Maze.cpp.
+		static size_t	Block_Size(const uint32_t num_vertices,
+										  const uint32_t num_edges,
+										  const uint32_t num_cells);
+
+		// Set an edge's precomputed line equation from its endpoints.
+		void	Set_Edge_Line(const uint32_t edge);
+
+		// Returns the line equation of the edge at (x,y). It is positive on the
+		// left of the edge, negative on the right and 0 on the line.
+		float	Edge_Line(const uint32_t edge, const float x, const float y) const {
+			return edge_line[0][edge] * x + edge_line[1][edge] * y + edge_line[2][edge];
+		};
+
+	private:
+		// Tables own their block and can't be copied.
+		MazeTables(const MazeTables&);
+		MazeTables& operator=(const MazeTables&);
+
+		// Set the counts and point every table into the block.
+		void	Point_Into(char *block, const uint32_t num_vertices,
+							  const uint32_t num_edges, const uint32_t num_cells);
+
+	public:
+		// Index stored where there is no cell or edge, such as the missing
+		// neighbor of an edge on the boundary of the maze.
+		static const uint32_t	NO_INDEX;
+
+		uint32_t	num_vertices;		// The number of vertices in the maze
+		uint32_t	num_edges;			// The number of edges in the maze
+		uint32_t	num_cells;			// The number of cells in the maze
+
+		float		*vertex_posn[2];	// x and y of each vertex, indexed by
+												// Vertex::X and Vertex::Y
+
+		uint32_t	*edge_vertex[2];	// The vertices at each end, indexed by
+												// Edge::START and Edge::END
+		uint32_t	*edge_cell[2];		// The cells on each side, indexed by
+												// Edge::LEFT and Edge::RIGHT, or NO_INDEX
+		float		*edge_line[3];		// a, b and c of the line a x + b y + c
+		float		*edge_color;		// r, g and b of each edge, 3 per edge
+		uint8_t		*edge_opaque;		// Non-zero if the edge cannot be seen or
+												// walked through
+
+		uint32_t	*cell_edge[4];		// The edges of each cell, indexed by
+												// Cell::PLUS_X etc., or NO_INDEX
+
+	private:
+		char		*memory;			// The block holding every table
+		void		*mapping;			// The mapped file holding the block, or
+											// NULL if the block was allocated
+		size_t		mapping_size;		// The size of the mapping in bytes
+};
+
+#endif
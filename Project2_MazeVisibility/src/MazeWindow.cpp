@@ -130,63 +130,10 @@ draw(void)
 		glMatrixMode(GL_MODELVIEW);
 		glLoadIdentity();
 
-		// perspective projection		
-		float aspect = (float)w() / h();
-		float t = maze->n * tan(Maze::To_Radians(maze->viewer_fov) * 0.5);					//top
-		float r = maze->n * tan(Maze::To_Radians(maze->viewer_fov * aspect) * 0.5);		//right
-
-		float perspective_matrix[16] = {
-			maze->n / r, 0.0, 0.0, 0.0,
-			0.0, maze->n / t, 0.0, 0.0,
-			0.0, 0.0, (maze->n + maze->f) / (maze->n - maze->f), -1.0,
-			0.0, 0.0, 2 * maze->n * maze->f / (maze->n - maze->f), 0.0
-		};
-		
-		// model to view
-		float eye[3] = {
-		maze->viewer_posn[Maze::Y],
-		0.0f,
-		maze->viewer_posn[Maze::X]
-		};
-
-		float center[3] = {
-			eye[Maze::X] + sin(Maze::To_Radians(maze->viewer_dir)),
-			eye[Maze::Y],
-			eye[Maze::Z] + cos(Maze::To_Radians(maze->viewer_dir))
-		};
-
-		glm::vec3 up(0.0, 1.0, 0.0);
-
-		float length = sqrt(pow((eye[Maze::X] - center[Maze::X]), 2) + pow((eye[Maze::Y] - center[Maze::Y]), 2) + pow((eye[Maze::Z] - center[Maze::Z]), 2));
-
-		glm::vec3 w(
-			eye[Maze::X] - center[Maze::X] / length,
-			eye[Maze::Y] - center[Maze::Y] / length,
-			eye[Maze::Z] - center[Maze::Z] / length);
-
-		glm::vec3 u = glm::cross(up, w);
-		glm::vec3 v = glm::cross(w, u);
-
-		float rotation_matrix[16] = {
-			u[Maze::X], v[Maze::X], w[Maze::X], 0.0,
-			u[Maze::Y], v[Maze::Y], w[Maze::Y], 0.0,
-			u[Maze::Z], v[Maze::Z], w[Maze::Z], 0.0,
-			0.0, 0.0, 0.0, 1.0
-		};
-
-		float translation_matrix[16] = {
-			1.0, 0.0, 0.0, 0.0,
-			0.0, 1.0, 0.0, 0.0,
-			0.0, 0.0, 1.0, 0.0,
-			-eye[Maze::X], -eye[Maze::Y], -eye[Maze::Z], 1.0
-		};
-
-		// matrix to glm
-		glm::mat4x4 rotation = glm::make_mat4(rotation_matrix);
-		glm::mat4x4 translation = glm::make_mat4(translation_matrix);
-		glm::mat4x4 view = rotation * translation;
-		glm::mat4x4 perspective = glm::make_mat4(perspective_matrix);
-		
+		glm::mat4x4 view, perspective;
+
+		maze->View_Matrices((float)w() / h(), view, perspective);
+
 		// draw
 		maze->Draw_View(focal_length, view, perspective);
 	}
@@ -0,0 +1,70 @@
+/************************************************************************
+     File:        Parallel.h
+
+     Comment:
+						Helpers for spreading loops over cells or edges across all
+						the hardware threads. A Work_Chunks hands out ranges of the
+						loop, and Run_On_All_Threads runs a worker on every thread
+						until the chunks run out.
+
+
+     Platform:    Visio Studio.Net 2003 (converted to 2005)
+
+*************************************************************************/
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//************************************************************************
+//
+// * Hands out [0, count) a chunk at a time, to any number of threads.
+//
+//************************************************************************
+class Work_Chunks {
+	public:
+		Work_Chunks(const uint64_t count, const uint64_t chunk)
+			: next(0), count(count), chunk(chunk) {};
+
+		// Get the next range to work on, from first up to but not including
+		// last. Returns false once there are none left.
+		bool	Next(uint64_t &first, uint64_t &last) {
+			first = next.fetch_add(chunk);
+			if ( first >= count )
+				return false;
+			last = count - first < chunk ? count : first + chunk;
+			return true;
+		};
+
+	private:
+		std::atomic<uint64_t>	next;		// The start of the next chunk
+		uint64_t				count;		// The end of the whole range
+		uint64_t				chunk;		// The size of each chunk
+};
+
+
+//************************************************************************
+//
+// * Run worker() once on every hardware thread, this one included, and
+//   wait for them all to finish.
+//
+//************************************************************************
+template <class Worker>
+void Run_On_All_Threads(Worker worker)
+{
+	unsigned int				num_threads = std::thread::hardware_concurrency();
+	std::vector<std::thread>	threads;
+	unsigned int				i;
+
+	for ( i = 1 ; i < num_threads ; i++ )
+		threads.push_back(std::thread(worker));
+	worker();
+	for ( i = 0 ; i < threads.size() ; i++ )
+		threads[i].join();
+}
+
+#endif
@@ -20,17 +20,3 @@
 
 const char  Vertex::X = 0;
 const char  Vertex::Y = 1;
-
-//*********************************************************************************
-//
-// * Constructor
-//=================================================================================
-Vertex::
-Vertex(int i, float x, float y)
-//=================================================================================
-{
-	index = i;
-	posn[X] = x;
-	posn[Y] = y;
-}
-
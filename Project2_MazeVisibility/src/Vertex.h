@@ -19,17 +19,30 @@
 #ifndef _VERTEX_H_
 #define _VERTEX_H_
 
+#include "MazeTables.h"
+
+// A vertex is a handle to one entry of the maze's vertex tables. Handles
+// are cheap to copy and compare.
 class Vertex {
 	public:
-		// Constructor
-		Vertex(int index, float x, float y);
+		// Constructor takes the tables and the vertex's index in them.
+		Vertex(MazeTables *t, uint32_t i) : tables(t), index(i) {};
+
+	public:
+		// The identifier of the vertex.
+		int		Index(void) const { return (int)index; };
+
+		// The location of the vertex along Vertex::X or Vertex::Y.
+		float	Posn(const char axis) const { return tables->vertex_posn[axis][index]; };
 
 	public:
 		// Index constant for x, y
 		static const char X;
 		static const char	Y;
-		int	  index;		// An identifier
-		float   posn[2];	// The location (x and y)
+
+	private:
+		MazeTables	*tables;	// The tables holding the vertex
+		uint32_t	index;		// An identifier
 
 };
 